@@ -0,0 +1,1017 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include "../common/lzss.hpp"
+#include "../common/crc.hpp"
+#include "../common/pre_file.hpp"
+#include "../common/tex_file.hpp"
+#include "../common/generate.hpp"
+#include "../common/file_io.hpp"
+#include "../common/file_writer.hpp"
+
+struct Sample
+{
+    std::string name;
+    std::vector<char> data;
+};
+
+struct Result
+{
+    std::string name;
+    unsigned long long bytes;
+    unsigned long long entries;
+    double seconds;
+};
+
+struct
+{
+    std::vector<std::filesystem::path> inpaths;
+    std::filesystem::path jsonpath;
+    std::filesystem::path baselinepath;
+    double max_slowdown = 10;
+    std::filesystem::path workdir;
+    double mintime = 0.5;
+    bool printhelp = false;
+} globalValues;
+
+void PrintHelp();
+bool ReadArgs(int argc, char **argv);
+bool LoadCorpus(std::vector<Sample> &corpus);
+void GenerateCorpus(std::vector<Sample> &corpus);
+bool BenchLzss(const std::vector<Sample> &corpus, std::vector<Result> &results);
+bool BenchCrc(const std::vector<Sample> &corpus, std::vector<Result> &results);
+bool BenchPre(const std::vector<Sample> &corpus, std::vector<Result> &results);
+bool BenchTex(std::vector<Result> &results);
+bool BenchFileIo(const std::vector<Sample> &corpus, std::vector<Result> &results);
+bool BenchFiles(std::vector<Result> &results);
+void PrintResults(const std::vector<Result> &results);
+bool WriteJson(const std::vector<Result> &results);
+bool CompareBaseline(const std::vector<Result> &results, bool &regressed);
+
+int main(int argc, char **argv)
+{
+    std::vector<Sample> corpus;
+    std::vector<Result> results;
+
+    if (ReadArgs(argc, argv))
+    {
+        std::cerr << "Benchmark failed." << std::endl;
+        return -1;
+    }
+
+    if (globalValues.printhelp)
+    {
+        PrintHelp();
+        return 0;
+    }
+
+    if (globalValues.inpaths.empty())
+    {
+        GenerateCorpus(corpus);
+    }
+    else if (LoadCorpus(corpus))
+    {
+        std::cerr << "Benchmark failed." << std::endl;
+        return -1;
+    }
+
+    if (globalValues.workdir.empty())
+    {
+        globalValues.workdir = std::filesystem::temp_directory_path() / "ug2-bench";
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(globalValues.workdir, ec);
+
+    if (ec)
+    {
+        std::cerr << "Error: Failed to create directory \"" << globalValues.workdir.string() << "\"" << std::endl;
+        std::cerr << "Benchmark failed." << std::endl;
+        return -1;
+    }
+
+    if (BenchLzss(corpus, results) || BenchCrc(corpus, results) || BenchPre(corpus, results) || BenchTex(results) || BenchFileIo(corpus, results) || BenchFiles(results))
+    {
+        std::cerr << "Benchmark failed." << std::endl;
+        return -1;
+    }
+
+    PrintResults(results);
+
+    if (!globalValues.jsonpath.empty() && WriteJson(results))
+    {
+        std::cerr << "Benchmark failed." << std::endl;
+        return -1;
+    }
+
+    if (!globalValues.baselinepath.empty())
+    {
+        bool regressed = false;
+
+        if (CompareBaseline(results, regressed))
+        {
+            std::cerr << "Benchmark failed." << std::endl;
+            return -1;
+        }
+
+        if (regressed)
+        {
+            std::cerr << "Error: Throughput dropped more than " << globalValues.max_slowdown << "% below the baseline" << std::endl;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void PrintHelp()
+{
+    std::cout << "Usage: ug2-bench [FILE]... [OPTION]..." << std::endl << std::endl;
+    std::cout << "Benchmark ug2tools internals on the given files, or on generated data if none are given." << std::endl << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "    -h                          Print this help text" << std::endl;
+    std::cout << "    -t SECONDS                  Run each benchmark for at least SECONDS. Default 0.5" << std::endl;
+    std::cout << "    -j FILE                     Also write results to FILE as JSON" << std::endl;
+    std::cout << "    -d DIRECTORY                Write on-disk benchmark files in DIRECTORY instead of the temp directory" << std::endl;
+    std::cout << "    -b FILE                     Compare against results previously written with -j, and fail if any" << std::endl;
+    std::cout << "                                benchmark is slower than allowed" << std::endl;
+    std::cout << "    -p PERCENT                  How far throughput may drop below the baseline. Default 10" << std::endl;
+}
+
+bool ReadArgs(int argc, char **argv)
+{
+    std::string arg;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        arg = argv[i];
+
+        if ((arg[0] == '-') && (arg.size() > 1))
+        {
+            std::string switches = arg.substr(1, arg.size() - 1);
+            bool exclusive_sw = false;
+
+            for (char c : switches)
+            {
+                if (c == 'h')
+                {
+                    globalValues.printhelp = true;
+                }
+                else if (c == 't' || c == 'j' || c == 'd' || c == 'b' || c == 'p')
+                {
+                    if (exclusive_sw)
+                    {
+                        std::cerr << "Error: Mutually exclusive switches combined" << std::endl;
+                        return true;
+                    }
+
+                    exclusive_sw = true;
+
+                    if (i + 1 >= argc)
+                    {
+                        std::cerr << "Error: Wrong number of arguments after -" << c << std::endl;
+                        return true;
+                    }
+
+                    ++i;
+
+                    if (c == 'j')
+                    {
+                        globalValues.jsonpath = argv[i];
+                    }
+                    else if (c == 'd')
+                    {
+                        globalValues.workdir = argv[i];
+                    }
+                    else if (c == 'b')
+                    {
+                        globalValues.baselinepath = argv[i];
+                    }
+                    else if (c == 'p')
+                    {
+                        globalValues.max_slowdown = std::atof(argv[i]);
+
+                        if (globalValues.max_slowdown <= 0 || globalValues.max_slowdown >= 100)
+                        {
+                            std::cerr << "Error: Invalid percentage \"" << argv[i] << "\"" << std::endl;
+                            return true;
+                        }
+                    }
+                    else
+                    {
+                        globalValues.mintime = std::atof(argv[i]);
+
+                        if (globalValues.mintime <= 0)
+                        {
+                            std::cerr << "Error: Invalid time \"" << argv[i] << "\"" << std::endl;
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        else
+        {
+            globalValues.inpaths.push_back(arg);
+        }
+    }
+
+    return false;
+}
+
+bool LoadCorpus(std::vector<Sample> &corpus)
+{
+    for (const std::filesystem::path &path : globalValues.inpaths)
+    {
+        std::ifstream instream(path, std::ios::binary);
+        Sample sample;
+
+        if (instream.fail())
+        {
+            std::cerr << "Error: Failed to open \"" << path.string() << "\"" << std::endl;
+            return true;
+        }
+
+        sample.name = path.filename().string();
+        sample.data.assign(std::istreambuf_iterator<char>(instream), std::istreambuf_iterator<char>());
+        corpus.push_back(std::move(sample));
+    }
+
+    return false;
+}
+
+void GenerateCorpus(std::vector<Sample> &corpus)
+{
+    // A fixed seed keeps results comparable between runs.
+    std::mt19937 rng(1234);
+    Sample text = {"generated text", {}};
+    Sample sparse = {"generated sparse", {}};
+    Sample noise = {"generated noise", {}};
+
+    GenerateData(rng, DataProfile::Text, 1 << 20, text.data);
+    GenerateData(rng, DataProfile::Sparse, 1 << 20, sparse.data);
+    GenerateData(rng, DataProfile::Noise, 1 << 18, noise.data);
+
+    corpus.push_back(std::move(text));
+    corpus.push_back(std::move(sparse));
+    corpus.push_back(std::move(noise));
+}
+
+// Run fn repeatedly for at least globalValues.mintime seconds and record the average time per run. fn returns
+// true on failure, like everything else.
+template <typename Fn>
+bool TimeRuns(const std::string &name, unsigned long long bytes, unsigned long long entries, std::vector<Result> &results, Fn fn)
+{
+    using Clock = std::chrono::steady_clock;
+    unsigned int runs = 0;
+    Clock::duration elapsed {};
+
+    while (std::chrono::duration<double>(elapsed).count() < globalValues.mintime)
+    {
+        Clock::time_point start = Clock::now();
+
+        if (fn())
+        {
+            std::cerr << "Error: Benchmark \"" << name << "\" failed" << std::endl;
+            return true;
+        }
+
+        elapsed += Clock::now() - start;
+        ++runs;
+    }
+
+    results.push_back({name, bytes, entries, std::chrono::duration<double>(elapsed).count() / runs});
+    return false;
+}
+
+unsigned long long CorpusBytes(const std::vector<Sample> &corpus)
+{
+    unsigned long long bytes = 0;
+
+    for (const Sample &sample : corpus) bytes += sample.data.size();
+
+    return bytes;
+}
+
+bool BenchLzss(const std::vector<Sample> &corpus, std::vector<Result> &results)
+{
+    std::vector<std::vector<char>> deflated(corpus.size());
+    std::vector<std::vector<char>> inflated(corpus.size());
+    unsigned long long bytes = CorpusBytes(corpus);
+
+    auto deflate = [&](LzssMatchFinder finder)
+    {
+        for (size_t i = 0; i < corpus.size(); ++i)
+        {
+            LzssDeflate(corpus[i].data.data(), corpus[i].data.size(), deflated[i], finder);
+        }
+
+        return false;
+    };
+
+    auto inflate = [&]()
+    {
+        for (size_t i = 0; i < corpus.size(); ++i)
+        {
+            inflated[i].resize(corpus[i].data.size());
+
+            if (LzssInflate(deflated[i].data(), deflated[i].size(), inflated[i].data(), inflated[i].size())) return true;
+        }
+
+        return false;
+    };
+
+    if (TimeRuns("lzss deflate (scalar)", bytes, corpus.size(), results, [&]() {return deflate(LzssMatchFinder::Scalar);})) return true;
+
+    std::vector<std::vector<char>> scalar_deflated = deflated;
+
+    if (TimeRuns("lzss deflate", bytes, corpus.size(), results, [&]() {return deflate(LzssMatchFinder::Simd);})) return true;
+    if (TimeRuns("lzss inflate", bytes, corpus.size(), results, inflate)) return true;
+
+    // Both match finders should make the same choices, and the result has to inflate back to the input.
+    for (size_t i = 0; i < corpus.size(); ++i)
+    {
+        if (scalar_deflated[i] != deflated[i])
+        {
+            std::cerr << "Error: Match finders disagree on \"" << corpus[i].name << "\"" << std::endl;
+            return true;
+        }
+
+        if (inflated[i] != corpus[i].data)
+        {
+            std::cerr << "Error: \"" << corpus[i].name << "\" didn't survive a round trip" << std::endl;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool BenchCrc(const std::vector<Sample> &corpus, std::vector<Result> &results)
+{
+    std::vector<std::string> paths;
+    volatile unsigned int sink = 0;
+
+    for (unsigned int i = 0; i < 4096; ++i)
+    {
+        paths.push_back("levels\\generated\\script_" + std::to_string(i) + ".qb");
+    }
+
+    if (TimeRuns("crc buffer", CorpusBytes(corpus), corpus.size(), results, [&]()
+    {
+        for (const Sample &sample : corpus) sink = sink + BufferCRC(sample.data.data(), sample.data.size());
+        return false;
+    })) return true;
+
+    unsigned long long path_bytes = 0;
+
+    for (const std::string &path : paths) path_bytes += path.size();
+
+    return TimeRuns("crc path", path_bytes, paths.size(), results, [&]()
+    {
+        for (const std::string &path : paths) sink = sink + StringCRC(path);
+        return false;
+    });
+}
+
+struct PreEntry
+{
+    std::string internal_path;
+    const std::vector<char> *data;
+};
+
+// Pack entries into a pre file the same way ug2-pre-pack -c does.
+bool PackPre(std::ostream &outstream, const std::vector<PreEntry> &entries)
+{
+    uint64_t presize = 0;
+    std::vector<char> deflated;
+    PreHeader header;
+    const char padding[4] = {0, 0, 0, 0};
+
+    if (WritePreHeader(outstream, PreHeader(), presize)) return true;
+
+    for (const PreEntry &entry : entries)
+    {
+        SubFileHeader subheader;
+        const std::vector<char> *payload = entry.data;
+
+        subheader.pathCRC = StringCRC(entry.internal_path);
+        subheader.path.assign(entry.internal_path.begin(), entry.internal_path.end());
+        subheader.path.resize(subheader.path.size() + 4 - (subheader.path.size() % 4), 0);
+        subheader.pathSize = subheader.path.size();
+        subheader.inflatedSize = entry.data->size();
+        subheader.deflatedSize = 0;
+
+        LzssDeflate(entry.data->data(), entry.data->size(), deflated);
+
+        if (deflated.size() < entry.data->size())
+        {
+            subheader.deflatedSize = deflated.size();
+            payload = &deflated;
+        }
+
+        if (WriteSubFileHeader(outstream, subheader, presize)) return true;
+
+        outstream.write(payload->data(), payload->size());
+        presize += payload->size();
+
+        unsigned int pad = (presize % 4) ? (4 - (presize % 4)) : 0;
+        outstream.write(padding, pad);
+        presize += pad;
+    }
+
+    header.size = presize;
+    header.numFiles = entries.size();
+    outstream.seekp(0);
+
+    return WritePreHeader(outstream, header, presize) || outstream.fail();
+}
+
+// Read and inflate every subfile in a pre file, the same way ug2-pre-unpack does. With inflate false, only
+// the headers are parsed.
+bool UnpackPre(std::istream &instream, const std::vector<PreEntry> &entries, bool inflate)
+{
+    PreHeader header;
+    std::vector<char> deflated;
+    std::vector<char> inflated;
+
+    if (ReadPreHeader(instream, header) || header.numFiles != entries.size()) return true;
+
+    for (unsigned int i = 0; i < header.numFiles; ++i)
+    {
+        SubFileHeader subheader;
+
+        if (ReadSubFileHeader(instream, subheader)) return true;
+
+        uint64_t readCount = subheader.deflatedSize ? subheader.deflatedSize : subheader.inflatedSize;
+        unsigned int padding = (readCount % 4) ? (4 - (readCount % 4)) : 0;
+
+        if (!inflate)
+        {
+            instream.ignore(readCount + padding);
+            continue;
+        }
+
+        deflated.resize(readCount);
+        instream.read(deflated.data(), readCount);
+        instream.ignore(padding);
+
+        if (instream.fail()) return true;
+
+        if (subheader.deflatedSize)
+        {
+            inflated.resize(subheader.inflatedSize);
+
+            if (LzssInflate(deflated.data(), deflated.size(), inflated.data(), inflated.size())) return true;
+        }
+        else
+        {
+            inflated.swap(deflated);
+        }
+
+        if (inflated != *entries[i].data) return true;
+    }
+
+    return instream.fail();
+}
+
+bool BenchPre(const std::vector<Sample> &corpus, std::vector<Result> &results)
+{
+    std::vector<PreEntry> entries;
+    std::vector<PreEntry> index_entries;
+    std::vector<std::vector<char>> small_files;
+    std::filesystem::path prepath = globalValues.workdir / "bench.pre";
+    std::filesystem::path indexpath = globalValues.workdir / "index.pre";
+    std::string image;
+    std::string index_image;
+    unsigned long long bytes = CorpusBytes(corpus);
+
+    for (const Sample &sample : corpus)
+    {
+        entries.push_back({"bench\\" + sample.name, &sample.data});
+    }
+
+    // Lots of tiny subfiles, so that parsing the headers is most of the work.
+    for (unsigned int i = 0; i < 4096; ++i)
+    {
+        std::string contents = "script_" + std::to_string(i);
+        small_files.push_back(std::vector<char>(contents.begin(), contents.end()));
+    }
+
+    for (unsigned int i = 0; i < small_files.size(); ++i)
+    {
+        index_entries.push_back({"levels\\generated\\script_" + std::to_string(i) + ".qb", &small_files[i]});
+    }
+
+    if (TimeRuns("pre pack (memory)", bytes, entries.size(), results, [&]()
+    {
+        std::stringstream stream;
+        if (PackPre(stream, entries)) return true;
+        image = stream.str();
+        return false;
+    })) return true;
+
+    if (TimeRuns("pre unpack (memory)", bytes, entries.size(), results, [&]()
+    {
+        std::istringstream stream(image);
+        return UnpackPre(stream, entries, true);
+    })) return true;
+
+    if (TimeRuns("pre pack (disk)", bytes, entries.size(), results, [&]()
+    {
+        std::ofstream stream(prepath, std::ios::binary);
+        return stream.fail() || PackPre(stream, entries);
+    })) return true;
+
+    if (TimeRuns("pre unpack (disk)", bytes, entries.size(), results, [&]()
+    {
+        std::ifstream stream(prepath, std::ios::binary);
+        return stream.fail() || UnpackPre(stream, entries, true);
+    })) return true;
+
+    std::stringstream index_stream;
+    if (PackPre(index_stream, index_entries)) return true;
+    index_image = index_stream.str();
+
+    std::ofstream index_file(indexpath, std::ios::binary);
+    index_file.write(index_image.data(), index_image.size());
+    index_file.close();
+
+    if (index_file.fail())
+    {
+        std::cerr << "Error: Failed to write \"" << indexpath.string() << "\"" << std::endl;
+        return true;
+    }
+
+    if (TimeRuns("pre header parse (memory)", index_image.size(), index_entries.size(), results, [&]()
+    {
+        std::istringstream stream(index_image);
+        return UnpackPre(stream, index_entries, false);
+    })) return true;
+
+    if (TimeRuns("pre header parse (disk)", index_image.size(), index_entries.size(), results, [&]()
+    {
+        std::ifstream stream(indexpath, std::ios::binary);
+        return stream.fail() || UnpackPre(stream, index_entries, false);
+    })) return true;
+
+    std::error_code ec;
+    std::filesystem::remove(prepath, ec);
+    std::filesystem::remove(indexpath, ec);
+
+    return false;
+}
+
+// Convert every image in a tex file to a dds, the same way ug2-tex2dds does.
+bool TexToDds(std::istream &instream, const std::vector<std::ostream*> &outstreams)
+{
+    TexFileHeader header;
+
+    if (ReadTexHeader(instream, header) || header.num_files != outstreams.size()) return true;
+
+    for (unsigned int i = 0; i < header.num_files; ++i)
+    {
+        TexImageHeader i_header;
+        DdsFileHeader dds_header;
+        uint32_t level_size;
+
+        if (ReadImageHeader(instream, i_header)) return true;
+
+        BuildDdsHeader(i_header, dds_header);
+
+        if (WriteDdsHeader(*outstreams[i], dds_header)) return true;
+        if (ReadImageLevel(instream, *outstreams[i], i_header.size)) return true;
+
+        for (unsigned int j = 1; j < i_header.levels; ++j)
+        {
+            if (ReadImageLevelSize(instream, level_size)) return true;
+            if (ReadImageLevel(instream, *outstreams[i], level_size)) return true;
+        }
+    }
+
+    return false;
+}
+
+// Pack dds files back into a tex file, the same way ug2-dds2tex does.
+bool DdsToTex(const std::vector<std::istream*> &instreams, const std::vector<unsigned int> &checksums, std::ostream &outstream)
+{
+    std::vector<char> dds_data;
+
+    if (WriteTexHeader(outstream, instreams.size())) return true;
+
+    for (unsigned int i = 0; i < instreams.size(); ++i)
+    {
+        DdsFileHeader dds_header;
+        TexImageHeader image_header;
+
+        if (ReadDdsHeader(*instreams[i], dds_header)) return true;
+        if (GetDdsData(*instreams[i], dds_data, dds_header)) return true;
+
+        image_header.checksum = checksums[i];
+        image_header.width = dds_header.width;
+        image_header.height = dds_header.height;
+        image_header.levels = dds_header.levels;
+        image_header.dxt = dds_header.pix_fmt.fourcc[3] - '0';
+
+        if (WriteImageHeader(outstream, image_header)) return true;
+
+        outstream.write(dds_data.data(), dds_data.size());
+    }
+
+    return outstream.fail();
+}
+
+bool BenchTex(std::vector<Result> &results)
+{
+    std::vector<char> tex;
+    std::vector<std::string> dds_images;
+    std::vector<unsigned int> checksums;
+    std::vector<std::filesystem::path> dds_paths;
+    std::filesystem::path texpath = globalValues.workdir / "bench.tex.xbx";
+    std::string tex_out;
+
+    std::mt19937 rng(5678);
+    TexSettings settings;
+
+    settings.num_images = 16;
+    settings.max_dimension = 512;
+    GenerateTex(rng, settings, tex);
+
+    std::string tex_image(tex.begin(), tex.end());
+    std::istringstream header_stream(tex_image);
+    TexFileHeader header;
+    
+    ReadTexHeader(header_stream, header);
+
+    for (unsigned int i = 0; i < header.num_files; ++i)
+    {
+        TexImageHeader i_header;
+        uint32_t level_size = 0;
+
+        ReadImageHeader(header_stream, i_header);
+        checksums.push_back(i_header.checksum);
+        SkipImageLevel(header_stream, i_header.size);
+
+        for (unsigned int j = 1; j < i_header.levels; ++j)
+        {
+            ReadImageLevelSize(header_stream, level_size);
+            SkipImageLevel(header_stream, level_size);
+        }
+
+        dds_paths.push_back(globalValues.workdir / ("bench." + std::to_string(i) + ".dds"));
+    }
+
+    if (TimeRuns("tex2dds (memory)", tex.size(), header.num_files, results, [&]()
+    {
+        std::istringstream instream(tex_image);
+        std::vector<std::ostringstream> outs(header.num_files);
+        std::vector<std::ostream*> outstreams;
+
+        for (std::ostringstream &out : outs) outstreams.push_back(&out);
+
+        if (TexToDds(instream, outstreams)) return true;
+
+        dds_images.clear();
+
+        for (std::ostringstream &out : outs) dds_images.push_back(out.str());
+
+        return false;
+    })) return true;
+
+    if (TimeRuns("dds2tex (memory)", tex.size(), header.num_files, results, [&]()
+    {
+        std::vector<std::istringstream> ins;
+        std::vector<std::istream*> instreams;
+        std::ostringstream outstream;
+
+        for (const std::string &dds : dds_images) ins.emplace_back(dds);
+        for (std::istringstream &in : ins) instreams.push_back(&in);
+
+        if (DdsToTex(instreams, checksums, outstream)) return true;
+
+        tex_out = outstream.str();
+        return false;
+    })) return true;
+
+    if (tex_out != tex_image)
+    {
+        std::cerr << "Error: tex file didn't survive a round trip through dds" << std::endl;
+        return true;
+    }
+
+    std::ofstream tex_file(texpath, std::ios::binary);
+    tex_file.write(tex.data(), tex.size());
+    tex_file.close();
+
+    if (tex_file.fail())
+    {
+        std::cerr << "Error: Failed to write \"" << texpath.string() << "\"" << std::endl;
+        return true;
+    }
+
+    if (TimeRuns("tex2dds (disk)", tex.size(), header.num_files, results, [&]()
+    {
+        std::ifstream instream(texpath, std::ios::binary);
+        std::vector<std::ofstream> outs;
+        std::vector<std::ostream*> outstreams;
+
+        for (const std::filesystem::path &path : dds_paths) outs.emplace_back(path, std::ios::binary);
+        for (std::ofstream &out : outs) outstreams.push_back(&out);
+
+        return instream.fail() || TexToDds(instream, outstreams);
+    })) return true;
+
+    if (TimeRuns("dds2tex (disk)", tex.size(), header.num_files, results, [&]()
+    {
+        std::vector<std::ifstream> ins;
+        std::vector<std::istream*> instreams;
+        std::ofstream outstream(texpath, std::ios::binary);
+
+        for (const std::filesystem::path &path : dds_paths) ins.emplace_back(path, std::ios::binary);
+        for (std::ifstream &in : ins) instreams.push_back(&in);
+
+        return outstream.fail() || DdsToTex(instreams, checksums, outstream);
+    })) return true;
+
+    std::error_code ec;
+    std::filesystem::remove(texpath, ec);
+
+    for (const std::filesystem::path &path : dds_paths) std::filesystem::remove(path, ec);
+
+    return false;
+}
+
+// Write one big file and read it back through each FileIoBackend, a block at a time like the tools do, to see
+// which suits the disk the work directory is on.
+bool BenchFileIo(const std::vector<Sample> &corpus, std::vector<Result> &results)
+{
+    const FileIoBackend backends[] = {FileIoBackend::Stream, FileIoBackend::Mmap, FileIoBackend::Pread, FileIoBackend::Memory};
+    const char *names[] = {"stream", "mmap", "pread", "memory"};
+    const size_t file_size = 64 * 1024 * 1024;
+    const size_t block = 64 * 1024;
+    std::filesystem::path path = globalValues.workdir / "file_io.bin";
+    std::vector<char> data(file_size);
+    std::vector<char> readback(file_size);
+    size_t filled = 0;
+
+    // The corpus over and over, so the file isn't all zeros.
+    while (filled < data.size() && CorpusBytes(corpus))
+    {
+        for (const Sample &sample : corpus)
+        {
+            size_t count = std::min(sample.data.size(), data.size() - filled);
+
+            std::copy(sample.data.begin(), sample.data.begin() + count, data.begin() + filled);
+            filled += count;
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); ++i)
+    {
+        SetFileIoBackend(backends[i]);
+
+        if (TimeRuns(std::string("file write (") + names[i] + ")", data.size(), data.size() / block, results, [&]()
+        {
+            FileSink sink;
+
+            if (sink.Create(path)) return true;
+
+            for (size_t offset = 0; offset < data.size(); offset += block)
+            {
+                sink.Stream().write(data.data() + offset, block);
+            }
+
+            return sink.Close();
+        })) return true;
+
+        if (TimeRuns(std::string("file read (") + names[i] + ")", data.size(), data.size() / block, results, [&]()
+        {
+            FileSource source;
+
+            if (source.Open(path)) return true;
+
+            for (size_t offset = 0; offset < readback.size(); offset += block)
+            {
+                source.Stream().read(readback.data() + offset, block);
+            }
+
+            return source.Stream().fail() || readback != data;
+        })) return true;
+    }
+
+    SetFileIoBackend(FileIoBackend::Stream);
+
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+
+    return false;
+}
+
+// Write lots of small files through each FileWriter backend, like ug2-pre-unpack does with a script heavy pre
+// file, so that the system calls around each file are most of the work.
+bool BenchFiles(std::vector<Result> &results)
+{
+    std::filesystem::path dir = globalValues.workdir / "files";
+    std::vector<std::filesystem::path> paths;
+    std::vector<std::vector<char>> contents;
+    unsigned long long bytes = 0;
+    std::error_code ec;
+
+    std::filesystem::create_directories(dir, ec);
+
+    if (ec)
+    {
+        std::cerr << "Error: Failed to create directory \"" << dir.string() << "\"" << std::endl;
+        return true;
+    }
+
+    for (unsigned int i = 0; i < 4096; ++i)
+    {
+        std::string text = "script_" + std::to_string(i) + std::string(i % 2048, 'x');
+        paths.push_back(dir / ("script_" + std::to_string(i) + ".qb"));
+        contents.push_back(std::vector<char>(text.begin(), text.end()));
+        bytes += text.size();
+    }
+
+    auto write = [&](FileWriter &writer)
+    {
+        for (unsigned int i = 0; i < paths.size(); ++i)
+        {
+            if (writer.Write(paths[i], std::vector<char>(contents[i]))) return true;
+        }
+
+        return writer.Flush();
+    };
+
+    FileWriter blocking;
+    if (TimeRuns("write files (blocking)", bytes, paths.size(), results, [&]() {return write(blocking);})) return true;
+
+    // io_uring can be missing from the kernel or blocked by a sandbox, which isn't a failure of the benchmark.
+    FileWriter uring;
+    if (!uring.SetBackend(FileWriterBackend::IoUring))
+    {
+        if (TimeRuns("write files (io_uring)", bytes, paths.size(), results, [&]() {return write(uring);})) return true;
+    }
+
+    std::filesystem::remove_all(dir, ec);
+
+    return false;
+}
+
+void PrintResults(const std::vector<Result> &results)
+{
+    std::cout << std::left << std::setw(28) << "benchmark" << std::right << std::setw(14) << "bytes" << std::setw(8) << "entries";
+    std::cout << std::setw(12) << "MiB/s" << std::setw(14) << "ns/entry" << std::endl << std::endl;
+
+    for (const Result &result : results)
+    {
+        std::cout << std::left << std::setw(28) << result.name << std::right << std::setw(14) << result.bytes << std::setw(8) << result.entries;
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << std::setw(12) << result.bytes / (1024.0 * 1024.0) / result.seconds;
+        std::cout << std::setw(14) << result.seconds * 1e9 / result.entries << std::endl;
+        std::cout << std::defaultfloat;
+    }
+}
+
+bool WriteJson(const std::vector<Result> &results)
+{
+    std::ofstream outstream(globalValues.jsonpath);
+
+    if (outstream.fail())
+    {
+        std::cerr << "Error: Failed to create \"" << globalValues.jsonpath.string() << "\"" << std::endl;
+        return true;
+    }
+
+    // Benchmark names are plain ascii, so they don't need escaping.
+    outstream << "{" << std::endl;
+    outstream << "  \"benchmarks\": [" << std::endl;
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const Result &result = results[i];
+
+        outstream << "    {\"name\": \"" << result.name << "\", ";
+        outstream << "\"bytes\": " << result.bytes << ", ";
+        outstream << "\"entries\": " << result.entries << ", ";
+        outstream << std::setprecision(9) << "\"seconds\": " << result.seconds << ", ";
+        outstream << "\"mib_per_s\": " << result.bytes / (1024.0 * 1024.0) / result.seconds << ", ";
+        outstream << "\"ns_per_entry\": " << result.seconds * 1e9 / result.entries << "}";
+        outstream << ((i + 1 < results.size()) ? "," : "") << std::endl;
+    }
+
+    outstream << "  ]" << std::endl;
+    outstream << "}" << std::endl;
+
+    if (outstream.fail())
+    {
+        std::cerr << "Error: Failed to write \"" << globalValues.jsonpath.string() << "\"" << std::endl;
+        return true;
+    }
+
+    return false;
+}
+
+
+// Read the name and throughput of each benchmark from a file written by WriteJson. WriteJson puts each
+// benchmark on its own line, which is all this handles.
+bool ReadBaseline(std::vector<std::pair<std::string, double>> &baseline)
+{
+    std::ifstream instream(globalValues.baselinepath);
+    std::string line;
+
+    if (instream.fail())
+    {
+        std::cerr << "Error: Failed to open baseline \"" << globalValues.baselinepath.string() << "\"" << std::endl;
+        return true;
+    }
+
+    while (std::getline(instream, line))
+    {
+        const std::string name_key = "\"name\": \"";
+        std::string rate_key = "\"mib_per_s\": ";
+        size_t name_pos = line.find(name_key);
+        size_t rate_pos = line.find(rate_key);
+
+        // Older baselines call it mb_per_s, but it was always MiB/s.
+        if (rate_pos == std::string::npos)
+        {
+            rate_key = "\"mb_per_s\": ";
+            rate_pos = line.find(rate_key);
+        }
+
+        if (name_pos == std::string::npos || rate_pos == std::string::npos) continue;
+
+        name_pos += name_key.size();
+        size_t name_end = line.find('"', name_pos);
+
+        if (name_end == std::string::npos) continue;
+
+        baseline.push_back({line.substr(name_pos, name_end - name_pos), std::atof(line.c_str() + rate_pos + rate_key.size())});
+    }
+
+    if (baseline.empty())
+    {
+        std::cerr << "Error: No results in baseline \"" << globalValues.baselinepath.string() << "\"" << std::endl;
+        return true;
+    }
+
+    return false;
+}
+
+bool CompareBaseline(const std::vector<Result> &results, bool &regressed)
+{
+    std::vector<std::pair<std::string, double>> baseline;
+
+    if (ReadBaseline(baseline)) return true;
+
+    std::cout << std::endl << std::left << std::setw(28) << "benchmark" << std::right << std::setw(14) << "baseline MiB/s";
+    std::cout << std::setw(12) << "MiB/s" << std::setw(10) << "change" << std::endl << std::endl;
+
+    for (const Result &result : results)
+    {
+        double rate = result.bytes / (1024.0 * 1024.0) / result.seconds;
+
+        for (const std::pair<std::string, double> &entry : baseline)
+        {
+            if (entry.first != result.name || entry.second <= 0) continue;
+
+            double change = (rate - entry.second) / entry.second * 100;
+            bool slow = change < -globalValues.max_slowdown;
+
+            std::cout << std::left << std::setw(28) << result.name << std::right << std::fixed << std::setprecision(1);
+            std::cout << std::setw(14) << entry.second << std::setw(12) << rate << std::setw(9) << std::showpos << change << "%";
+            std::cout << std::noshowpos << std::defaultfloat << (slow ? "  REGRESSION" : "") << std::endl;
+
+            regressed = regressed || slow;
+        }
+    }
+
+    return false;
+}
\ No newline at end of file
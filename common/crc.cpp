@@ -19,6 +19,7 @@
 // SOFTWARE.
 
 #include <string>
+#include <stdint.h>
 
 static unsigned int crc_table[] =
 {
@@ -101,11 +102,11 @@ unsigned int StringCRC(const std::string &str)
 	return crc;
 }
 
-unsigned int BufferCRC(const char *buffer, unsigned int size)
+unsigned int BufferCRC(const char *buffer, uint64_t size)
 {
 	unsigned int crc = 0xffffffff;
 
-	for (unsigned int i = 0; i < size; ++i)
+	for (uint64_t i = 0; i < size; ++i)
 	{
 		unsigned int table_val = crc_table[static_cast<unsigned char>(crc) ^ static_cast<unsigned char>(buffer[i])];
 		crc = table_val ^ (crc >> 8);
@@ -21,6 +21,7 @@
 #pragma once
 
 #include <string>
+#include <stdint.h>
 
 unsigned int StringCRC(const std::string &str);
-unsigned int BufferCRC(const char *buffer, unsigned int size);
\ No newline at end of file
+unsigned int BufferCRC(const char *buffer, uint64_t size);
\ No newline at end of file
@@ -0,0 +1,685 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "../common/file_io.hpp"
+#include "../common/memory_stream.hpp"
+#include "../common/std_stream.hpp"
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#endif
+
+namespace
+{
+    // Stream buffers and pread/pwrite blocks are this big, so that a system call is only a small part of the
+    // cost of each one.
+    const size_t block_size = 256 * 1024;
+
+    FileIoBackend currentBackend = FileIoBackend::Stream;
+}
+
+bool ParseFileIoBackend(const std::string &name, FileIoBackend &out)
+{
+    if (name == "stream") out = FileIoBackend::Stream;
+    else if (name == "mmap") out = FileIoBackend::Mmap;
+    else if (name == "pread") out = FileIoBackend::Pread;
+    else if (name == "memory") out = FileIoBackend::Memory;
+    else return true;
+
+    return false;
+}
+
+void SetFileIoBackend(FileIoBackend backend)
+{
+    currentBackend = backend;
+}
+
+FileIoBackend GetFileIoBackend()
+{
+    return currentBackend;
+}
+
+bool SyncFile(const std::filesystem::path &path)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    // fsync flushes the file, not just what was written through this descriptor.
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) return true;
+
+    bool failed = fsync(fd) != 0;
+    close(fd);
+
+    return failed;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+// Reads a block at a time with pread, keeping track of the offset itself. Reads bigger than a block go
+// straight to where they're wanted.
+struct FileSource::PreadBuf : public std::streambuf
+{
+    int fd;
+    uint64_t offset = 0;
+    std::vector<char> block;
+
+    PreadBuf(int fd) : fd(fd), block(block_size) {}
+
+    ~PreadBuf()
+    {
+        close(fd);
+    }
+
+    // Returns how much was read, 0 at the end of the file, or -1 on failure.
+    ssize_t ReadAt(char *out, size_t count)
+    {
+        ssize_t got;
+
+        do
+        {
+            got = ::pread(fd, out, count, offset);
+        } while (got < 0 && errno == EINTR);
+
+        if (got > 0) offset += got;
+
+        return got;
+    }
+
+    int_type underflow() override
+    {
+        if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+        ssize_t got = ReadAt(block.data(), block.size());
+
+        if (got <= 0) return traits_type::eof();
+
+        setg(block.data(), block.data(), block.data() + got);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    std::streamsize xsgetn(char *out, std::streamsize count) override
+    {
+        std::streamsize done = 0;
+
+        while (done < count)
+        {
+            std::streamsize buffered = std::min<std::streamsize>(count - done, egptr() - gptr());
+
+            if (buffered > 0)
+            {
+                memcpy(out + done, gptr(), buffered);
+                gbump(static_cast<int>(buffered));
+                done += buffered;
+            }
+            else if (static_cast<size_t>(count - done) >= block.size())
+            {
+                ssize_t got = ReadAt(out + done, count - done);
+
+                if (got <= 0) break;
+
+                done += got;
+            }
+            else if (traits_type::eq_int_type(underflow(), traits_type::eof()))
+            {
+                break;
+            }
+        }
+
+        return done;
+    }
+};
+
+// Fills a block and writes it out with pwrite once it's full, keeping track of the offset itself. Writes
+// bigger than a block skip it.
+struct FileSink::PwriteBuf : public std::streambuf
+{
+    int fd;
+    uint64_t offset = 0;
+    std::vector<char> block;
+
+    PwriteBuf(int fd) : fd(fd), block(block_size)
+    {
+        setp(block.data(), block.data() + block.size());
+    }
+
+    ~PwriteBuf()
+    {
+        if (fd >= 0) close(fd);
+    }
+
+    // Returns true on failure.
+    bool WriteAt(const char *in, size_t count)
+    {
+        while (count)
+        {
+            ssize_t put = ::pwrite(fd, in, count, offset);
+
+            if (put < 0 && errno == EINTR) continue;
+            if (put <= 0) return true;
+
+            in += put;
+            count -= put;
+            offset += put;
+        }
+
+        return false;
+    }
+
+    // Write out the block and start a new one. Returns true on failure.
+    bool Drain()
+    {
+        bool failed = WriteAt(pbase(), pptr() - pbase());
+
+        setp(block.data(), block.data() + block.size());
+        return failed;
+    }
+
+    // Returns true if the file couldn't be finished.
+    bool Finish()
+    {
+        bool failed = Drain();
+
+        failed = (close(fd) != 0) || failed;
+        fd = -1;
+
+        return failed;
+    }
+
+    int_type overflow(int_type c) override
+    {
+        if (Drain()) return traits_type::eof();
+
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char *in, std::streamsize count) override
+    {
+        if (count > epptr() - pptr())
+        {
+            if (Drain()) return 0;
+
+            if (static_cast<size_t>(count) >= block.size()) return WriteAt(in, count) ? 0 : count;
+        }
+
+        memcpy(pptr(), in, count);
+        pbump(static_cast<int>(count));
+        return count;
+    }
+
+    int sync() override
+    {
+        return Drain() ? -1 : 0;
+    }
+
+    pos_type seekoff(off_type off, std::ios::seekdir dir, std::ios::openmode which) override
+    {
+        uint64_t position = offset + (pptr() - pbase());
+        struct stat st;
+
+        if (!(which & std::ios::out)) return pos_type(off_type(-1));
+        if (dir == std::ios::cur && off == 0) return pos_type(position);
+        if (Drain()) return pos_type(off_type(-1));
+
+        if (dir == std::ios::beg) position = 0;
+
+        if (dir == std::ios::end)
+        {
+            if (fstat(fd, &st)) return pos_type(off_type(-1));
+
+            position = st.st_size;
+        }
+
+        if (off < 0 && static_cast<uint64_t>(-off) > position) return pos_type(off_type(-1));
+
+        offset = position + off;
+        return pos_type(offset);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios::openmode which) override
+    {
+        return seekoff(off_type(pos), std::ios::beg, which);
+    }
+};
+
+#else
+
+struct FileSource::PreadBuf : public std::streambuf {};
+struct FileSink::PwriteBuf : public std::streambuf {};
+
+#endif
+
+// Writes into one block that grows as needed, either in memory or mapped from the file itself, and keeps track
+// of how far the file goes so a mapped file can be cut back to size once it's done.
+struct FileSink::BlockBuf : public std::streambuf
+{
+    int fd;     // The file the block is mapped from, or -1 for memory
+    std::vector<char> memory;
+    char *base = nullptr;
+    uint64_t capacity = 0;
+    uint64_t end = 0;
+
+    BlockBuf(int fd) : fd(fd) {}
+
+    ~BlockBuf()
+    {
+        Unmap();
+    }
+
+    uint64_t Position() const
+    {
+        return pptr() - base;
+    }
+
+    void MarkEnd()
+    {
+        end = std::max(end, Position());
+    }
+
+    void Unmap()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        if (fd >= 0 && base) munmap(base, capacity);
+        if (fd >= 0) close(fd);
+#endif
+        fd = -1;
+        base = nullptr;
+        capacity = 0;
+    }
+
+    // Make room for at least needed bytes. Mapped files are grown along with the block, and the new part
+    // reads as zeros either way. Returns true on failure.
+    bool Reserve(uint64_t needed)
+    {
+        if (needed <= capacity) return false;
+
+        uint64_t position = Position();
+        uint64_t grown = std::max<uint64_t>({needed, capacity + capacity / 2, block_size});
+
+        MarkEnd();
+        setp(nullptr, nullptr);
+
+        if (fd < 0)
+        {
+            memory.resize(grown);
+            base = memory.data();
+        }
+        else
+        {
+#if defined(__unix__) || defined(__APPLE__)
+            if (base && munmap(base, capacity)) return true;
+
+            base = nullptr;
+            capacity = 0;
+
+            if (ftruncate(fd, grown)) return true;
+
+#if defined(__linux__)
+            // As with MappedOutFile, running out of space while writing to a mapping kills the process, so the
+            // space is claimed first.
+            if (posix_fallocate(fd, 0, grown) == ENOSPC) return true;
+#endif
+
+            void *view = mmap(nullptr, grown, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+            if (view == MAP_FAILED) return true;
+
+            base = static_cast<char*>(view);
+#else
+            return true;
+#endif
+        }
+
+        capacity = grown;
+        setp(base + position, base + capacity);
+        return false;
+    }
+
+    // Returns true if the file couldn't be finished.
+    bool Finish()
+    {
+        bool failed = false;
+
+        MarkEnd();
+
+#if defined(__unix__) || defined(__APPLE__)
+        if (fd >= 0)
+        {
+            failed = (base && munmap(base, capacity) != 0);
+            failed = (ftruncate(fd, end) != 0) || failed;
+            failed = (close(fd) != 0) || failed;
+            fd = -1;
+            base = nullptr;
+            capacity = 0;
+        }
+#endif
+
+        return failed;
+    }
+
+    int_type overflow(int_type c) override
+    {
+        if (traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+        if (Reserve(Position() + 1)) return traits_type::eof();
+
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+        return c;
+    }
+
+    std::streamsize xsputn(const char *in, std::streamsize count) override
+    {
+        if (count <= 0) return 0;
+        if (Reserve(Position() + count)) return 0;
+
+        uint64_t position = Position() + count;
+
+        memcpy(pptr(), in, count);
+        setp(base + position, base + capacity);
+        return count;
+    }
+
+    // Seeking past the end leaves zeros behind, as with a file.
+    pos_type seekoff(off_type off, std::ios::seekdir dir, std::ios::openmode which) override
+    {
+        uint64_t position = Position();
+
+        if (!(which & std::ios::out)) return pos_type(off_type(-1));
+
+        MarkEnd();
+
+        if (dir == std::ios::beg) position = 0;
+        if (dir == std::ios::end) position = end;
+
+        if (off < 0 && static_cast<uint64_t>(-off) > position) return pos_type(off_type(-1));
+
+        position += off;
+
+        if (Reserve(position)) return pos_type(off_type(-1));
+
+        setp(base + position, base + capacity);
+        return pos_type(position);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios::openmode which) override
+    {
+        return seekoff(off_type(pos), std::ios::beg, which);
+    }
+};
+
+FileSource::FileSource() = default;
+
+FileSource::~FileSource()
+{
+    Close();
+}
+
+bool FileSource::Open(const std::filesystem::path &path)
+{
+    std::error_code ec;
+
+    Close();
+
+    backend = currentBackend;
+    sized = !IsStdStream(path) && std::filesystem::is_regular_file(path, ec);
+
+    if (sized) size = std::filesystem::file_size(path, ec);
+
+#if defined(__unix__) || defined(__APPLE__)
+    if (!sized && (backend == FileIoBackend::Mmap || backend == FileIoBackend::Pread)) backend = FileIoBackend::Stream;
+#else
+    if (!sized && backend == FileIoBackend::Mmap) backend = FileIoBackend::Stream;
+    if (backend == FileIoBackend::Pread) backend = FileIoBackend::Stream;
+#endif
+
+    if (backend == FileIoBackend::Mmap)
+    {
+        if (mapped.Open(path)) return true;
+
+        data = mapped.Data();
+        size = mapped.Size();
+        loaded = true;
+        ownStream = std::make_unique<MemoryInStream>(data, size);
+        stream = ownStream.get();
+        return false;
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    if (backend == FileIoBackend::Pread)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+
+        if (fd < 0) return true;
+
+        pread = std::make_unique<PreadBuf>(fd);
+        ownStream = std::make_unique<std::istream>(pread.get());
+        stream = ownStream.get();
+        return false;
+    }
+#endif
+
+    // The buffer has to be set before the file is opened to be used.
+    streamBuffer.resize(block_size);
+    file.rdbuf()->pubsetbuf(streamBuffer.data(), streamBuffer.size());
+    stream = &OpenInStream(path, file);
+
+    if (stream->fail()) return true;
+
+    if (backend == FileIoBackend::Memory)
+    {
+        if (Load()) return true;
+
+        file.close();
+        ownStream = std::make_unique<MemoryInStream>(data, size);
+        stream = ownStream.get();
+    }
+
+    return false;
+}
+
+void FileSource::Close()
+{
+    ownStream.reset();
+    pread.reset();
+
+    if (file.is_open()) file.close();
+
+    file.clear();
+    mapped.Close();
+    buffer.clear();
+    buffer.shrink_to_fit();
+    stream = nullptr;
+    data = nullptr;
+    size = 0;
+    sized = false;
+    loaded = false;
+}
+
+std::istream &FileSource::Stream()
+{
+    return stream ? *stream : file;
+}
+
+bool FileSource::Load()
+{
+    if (loaded) return false;
+    if (ReadAll(buffer)) return true;
+
+    data = buffer.data();
+    size = buffer.size();
+    loaded = true;
+    return false;
+}
+
+bool FileSource::ReadAll(std::vector<char> &out)
+{
+    if (!stream) return true;
+
+    if (loaded)
+    {
+        out.assign(data, data + size);
+        return false;
+    }
+
+    // Files with a known size are read in one go rather than a chunk at a time.
+    if (sized)
+    {
+        out.resize(size);
+        stream->read(out.data(), size);
+
+        return static_cast<uint64_t>(stream->gcount()) != size;
+    }
+
+    return ReadWholeStream(*stream, out);
+}
+
+void FileSource::Release(uint64_t offset)
+{
+    if (backend == FileIoBackend::Mmap) mapped.Release(offset);
+}
+
+FileSink::FileSink() = default;
+
+FileSink::~FileSink()
+{
+    Close();
+}
+
+bool FileSink::Create(const std::filesystem::path &path, uint64_t sizehint)
+{
+    Close();
+
+    backend = currentBackend;
+
+#if defined(__unix__) || defined(__APPLE__)
+    if (IsSequentialOutput(path) && (backend == FileIoBackend::Mmap || backend == FileIoBackend::Pread)) backend = FileIoBackend::Stream;
+#else
+    if (backend == FileIoBackend::Mmap || backend == FileIoBackend::Pread) backend = FileIoBackend::Stream;
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+    if (backend == FileIoBackend::Mmap || backend == FileIoBackend::Pread)
+    {
+        // Mapping a file for writing needs it open for reading too.
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+
+        if (fd < 0) return true;
+
+        if (backend == FileIoBackend::Mmap)
+        {
+            block = std::make_unique<BlockBuf>(fd);
+            ownStream = std::make_unique<std::ostream>(block.get());
+
+            if (block->Reserve(sizehint))
+            {
+                Close();
+                return true;
+            }
+        }
+        else
+        {
+            pwrite = std::make_unique<PwriteBuf>(fd);
+            ownStream = std::make_unique<std::ostream>(pwrite.get());
+        }
+
+        stream = ownStream.get();
+        return false;
+    }
+#endif
+
+    streamBuffer.resize(block_size);
+    file.rdbuf()->pubsetbuf(streamBuffer.data(), streamBuffer.size());
+    stream = &OpenOutStream(path, file);
+
+    if (stream->fail()) return true;
+
+    // The file is opened now so that anything wrong with it shows up here, but it's only written at the end.
+    if (backend == FileIoBackend::Memory)
+    {
+        target = stream;
+        block = std::make_unique<BlockBuf>(-1);
+        block->Reserve(sizehint);
+        ownStream = std::make_unique<std::ostream>(block.get());
+        stream = ownStream.get();
+    }
+
+    return false;
+}
+
+bool FileSink::Close()
+{
+    bool failed = stream && stream->fail();
+
+    if (stream) stream->flush();
+
+    if (pwrite) failed = pwrite->Finish() || failed;
+
+    if (block)
+    {
+        failed = block->Finish() || failed;
+
+        if (target)
+        {
+            target->write(block->base, block->end);
+            target->flush();
+            failed = target->fail() || failed;
+        }
+    }
+
+    if (file.is_open())
+    {
+        file.close();
+        failed = file.fail() || failed;
+    }
+    else if (stream)
+    {
+        failed = stream->fail() || failed;
+    }
+
+    ownStream.reset();
+    block.reset();
+    pwrite.reset();
+    file.clear();
+    stream = nullptr;
+    target = nullptr;
+
+    return failed;
+}
+
+std::ostream &FileSink::Stream()
+{
+    return stream ? *stream : file;
+}
\ No newline at end of file
@@ -0,0 +1,141 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stdint.h>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "../common/mapped_file.hpp"
+
+// How FileSource and FileSink get at the disk. Which one is fastest depends on where the files are: mapping
+// does well on a local disk or tmpfs, while plain reads and writes of a few big blocks tend to suit network
+// filesystems better.
+enum class FileIoBackend
+{
+    Stream,     // Buffered C++ file streams
+    Mmap,       // Memory mapped files
+    Pread,      // pread and pwrite through a fixed buffer, one system call per block
+    Memory,     // Read the whole file in when opened, or write it out in one go when closed
+};
+
+// Parse the name of a backend, "stream", "mmap", "pread" or "memory". Returns true on failure.
+bool ParseFileIoBackend(const std::string &name, FileIoBackend &out);
+
+// The backend every FileSource and FileSink opened from now on uses. Stream to begin with.
+void SetFileIoBackend(FileIoBackend backend);
+FileIoBackend GetFileIoBackend();
+
+// Make sure everything written to the closed file at path has reached the disk, such as before renaming it over
+// another file. Does nothing where there's no fsync. Returns true on failure.
+bool SyncFile(const std::filesystem::path &path);
+
+// A file being read. "-" reads stdin. Only regular files can be mapped or read at an offset, so anything else,
+// and anything on a platform without pread, is read with Stream in place of Mmap or Pread.
+class FileSource
+{
+public:
+    FileSource();
+    ~FileSource();
+
+    FileSource(const FileSource &) = delete;
+    FileSource &operator=(const FileSource &) = delete;
+
+    // Returns true on failure.
+    bool Open(const std::filesystem::path &path);
+    void Close();
+
+    // Read the file front to back. Check fail() on it as with any stream.
+    std::istream &Stream();
+
+    // Make the whole file readable through Data() and Size(), for going back and forth in it. Mapped files are
+    // already there, anything else is read into memory. Don't mix this with reading from Stream(). Returns true
+    // on failure.
+    bool Load();
+
+    // Copy the whole file into out, for files that are wanted in a buffer of their own. As with Load(), don't
+    // mix this with reading from Stream(). Returns true on failure.
+    bool ReadAll(std::vector<char> &out);
+
+    const char *Data() const {return data;}
+
+    // The size of the file, or of what's been loaded from stdin.
+    uint64_t Size() const {return size;}
+
+    // Let the OS drop the loaded data before offset, as MappedFile::Release() does. Only mapped files give
+    // anything back.
+    void Release(uint64_t offset);
+
+private:
+    struct PreadBuf;
+
+    FileIoBackend backend = FileIoBackend::Stream;
+    std::vector<char> streamBuffer;
+    std::ifstream file;
+    std::istream *stream = nullptr;
+    MappedFile mapped;
+    std::vector<char> buffer;
+    std::unique_ptr<std::istream> ownStream;
+    std::unique_ptr<PreadBuf> pread;
+    const char *data = nullptr;
+    uint64_t size = 0;
+    bool sized = false;
+    bool loaded = false;
+};
+
+// A file being written, replacing whatever was there. "-" writes stdout. As with FileSource, Mmap and Pread
+// need a regular file and fall back to Stream for anything else. Stream() can be seeked back over wherever the
+// file underneath can, and always with Memory.
+class FileSink
+{
+public:
+    FileSink();
+    ~FileSink();
+
+    FileSink(const FileSink &) = delete;
+    FileSink &operator=(const FileSink &) = delete;
+
+    // sizehint is how big the file is expected to end up, if that's known, so space can be set aside for it.
+    // Returns true on failure.
+    bool Create(const std::filesystem::path &path, uint64_t sizehint = 0);
+
+    // Flush everything to the file and close it. Returns true if the file couldn't be finished.
+    bool Close();
+
+    std::ostream &Stream();
+
+private:
+    struct BlockBuf;
+    struct PwriteBuf;
+
+    FileIoBackend backend = FileIoBackend::Stream;
+    std::vector<char> streamBuffer;
+    std::ofstream file;
+    std::ostream *stream = nullptr;
+    std::ostream *target = nullptr;
+    std::unique_ptr<std::ostream> ownStream;
+    std::unique_ptr<BlockBuf> block;
+    std::unique_ptr<PwriteBuf> pwrite;
+};
\ No newline at end of file
@@ -0,0 +1,531 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "../common/file_writer.hpp"
+#include "../common/file_io.hpp"
+#include "../common/stats.hpp"
+#include "../common/trace.hpp"
+#include <iostream>
+#include <initializer_list>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define UG2TOOLS_IO_URING
+#endif
+#endif
+
+#if defined(UG2TOOLS_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#endif
+
+namespace
+{
+    // A batch is sent once this many files or bytes are queued. Each file takes two ring entries at once, one
+    // to write it and one to close it.
+    const size_t batch_files = 64;
+    const uint64_t batch_bytes = 64 * 1024 * 1024;
+}
+
+bool ParseFileWriterBackend(const std::string &name, FileWriterBackend &out)
+{
+    if (name == "blocking")
+    {
+        out = FileWriterBackend::Blocking;
+        return false;
+    }
+
+    if (name == "uring")
+    {
+        out = FileWriterBackend::IoUring;
+        return false;
+    }
+
+    return true;
+}
+
+#if defined(UG2TOOLS_IO_URING)
+
+// A bare io_uring set up through the system calls, so there's nothing to link against. Only what FileWriter
+// needs is here: fill in entries, send them all, and wait for the same number of completions.
+struct FileWriter::Ring
+{
+    int fd = -1;
+    void *sqRing = MAP_FAILED;
+    void *cqRing = MAP_FAILED;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    io_uring_sqe *sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+    unsigned *sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned *sqArray = nullptr;
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe *cqes = nullptr;
+    unsigned pending = 0;       // Filled in but not sent yet
+    unsigned outstanding = 0;   // Sent but not completed yet
+
+    ~Ring()
+    {
+        if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+        if (fd >= 0) close(fd);
+    }
+
+    bool Setup(unsigned entries)
+    {
+        io_uring_params params;
+
+        memset(&params, 0, sizeof(params));
+        fd = syscall(__NR_io_uring_setup, entries, &params);
+
+        if (fd < 0) return true;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            if (cqRingSize > sqRingSize) sqRingSize = cqRingSize;
+            cqRingSize = sqRingSize;
+        }
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+
+        if (sqRing == MAP_FAILED) return true;
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            cqRing = sqRing;
+        }
+        else
+        {
+            cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+
+            if (cqRing == MAP_FAILED) return true;
+        }
+
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+
+        if (sqes == MAP_FAILED) return true;
+
+        char *sq = static_cast<char*>(sqRing);
+        char *cq = static_cast<char*>(cqRing);
+
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        return !Supported({IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE});
+    }
+
+    // Kernels before 5.6 have io_uring without opening and closing files, and without a way to ask, so there the
+    // probe itself fails.
+    bool Supported(std::initializer_list<unsigned> ops)
+    {
+        const unsigned probeOps = 256;
+        std::vector<char> buffer(sizeof(io_uring_probe) + probeOps * sizeof(io_uring_probe_op), 0);
+        io_uring_probe *probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, probeOps) < 0) return false;
+
+        for (unsigned op : ops)
+        {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+
+        return true;
+    }
+
+    io_uring_sqe &Next()
+    {
+        unsigned tail = *sqTail;
+        unsigned index = tail & sqMask;
+        io_uring_sqe &sqe = sqes[index];
+
+        memset(&sqe, 0, sizeof(sqe));
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        ++pending;
+
+        return sqe;
+    }
+
+    // Send everything filled in since the last call and hand each completion to done as it comes in. If the
+    // kernel refuses an entry, the ones it hasn't taken are taken back and the ones it has are still waited for,
+    // so their buffers and file descriptors can be used again once this returns. outstanding is left at 0 unless
+    // even waiting fails, and then nothing those entries point to can be touched again.
+    template <typename Fn>
+    bool SubmitAndWait(Fn done)
+    {
+        unsigned toSubmit = pending;
+        bool failed = false;
+
+        pending = 0;
+        outstanding = 0;
+
+        while (toSubmit || outstanding)
+        {
+            int result = syscall(__NR_io_uring_enter, fd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+            if (result < 0)
+            {
+                if (errno == EINTR) continue;
+
+                if (toSubmit)
+                {
+                    // Nothing reads the submission queue outside io_uring_enter, so these can be dropped.
+                    __atomic_store_n(sqTail, *sqTail - toSubmit, __ATOMIC_RELEASE);
+                    toSubmit = 0;
+                    failed = true;
+                    continue;
+                }
+
+                if (errno == EAGAIN || errno == EBUSY) continue;
+                return true;
+            }
+
+            toSubmit -= result;
+            outstanding += result;
+
+            unsigned head = *cqHead;
+
+            while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+            {
+                const io_uring_cqe &cqe = cqes[head & cqMask];
+
+                done(cqe.user_data, cqe.res);
+                ++head;
+                --outstanding;
+            }
+
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        }
+
+        return failed;
+    }
+};
+
+#else
+
+struct FileWriter::Ring
+{
+};
+
+#endif
+
+FileWriter::FileWriter() = default;
+
+FileWriter::~FileWriter() = default;
+
+bool FileWriter::SetBackend(FileWriterBackend backend)
+{
+    Flush();
+    ring.reset();
+    this->backend = FileWriterBackend::Blocking;
+
+    if (backend == FileWriterBackend::Blocking) return false;
+
+#if defined(UG2TOOLS_IO_URING)
+    ring.reset(new Ring);
+
+    if (ring->Setup(2 * batch_files))
+    {
+        ring.reset();
+        return true;
+    }
+
+    this->backend = backend;
+    return false;
+#else
+    return true;
+#endif
+}
+
+bool FileWriter::Write(const std::filesystem::path &path, std::vector<char> &&data)
+{
+    if (backend == FileWriterBackend::Blocking)
+    {
+        QueuedFile file;
+
+        file.path = path;
+        file.data = std::move(data);
+        return WriteNow(file);
+    }
+
+    // The batch is opened all at once, so two files for the same path can't be in the same batch.
+    if (Queued(path) && Flush()) return true;
+
+    queuedBytes += data.size();
+    queuedPaths.insert(path);
+    queue.push_back({path, std::move(data)});
+
+    if (queue.size() >= batch_files || queuedBytes >= batch_bytes) return Flush();
+
+    return false;
+}
+
+bool FileWriter::Queued(const std::filesystem::path &path) const
+{
+    return queuedPaths.count(path) != 0;
+}
+
+bool FileWriter::Flush()
+{
+    if (queue.empty()) return false;
+
+    bool failed = WriteBatch();
+
+    queue.clear();
+    queuedPaths.clear();
+    queuedBytes = 0;
+
+    return failed;
+}
+
+bool FileWriter::WriteNow(const QueuedFile &file)
+{
+    FileSink outfile;
+
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+        TraceSpan span("open");
+
+        if (outfile.Create(file.path, file.data.size()))
+        {
+            std::cerr << "Error: Unable to create file \"" << file.path.string() << "\"" << std::endl;
+            return true;
+        }
+    }
+
+    {
+        StatsTimer timer(StatsPhase::Write);
+        TraceSpan span("write");
+
+        outfile.Stream().write(file.data.data(), file.data.size());
+
+        if (outfile.Stream().fail())
+        {
+            std::cerr << "Error: Failed to write file \"" << file.path.string() << "\"" << std::endl;
+            return true;
+        }
+
+        StatsAddWritten(file.data.size());
+    }
+
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+        TraceSpan span("close");
+
+        if (outfile.Close())
+        {
+            std::cerr << "Error: Failed to write file \"" << file.path.string() << "\"" << std::endl;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Keep the queued files and the ring they were sent on for as long as the writer lives, since the kernel may
+// still be reading from them, and write anything after this the blocking way.
+void FileWriter::Strand()
+{
+    for (QueuedFile &file : queue)
+    {
+        std::cerr << "Error: Failed to write file \"" << file.path.string() << "\"" << std::endl;
+        stranded.push_back(std::move(file));
+    }
+
+    strandedRing = std::move(ring);
+    backend = FileWriterBackend::Blocking;
+}
+
+// Every file in the queue is opened in one go, then written and closed in another. A write that comes up
+// short cancels its close, and the rest of it is written the ordinary way.
+bool FileWriter::WriteBatch()
+{
+#if defined(UG2TOOLS_IO_URING)
+    bool failed = false;
+    std::vector<int> written(queue.size(), 0);
+    std::vector<int> closed(queue.size(), -ECANCELED);
+
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+        TraceSpan span("open");
+
+        for (size_t i = 0; i < queue.size(); ++i)
+        {
+            io_uring_sqe &sqe = ring->Next();
+
+            sqe.opcode = IORING_OP_OPENAT;
+            sqe.fd = AT_FDCWD;
+            sqe.addr = reinterpret_cast<uintptr_t>(queue[i].path.c_str());
+            sqe.open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+            sqe.len = 0666;
+            sqe.user_data = i;
+        }
+
+        if (ring->SubmitAndWait([&](uint64_t i, int result) {queue[i].fd = result;}))
+        {
+            std::cerr << "Error: io_uring failed to open files" << std::endl;
+
+            if (ring->outstanding)
+            {
+                Strand();
+                return true;
+            }
+
+            for (QueuedFile &file : queue)
+            {
+                if (file.fd >= 0) close(file.fd);
+            }
+
+            return true;
+        }
+    }
+
+    {
+        StatsTimer timer(StatsPhase::Write);
+        TraceSpan span("write");
+
+        for (size_t i = 0; i < queue.size(); ++i)
+        {
+            if (queue[i].fd < 0) continue;
+
+            io_uring_sqe &write = ring->Next();
+
+            write.opcode = IORING_OP_WRITE;
+            write.fd = queue[i].fd;
+            write.addr = reinterpret_cast<uintptr_t>(queue[i].data.data());
+            write.len = queue[i].data.size();
+            write.off = 0;
+            write.flags = IOSQE_IO_LINK;
+            write.user_data = 2 * i;
+
+            io_uring_sqe &close = ring->Next();
+
+            close.opcode = IORING_OP_CLOSE;
+            close.fd = queue[i].fd;
+            close.user_data = 2 * i + 1;
+        }
+
+        bool ringFailed = ring->SubmitAndWait([&](uint64_t id, int result)
+        {
+            if (id % 2 == 0)
+            {
+                written[id / 2] = result;
+            }
+            else
+            {
+                closed[id / 2] = result;
+            }
+        });
+
+        if (ringFailed)
+        {
+            std::cerr << "Error: io_uring failed to write files" << std::endl;
+            failed = true;
+
+            // Without knowing which files are still being written, none of them can be finished here.
+            if (ring->outstanding)
+            {
+                Strand();
+                return true;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < queue.size(); ++i)
+    {
+        QueuedFile &file = queue[i];
+
+        if (file.fd < 0)
+        {
+            std::cerr << "Error: Unable to create file \"" << file.path.string() << "\"" << std::endl;
+            failed = true;
+            continue;
+        }
+
+        if (closed[i] == 0 && written[i] >= 0 && static_cast<size_t>(written[i]) == file.data.size())
+        {
+            StatsAddWritten(file.data.size());
+            continue;
+        }
+
+        // Closed, but something went wrong along the way.
+        if (closed[i] != -ECANCELED)
+        {
+            std::cerr << "Error: Failed to write file \"" << file.path.string() << "\"" << std::endl;
+            failed = true;
+            continue;
+        }
+
+        // Still open, so finish it here.
+        StatsTimer timer(StatsPhase::Write);
+        size_t done = (written[i] > 0) ? written[i] : 0;
+
+        while (done < file.data.size())
+        {
+            ssize_t result = pwrite(file.fd, file.data.data() + done, file.data.size() - done, done);
+
+            if (result <= 0)
+            {
+                if (result < 0 && errno == EINTR) continue;
+                break;
+            }
+
+            done += result;
+        }
+
+        if (close(file.fd) || done != file.data.size())
+        {
+            std::cerr << "Error: Failed to write file \"" << file.path.string() << "\"" << std::endl;
+            failed = true;
+        }
+
+        StatsAddWritten(done);
+    }
+
+    return failed;
+#else
+    bool failed = false;
+
+    for (const QueuedFile &file : queue)
+    {
+        if (WriteNow(file)) failed = true;
+    }
+
+    return failed;
+#endif
+}
\ No newline at end of file
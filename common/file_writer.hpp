@@ -0,0 +1,85 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <set>
+#include <vector>
+
+// How FileWriter gets files onto the disk.
+enum class FileWriterBackend
+{
+    Blocking,   // Open, write and close one file after another, through FileSink
+    IoUring,    // Open, write and close many files at once through io_uring. Linux only
+};
+
+// Parse the name of a backend, "blocking" or "uring". Returns true on failure.
+bool ParseFileWriterBackend(const std::string &name, FileWriterBackend &out);
+
+// Writes whole files, replacing whatever was there. With the blocking backend every file is written by the time
+// Write() returns. With io_uring, Write() only queues the file, and queued files are created, written and
+// closed in batches. A file is only certain to be on the disk after Flush(), and a failure may only show up in
+// a later Write() or in Flush(). Files queued for the same path end up written in the order they were queued.
+// Anything still queued when the writer is destroyed is dropped, so that giving up after an error doesn't write
+// more files.
+class FileWriter
+{
+public:
+    FileWriter();
+    ~FileWriter();
+
+    FileWriter(const FileWriter &) = delete;
+    FileWriter &operator=(const FileWriter &) = delete;
+
+    // Returns true if the backend isn't available here.
+    bool SetBackend(FileWriterBackend backend);
+
+    // Returns true on failure.
+    bool Write(const std::filesystem::path &path, std::vector<char> &&data);
+    bool Flush();
+
+    // Whether a file for path is still waiting to be written.
+    bool Queued(const std::filesystem::path &path) const;
+
+private:
+    struct QueuedFile
+    {
+        std::filesystem::path path;
+        std::vector<char> data;
+        int fd = -1;
+    };
+
+    struct Ring;
+
+    bool WriteNow(const QueuedFile &file);
+    bool WriteBatch();
+    void Strand();
+
+    FileWriterBackend backend = FileWriterBackend::Blocking;
+    std::vector<QueuedFile> stranded;       // Destroyed after strandedRing, which is what might still use them
+    std::unique_ptr<Ring> strandedRing;
+    std::unique_ptr<Ring> ring;
+    std::vector<QueuedFile> queue;
+    std::set<std::filesystem::path> queuedPaths;
+    uint64_t queuedBytes = 0;
+};
\ No newline at end of file
@@ -0,0 +1,120 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "../common/generate.hpp"
+#include "../common/tex_file.hpp"
+#include "../common/write_word.hpp"
+#include <string>
+#include <sstream>
+
+void GenerateData(std::mt19937 &rng, DataProfile profile, size_t size, std::vector<char> &out_data)
+{
+    static const char *words[] = {"script ", "if ", "endif\n", "ScriptName", " = ", "{ ", " }\n", "0.5 ", "GoalManager_", "\t"};
+
+    out_data.clear();
+    out_data.reserve(size);
+
+    switch (profile)
+    {
+        case DataProfile::Text:
+            while (out_data.size() < size)
+            {
+                const char *word = words[rng() % 10];
+                out_data.insert(out_data.end(), word, word + std::char_traits<char>::length(word));
+            }
+            break;
+
+        case DataProfile::Sparse:
+            // These tend to start with a long run of zeros too.
+            out_data.resize((size < 2048) ? size : 2048, 0);
+
+            while (out_data.size() < size)
+            {
+                out_data.insert(out_data.end(), rng() % 64, 0);
+
+                for (unsigned int i = rng() % 16; i > 0; --i) out_data.push_back(static_cast<char>(rng()));
+            }
+            break;
+
+        case DataProfile::Noise:
+            while (out_data.size() < size) out_data.push_back(static_cast<char>(rng()));
+            break;
+    }
+
+    out_data.resize(size);
+}
+
+void GenerateTex(std::mt19937 &rng, const TexSettings &settings, std::vector<char> &out_data)
+{
+    std::ostringstream outstream;
+    unsigned int max_shift = 4;
+
+    while (max_shift < 16 && (2u << max_shift) <= settings.max_dimension) ++max_shift;
+
+    WriteTexHeader(outstream, settings.num_images);
+
+    for (unsigned int i = 0; i < settings.num_images; ++i)
+    {
+        TexImageHeader image_header;
+        unsigned int dxt = settings.dxt_types.empty() ? 1 : settings.dxt_types[rng() % settings.dxt_types.size()];
+
+        // DXT1 uses 8 bytes per 4x4 block and the others 16.
+        unsigned int block_size = (dxt == 1) ? 8 : 16;
+
+        image_header.checksum = rng();
+        image_header.width = 1u << (4 + rng() % (max_shift - 3));
+        image_header.height = 1u << (4 + rng() % (max_shift - 3));
+        image_header.dxt = dxt;
+        image_header.size = (image_header.width / 4) * (image_header.height / 4) * block_size;
+        image_header.levels = 0;
+
+        // The tools assume every level is a quarter of the size of the one before it, so stop before a level
+        // would be smaller than a single block.
+        for (unsigned int level_size = image_header.size; level_size >= block_size && image_header.levels < settings.max_levels; level_size /= 4)
+        {
+            ++image_header.levels;
+        }
+
+        WriteImageHeader(outstream, image_header);
+
+        unsigned int level_size = image_header.size;
+
+        for (unsigned int j = 0; j < image_header.levels; ++j)
+        {
+            std::string level(4 + level_size, 0);
+
+            write_u32le(&level[0], level_size);
+
+            // A quarter of the blocks are left empty so the data compresses a little, like a real texture.
+            for (unsigned int k = 4; k + block_size <= level.size(); k += block_size)
+            {
+                if (rng() % 4 == 0) continue;
+
+                for (unsigned int b = 0; b < block_size; ++b) level[k + b] = static_cast<char>(rng());
+            }
+
+            outstream.write(level.data(), level.size());
+            level_size /= 4;
+        }
+    }
+
+    std::string str = outstream.str();
+    out_data.assign(str.begin(), str.end());
+}
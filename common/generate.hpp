@@ -0,0 +1,51 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stddef.h>
+#include <random>
+#include <vector>
+
+// Generators for synthetic game data, used by the benchmarks and ug2-gen-corpus. Everything is driven by the
+// given std::mt19937 without any of the standard distributions, so the same seed produces the same bytes with
+// any standard library.
+
+enum class DataProfile
+{
+    Text,       // Script-like text made of a few repeated words. Compresses well.
+    Sparse,     // Mostly zeros with short runs of data, like collision files.
+    Noise,      // Random bytes. Doesn't compress at all.
+};
+
+// Replace the contents of out_data with size bytes of the given profile.
+void GenerateData(std::mt19937 &rng, DataProfile profile, size_t size, std::vector<char> &out_data);
+
+struct TexSettings
+{
+    unsigned int num_images = 4;
+    unsigned int max_dimension = 256;   // Widths and heights are powers of 2 from 16 up to this.
+    unsigned int max_levels = 16;       // Each image has a full mipmap chain, capped at this many levels.
+    std::vector<unsigned int> dxt_types = {1, 5};
+};
+
+// Replace the contents of out_data with a valid tex.xbx file. Images are picked at random within settings and
+// their pixel data is a mix of empty and random blocks.
+void GenerateTex(std::mt19937 &rng, const TexSettings &settings, std::vector<char> &out_data);
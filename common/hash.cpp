@@ -0,0 +1,131 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "../common/hash.hpp"
+#include <string.h>
+
+namespace
+{
+    const uint64_t prime1 = 0x9e3779b185ebca87;
+    const uint64_t prime2 = 0xc2b2ae3d27d4eb4f;
+    const uint64_t prime3 = 0x165667b19e3779f9;
+    const uint64_t prime4 = 0x85ebca77c2b2ae63;
+    const uint64_t prime5 = 0x27d4eb2f165667c5;
+
+    uint64_t Rotate(uint64_t x, int bits)
+    {
+        return (x << bits) | (x >> (64 - bits));
+    }
+
+    // Little endian loads, so the hash is the same on every platform.
+    uint64_t Read64(const unsigned char *p)
+    {
+        uint64_t value = 0;
+
+        for (int i = 7; i >= 0; --i) value = (value << 8) | p[i];
+
+        return value;
+    }
+
+    uint32_t Read32(const unsigned char *p)
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    uint64_t Round(uint64_t acc, uint64_t input)
+    {
+        acc += input * prime2;
+        acc = Rotate(acc, 31);
+        return acc * prime1;
+    }
+
+    uint64_t MergeRound(uint64_t acc, uint64_t value)
+    {
+        acc ^= Round(0, value);
+        return acc * prime1 + prime4;
+    }
+}
+
+uint64_t ContentHash(const char *buffer, size_t size, uint64_t seed)
+{
+    const unsigned char *p = reinterpret_cast<const unsigned char*>(buffer);
+    const unsigned char *end = p + size;
+    uint64_t hash;
+
+    if (size >= 32)
+    {
+        uint64_t v1 = seed + prime1 + prime2;
+        uint64_t v2 = seed + prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - prime1;
+
+        // Four independent lanes of 8 bytes each.
+        do
+        {
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+            p += 32;
+        }
+        while (end - p >= 32);
+
+        hash = Rotate(v1, 1) + Rotate(v2, 7) + Rotate(v3, 12) + Rotate(v4, 18);
+        hash = MergeRound(hash, v1);
+        hash = MergeRound(hash, v2);
+        hash = MergeRound(hash, v3);
+        hash = MergeRound(hash, v4);
+    }
+    else
+    {
+        hash = seed + prime5;
+    }
+
+    hash += size;
+
+    while (end - p >= 8)
+    {
+        hash ^= Round(0, Read64(p));
+        hash = Rotate(hash, 27) * prime1 + prime4;
+        p += 8;
+    }
+
+    if (end - p >= 4)
+    {
+        hash ^= Read32(p) * prime1;
+        hash = Rotate(hash, 23) * prime2 + prime3;
+        p += 4;
+    }
+
+    while (p < end)
+    {
+        hash ^= *p * prime5;
+        hash = Rotate(hash, 11) * prime1;
+        ++p;
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
\ No newline at end of file
@@ -0,0 +1,640 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "../common/lzss.hpp"
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// pre/prx files use LZSS compression. Data is stored in groups starting with a type byte.
+// Each 1 bit indicates a regular byte, while each 0 indicates a 2 byte offset/length pair.
+// This means that each segment will be between 9 and 17 bytes.
+//
+//     Example:
+//     
+//     D - regular byte
+//     L - offset/length low byte
+//     H - offset/length high byte
+//     
+//     [01110111][D][D][D][L][H][D][D][D][L][H]
+//
+// The last segment will likely be shorter than 8 pieces. The deflated size in the subfile header
+// should be used to decide when to stop.
+//
+// The offset/length pairs contain a 12 bit offset and 4 bit length indicating a start point
+// and run length to be read from the ring buffer. The offset is made from combining the low
+// byte with the 4 high bits of the high byte:
+//
+//      o/l high  o/l low       offset
+//     [hhhhxxxx][llllllll] -> [hhhhllllllll]
+//
+// The 4 low bits of the high byte are the number of bytes to read from the buffer. The actual
+// length to read is the value of those bits + 3, meaning anywhere from 3 to 18.
+//
+// The buffer is a 4KiB ring buffer that starts being written to at offset 0xFEE (4078). Every
+// byte written to the output file is also written to the buffer, and the rest of it starts out zeroed.
+//
+// Since the inflated size is known up front we don't keep a separate ring buffer. Output byte n lives at
+// ring offset (0xFEE + n) % 4096, so an offset can be turned into a distance back from the current output
+// position. Distances reaching back past the start of the output read from the initial zeroed ring.
+
+namespace
+{
+    const unsigned int ring_size = 4096;
+    const unsigned int ring_start = 0xfee;
+    const unsigned int min_match = 3;
+    const unsigned int max_match = 18;
+
+    // The deflater never references bytes further back than this. The decoder could reach a little further,
+    // but the original compressor kept the last 18 bytes of the ring for its lookahead and so do we.
+    const size_t max_distance = ring_size - max_match;
+
+    // Candidate matches are found through chains of earlier positions with the same hash of their first 3
+    // bytes. Following every chain to the end makes long runs of the same byte quadratic, so cap the search.
+    const unsigned int hash_bits = 14;
+    const unsigned int max_chain = 128;
+
+    // The layout of the 8 pieces following each possible type byte. Consecutive pieces of the same kind are
+    // grouped into runs, alternating between regular bytes and offset/length pairs. The first run is always
+    // regular bytes, even if it's empty.
+    struct SegmentLayout
+    {
+        unsigned char size;         // Number of bytes following the type byte.
+        unsigned char max_out;      // Largest number of bytes the segment can inflate to.
+        unsigned char num_runs;
+        unsigned char runs[9];
+    };
+
+    struct SegmentTable
+    {
+        SegmentLayout layouts[256];
+    };
+
+    constexpr SegmentTable BuildSegmentTable()
+    {
+        SegmentTable table {};
+
+        for (unsigned int type_byte = 0; type_byte < 256; ++type_byte)
+        {
+            SegmentLayout &layout = table.layouts[type_byte];
+            bool regular_run = true;
+
+            layout.num_runs = 1;
+
+            for (unsigned int i = 0; i < 8; ++i)
+            {
+                bool regular = (type_byte >> i) & 0x1;
+
+                if (regular != regular_run)
+                {
+                    regular_run = regular;
+                    ++layout.num_runs;
+                }
+
+                ++layout.runs[layout.num_runs - 1];
+                layout.size += regular ? 1 : 2;
+                layout.max_out += regular ? 1 : max_match;
+            }
+        }
+
+        return table;
+    }
+
+    constexpr SegmentTable segment_table = BuildSegmentTable();
+
+    // For distances under 16, the shuffle indices that repeat the first [distance] bytes of a match across 16
+    // bytes, and the largest multiple of the distance that fits in 16.
+    struct PatternTable
+    {
+        unsigned char indices[16][16];
+        unsigned char step[16];
+    };
+
+    constexpr PatternTable BuildPatternTable()
+    {
+        PatternTable table {};
+
+        for (unsigned int distance = 1; distance < 16; ++distance)
+        {
+            for (unsigned int i = 0; i < 16; ++i)
+            {
+                table.indices[distance][i] = i % distance;
+            }
+
+            table.step[distance] = 16 - (16 % distance);
+        }
+
+        return table;
+    }
+
+    constexpr PatternTable pattern_table = BuildPatternTable();
+
+    // The most bytes CopyMatch writes past the output position when it takes the wide path.
+    const size_t copy_overrun = 32;
+
+    // Matches closer than this are expanded as a pattern rather than copied a word at a time. With a byte
+    // shuffle available that covers every distance that can't be copied 16 bytes at a time.
+#if defined(__SSSE3__) || defined(__aarch64__)
+    const size_t min_word_distance = 16;
+#else
+    const size_t min_word_distance = 8;
+#endif
+
+    // Fill 16 bytes at dst with the pattern formed by the distance bytes before it.
+    inline void ExpandPattern(char *dst, size_t distance)
+    {
+        const char *src = dst - distance;
+
+#if defined(__SSSE3__)
+        __m128i indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern_table.indices[distance]));
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_shuffle_epi8(bytes, indices));
+#elif defined(__aarch64__)
+        uint8x16_t indices = vld1q_u8(pattern_table.indices[distance]);
+        uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(src));
+        vst1q_u8(reinterpret_cast<uint8_t*>(dst), vqtbl1q_u8(bytes, indices));
+#else
+        char pattern[16];
+
+        for (unsigned int i = 0; i < 16; ++i)
+        {
+            pattern[i] = src[pattern_table.indices[distance][i]];
+        }
+
+        memcpy(dst, pattern, 16);
+#endif
+    }
+
+    // Copy count bytes from distance bytes back in the output. The match may overlap the bytes it's producing,
+    // so the result has to be the same as copying front to back one byte at a time.
+    void CopyMatch(char *out_data, size_t out_size, size_t out_pos, size_t distance, unsigned int count)
+    {
+        char *dst = out_data + out_pos;
+
+        if (distance > out_pos)
+        {
+            // The match starts in the initial zeroed part of the ring buffer, before the start of the output.
+            for (unsigned int j = 0; j < count; ++j, ++out_pos)
+            {
+                dst[j] = (distance > out_pos) ? 0 : out_data[out_pos - distance];
+            }
+
+            return;
+        }
+
+        const char *src = dst - distance;
+
+        if (out_size - out_pos < copy_overrun)
+        {
+            // Too close to the end of the output to write whole words.
+            for (unsigned int j = 0; j < count; ++j)
+            {
+                dst[j] = src[j];
+            }
+
+            return;
+        }
+
+        // Matches are at most 18 bytes, so every case below writes past the end of the match and relies on
+        // the following output overwriting the extra bytes.
+        if (distance >= 16)
+        {
+            memcpy(dst, src, 16);
+            memcpy(dst + 16, src + 16, 16);
+        }
+        else if (distance >= min_word_distance)
+        {
+            // Each 8 byte word only reads bytes that have already been written.
+            memcpy(dst, src, 8);
+            memcpy(dst + 8, src + 8, 8);
+            memcpy(dst + 16, src + 16, 8);
+        }
+        else
+        {
+            // Short distances are runs of a repeating pattern. Expand it to 16 bytes, then do it again from the
+            // furthest point that is still in phase with the pattern.
+            ExpandPattern(dst, distance);
+            dst += pattern_table.step[distance];
+            ExpandPattern(dst, distance);
+        }
+    }
+
+    // Turn an offset/length pair into a distance back from out_pos and a length.
+    void ReadPair(const unsigned char *pair, size_t out_pos, size_t &distance, unsigned int &count)
+    {
+        unsigned int offset = pair[0] | (static_cast<unsigned int>(pair[1] & 0xf0) << 4);
+
+        // Unsigned wrap-around doesn't matter here, the ring size divides the range of size_t.
+        distance = (ring_start + out_pos - offset) & (ring_size - 1);
+
+        // A distance of 0 means the offset is the slot about to be overwritten, which holds the byte
+        // written one full ring ago.
+        if (distance == 0) distance = ring_size;
+
+        count = (pair[1] & 0x0f) + min_match;
+    }
+
+    // Counting policies for Inflate. NoCounts is what LzssInflate normally uses and compiles away entirely.
+    struct NoCounts
+    {
+        void Literals(unsigned int) {}
+        void Match(size_t, unsigned int) {}
+    };
+
+    struct StreamCounts
+    {
+        LzssStreamStats &stats;
+
+        void Literals(unsigned int count)
+        {
+            stats.literals += count;
+        }
+
+        void Match(size_t distance, unsigned int count)
+        {
+            ++stats.matches;
+            stats.match_bytes += count;
+            ++stats.length_histogram[count - min_match];
+            ++stats.distance_histogram[(distance - 1) >> 8];
+        }
+    };
+
+    // Inflate a single segment, checking the bounds of every piece. Used near the end of the compressed data
+    // or the output buffer, where a segment may be cut short.
+    template <typename Counts>
+    bool InflateSegmentChecked(const unsigned char *in, size_t in_size, size_t &in_pos, char *out_data, size_t out_size, size_t &out_pos, unsigned char type_byte, Counts &counts)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            // Check if we've hit the end of the compressed file data.
+            if (in_pos >= in_size)
+            {
+                break;
+            }
+
+            if ((type_byte >> i) & 0x1)
+            {
+                if (out_pos >= out_size) return true;
+
+                out_data[out_pos++] = static_cast<char>(in[in_pos++]);
+                counts.Literals(1);
+            }
+            else
+            {
+                size_t distance;
+                unsigned int count;
+
+                // A lone byte at the end can't be a whole offset/length pair.
+                if (in_size - in_pos < 2)
+                {
+                    in_pos = in_size;
+                    break;
+                }
+
+                ReadPair(in + in_pos, out_pos, distance, count);
+                in_pos += 2;
+
+                if (out_size - out_pos < count) return true;
+
+                CopyMatch(out_data, out_size, out_pos, distance, count);
+                out_pos += count;
+                counts.Match(distance, count);
+            }
+        }
+
+        return false;
+    }
+
+    template <typename Counts>
+    bool Inflate(const char *in_data, size_t in_size, char *out_data, size_t out_size, Counts &counts)
+    {
+        const unsigned char *in = reinterpret_cast<const unsigned char*>(in_data);
+        size_t in_pos = 0;
+        size_t out_pos = 0;
+
+        while (in_pos < in_size)
+        {
+            unsigned char type_byte = in[in_pos++];
+            const SegmentLayout &layout = segment_table.layouts[type_byte];
+
+            if ((in_size - in_pos < layout.size) || (out_size - out_pos < layout.max_out))
+            {
+                if (InflateSegmentChecked(in, in_size, in_pos, out_data, out_size, out_pos, type_byte, counts)) return true;
+                continue;
+            }
+
+            // From here on the whole segment is known to be in bounds.
+
+            if (type_byte == 0xff)
+            {
+                // Runs of uncompressible data are all regular bytes.
+                memcpy(out_data + out_pos, in + in_pos, 8);
+                in_pos += 8;
+                out_pos += 8;
+                counts.Literals(8);
+                continue;
+            }
+
+            for (unsigned int r = 0; r < layout.num_runs; ++r)
+            {
+                unsigned int run = layout.runs[r];
+
+                if (!(r & 0x1))
+                {
+                    memcpy(out_data + out_pos, in + in_pos, run);
+                    in_pos += run;
+                    out_pos += run;
+                    counts.Literals(run);
+                }
+                else
+                {
+                    for (unsigned int j = 0; j < run; ++j)
+                    {
+                        size_t distance;
+                        unsigned int count;
+
+                        ReadPair(in + in_pos, out_pos, distance, count);
+                        in_pos += 2;
+
+                        CopyMatch(out_data, out_size, out_pos, distance, count);
+                        out_pos += count;
+                        counts.Match(distance, count);
+                    }
+                }
+            }
+        }
+
+        return out_pos != out_size;
+    }
+}
+
+bool LzssInflate(const char *in_data, size_t in_size, char *out_data, size_t out_size)
+{
+    NoCounts counts;
+
+    return Inflate(in_data, in_size, out_data, out_size, counts);
+}
+
+bool LzssInflate(const char *in_data, size_t in_size, char *out_data, size_t out_size, LzssStreamStats &stats)
+{
+    StreamCounts counts {stats};
+
+    return Inflate(in_data, in_size, out_data, out_size, counts);
+}
+
+LzssStreamStats &LzssStreamStats::operator+=(const LzssStreamStats &other)
+{
+    literals += other.literals;
+    matches += other.matches;
+    match_bytes += other.match_bytes;
+
+    for (int i = 0; i < 16; ++i)
+    {
+        length_histogram[i] += other.length_histogram[i];
+        distance_histogram[i] += other.distance_histogram[i];
+    }
+
+    return *this;
+}
+
+namespace
+{
+    struct ScalarCompare
+    {
+        // Count how many of the first limit bytes at a and b are the same.
+        static unsigned int MatchLength(const unsigned char *a, const unsigned char *b, unsigned int limit, size_t /*readable*/)
+        {
+            unsigned int len = 0;
+
+            while (len < limit && a[len] == b[len]) ++len;
+
+            return len;
+        }
+    };
+
+    struct SimdCompare
+    {
+        // Same as ScalarCompare, but compares a whole vector at a time when at least that many bytes can be
+        // read from b. The candidate a is always before b, so it can be read too.
+        static unsigned int MatchLength(const unsigned char *a, const unsigned char *b, unsigned int limit, size_t readable)
+        {
+            unsigned int len = 0;
+
+#if defined(__AVX2__)
+            if (readable >= 32)
+            {
+                __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+                __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+                unsigned int diff = ~static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)));
+
+                // Matches are never longer than 18, so one compare is always enough.
+                len = diff ? CountTrailingZeros(diff) : 32;
+                return (len < limit) ? len : limit;
+            }
+#elif defined(__SSE2__) || defined(_M_X64)
+            if (readable >= 16)
+            {
+                __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+                __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+                unsigned int diff = ~static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb))) & 0xffff;
+
+                if (diff) 
+                {
+                    len = CountTrailingZeros(diff);
+                    return (len < limit) ? len : limit;
+                }
+
+                len = 16;
+            }
+#elif defined(__aarch64__)
+            if (readable >= 16)
+            {
+                uint8x16_t eq = vceqq_u8(vld1q_u8(a), vld1q_u8(b));
+
+                // Narrow each byte of the compare result to 4 bits so the whole thing fits in a 64 bit word.
+                uint64_t diff = ~vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+
+                if (diff)
+                {
+                    len = CountTrailingZeros64(diff) / 4;
+                    return (len < limit) ? len : limit;
+                }
+
+                len = 16;
+            }
+#else
+            (void)readable;
+#endif
+
+            while (len < limit && a[len] == b[len]) ++len;
+
+            return len;
+        }
+
+        static unsigned int CountTrailingZeros(unsigned int x)
+        {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, x);
+            return index;
+#else
+            return __builtin_ctz(x);
+#endif
+        }
+
+        static unsigned int CountTrailingZeros64(uint64_t x)
+        {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward64(&index, x);
+            return index;
+#else
+            return __builtin_ctzll(x);
+#endif
+        }
+    };
+
+    unsigned int Hash3(const unsigned char *p)
+    {
+        uint32_t bytes = p[0] | (p[1] << 8) | (p[2] << 16);
+        return (bytes * 2654435761u) >> (32 - hash_bits);
+    }
+
+    template <typename Compare>
+    void Deflate(const unsigned char *in_data, size_t in_size, std::vector<char> &out_data)
+    {
+        // The decoder's ring starts out zeroed, so the input is treated as if it followed max_match zeros.
+        // Indexing the hash chains over that lets runs of zeros at the start of a file be matched against the
+        // zeroed ring from the first byte, and the usual distance limit keeps them from reaching past it.
+        const size_t prefix = max_match;
+        const size_t end = prefix + in_size;
+        std::vector<unsigned char> window(end, 0);
+
+        // head holds the most recent position for each hash, prev links each position to the one before it
+        // with the same hash. Positions are stored + 1 so that 0 can mean none.
+        std::vector<uint32_t> head(1 << hash_bits, 0);
+        std::vector<uint32_t> prev(ring_size, 0);
+        const unsigned char *in = window.data();
+        size_t pos = prefix;
+
+        std::copy(in_data, in_data + in_size, window.begin() + prefix);
+
+        out_data.clear();
+        out_data.reserve(in_size + in_size / 8 + 1);
+
+        auto insert = [&](size_t p)
+        {
+            if (end - p < min_match) return;
+
+            unsigned int hash = Hash3(in + p);
+            prev[p & (ring_size - 1)] = head[hash];
+            head[hash] = static_cast<uint32_t>(p + 1);
+        };
+
+        for (size_t p = 0; p < prefix; ++p) insert(p);
+
+        while (pos < end)
+        {
+            size_t type_pos = out_data.size();
+            unsigned char type_byte = 0;
+
+            out_data.push_back(0);
+
+            for (int i = 0; i < 8 && pos < end; ++i)
+            {
+                size_t remaining = end - pos;
+                unsigned int limit = (remaining < max_match) ? static_cast<unsigned int>(remaining) : max_match;
+                unsigned int best_len = 0;
+                size_t best_pos = 0;
+
+                if (limit >= min_match)
+                {
+                    uint32_t candidate = head[Hash3(in + pos)];
+
+                    for (unsigned int chain = 0; candidate && chain < max_chain; ++chain)
+                    {
+                        size_t cand_pos = candidate - 1;
+
+                        if (pos - cand_pos > max_distance) break;
+
+                        unsigned int len = Compare::MatchLength(in + cand_pos, in + pos, limit, remaining);
+
+                        if (len > best_len)
+                        {
+                            best_len = len;
+                            best_pos = cand_pos;
+
+                            if (len == limit) break;
+                        }
+
+                        candidate = prev[cand_pos & (ring_size - 1)];
+                    }
+                }
+
+                if (best_len >= min_match)
+                {
+                    // Window position p holds input byte p - prefix, which the decoder keeps at ring offset
+                    // 0xFEE + p - prefix. The prefix is smaller than 0xFEE so this can't go negative.
+                    unsigned int offset = (ring_start + best_pos - prefix) & (ring_size - 1);
+
+                    out_data.push_back(static_cast<char>(offset & 0xff));
+                    out_data.push_back(static_cast<char>(((offset >> 4) & 0xf0) | (best_len - min_match)));
+
+                    for (unsigned int j = 0; j < best_len; ++j) insert(pos + j);
+                    pos += best_len;
+                }
+                else
+                {
+                    type_byte |= 1 << i;
+                    out_data.push_back(static_cast<char>(in[pos]));
+
+                    insert(pos);
+                    ++pos;
+                }
+            }
+
+            out_data[type_pos] = static_cast<char>(type_byte);
+        }
+    }
+}
+
+void LzssDeflate(const char *in_data, size_t in_size, std::vector<char> &out_data, LzssMatchFinder finder)
+{
+    const unsigned char *in = reinterpret_cast<const unsigned char*>(in_data);
+
+    if (finder == LzssMatchFinder::Scalar)
+    {
+        Deflate<ScalarCompare>(in, in_size, out_data);
+    }
+    else
+    {
+        Deflate<SimdCompare>(in, in_size, out_data);
+    }
+}
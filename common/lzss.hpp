@@ -0,0 +1,59 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// How LzssDeflate compares the bytes at candidate match positions. Scalar compares one byte at a time, Simd
+// compares 16 (SSE2/NEON) or 32 (AVX2) bytes at a time where the build allows it.
+enum class LzssMatchFinder
+{
+    Scalar,
+    Simd
+};
+
+// Inflate an LZSS compressed pre/prx subfile. in_data holds the in_size deflated bytes and out_data must
+// have room for exactly out_size inflated bytes. Returns true if the compressed data is malformed or doesn't
+// inflate to out_size bytes.
+bool LzssInflate(const char *in_data, size_t in_size, char *out_data, size_t out_size);
+
+// What an LZSS stream is made of. Match lengths run from 3 to 18, and distances back into the 4KiB window are
+// grouped into 256 byte buckets, so distance_histogram[0] counts distances 1 to 256.
+struct LzssStreamStats
+{
+    uint64_t literals = 0;
+    uint64_t matches = 0;
+    uint64_t match_bytes = 0;
+    uint64_t length_histogram[16] = {};
+    uint64_t distance_histogram[16] = {};
+
+    LzssStreamStats &operator+=(const LzssStreamStats &other);
+};
+
+// Same as above, but also adds up the literals and matches in the stream into stats. This is a separate
+// instantiation of the decoder, so the one above doesn't pay for the counting.
+bool LzssInflate(const char *in_data, size_t in_size, char *out_data, size_t out_size, LzssStreamStats &stats);
+
+// Compress in_size bytes from in_data with the same LZSS scheme, replacing the contents of out_data. Both match
+// finders produce identical output.
+void LzssDeflate(const char *in_data, size_t in_size, std::vector<char> &out_data, LzssMatchFinder finder = LzssMatchFinder::Simd);
@@ -0,0 +1,296 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "../common/mapped_file.hpp"
+#include "../common/std_stream.hpp"
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#elif defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::filesystem::path &path)
+{
+    Close();
+
+    // Stdin and pipes can't be mapped, or even asked for their size, so they're read to the end instead.
+    if (IsStdStream(path)) return ReadAll(path);
+
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) return true;
+
+    struct stat st;
+
+    if (fstat(fd, &st))
+    {
+        close(fd);
+        return true;
+    }
+
+    if (!S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return ReadAll(path);
+    }
+
+    size = st.st_size;
+
+    // Mapping nothing fails, but there's nothing to read anyway.
+    if (size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (view != MAP_FAILED)
+    {
+        madvise(view, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(view);
+        mapped = true;
+        return false;
+    }
+#elif defined(_WIN32)
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE) return true;
+
+    LARGE_INTEGER filesize;
+
+    if (GetFileType(file) != FILE_TYPE_DISK)
+    {
+        CloseHandle(file);
+        return ReadAll(path);
+    }
+
+    if (!GetFileSizeEx(file, &filesize))
+    {
+        CloseHandle(file);
+        return true;
+    }
+
+    size = filesize.QuadPart;
+
+    if (size == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+
+    if (mapping)
+    {
+        data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+        if (data)
+        {
+            mapped = true;
+            return false;
+        }
+
+        CloseHandle(mapping);
+        mapping = nullptr;
+    }
+#endif
+
+    // No mapping, so read the whole thing.
+    return ReadAll(path);
+}
+
+bool MappedFile::ReadAll(const std::filesystem::path &path)
+{
+    std::ifstream file;
+    std::istream &instream = OpenInStream(path, file);
+
+    if (!instream.good()) return true;
+
+    if (ReadWholeStream(instream, buffer))
+    {
+        Close();
+        return true;
+    }
+
+    data = buffer.data();
+    size = buffer.size();
+    return false;
+}
+
+void MappedFile::Close()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    if (mapped) munmap(const_cast<char*>(data), size);
+#elif defined(_WIN32)
+    if (mapped) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    mapping = nullptr;
+#endif
+
+    buffer.clear();
+    buffer.shrink_to_fit();
+    data = nullptr;
+    size = 0;
+    released = 0;
+    mapped = false;
+}
+
+void MappedFile::Release(uint64_t offset)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    if (!mapped) return;
+
+    uint64_t pagesize = sysconf(_SC_PAGESIZE);
+    uint64_t end = (offset < size ? offset : size) / pagesize * pagesize;
+
+    if (end <= released) return;
+
+    madvise(const_cast<char*>(data) + released, end - released, MADV_DONTNEED);
+    released = end;
+#else
+    (void)offset;
+#endif
+}
+
+MappedOutFile::~MappedOutFile()
+{
+    Close();
+}
+
+bool MappedOutFile::Create(const std::filesystem::path &path, uint64_t size)
+{
+    Close();
+
+    this->path = path;
+    this->size = size;
+
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+
+    if (fd < 0) return true;
+
+    if (ftruncate(fd, size))
+    {
+        close(fd);
+        return true;
+    }
+
+#if defined(__linux__)
+    // Running out of space while writing to a mapping kills the process instead of failing a write, so the
+    // space is claimed now. Filesystems that can't do this are left to it.
+    if (posix_fallocate(fd, 0, size) == ENOSPC)
+    {
+        close(fd);
+        return true;
+    }
+#endif
+
+    void *view = (size == 0) ? MAP_FAILED : mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (view != MAP_FAILED)
+    {
+        data = static_cast<char*>(view);
+        mapped = true;
+        return false;
+    }
+#elif defined(_WIN32)
+    file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        file = nullptr;
+        return true;
+    }
+
+    // Mapping with a size grows the file to it.
+    mapping = (size == 0) ? nullptr : CreateFileMappingW(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+
+    if (mapping)
+    {
+        data = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0));
+
+        if (data)
+        {
+            mapped = true;
+            return false;
+        }
+
+        CloseHandle(mapping);
+        mapping = nullptr;
+    }
+
+    CloseHandle(file);
+    file = nullptr;
+#endif
+
+    // No mapping, so fill a buffer and write it out when done.
+    buffer.assign(size, 0);
+    data = buffer.data();
+    return false;
+}
+
+bool MappedOutFile::Close()
+{
+    bool failed = false;
+
+#if defined(__unix__) || defined(__APPLE__)
+    if (mapped) failed = munmap(data, size) != 0;
+#elif defined(_WIN32)
+    if (mapped) failed = !FlushViewOfFile(data, 0) || !UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    if (file) CloseHandle(file);
+    mapping = nullptr;
+    file = nullptr;
+#endif
+
+    if (!mapped && data)
+    {
+        std::ofstream outstream(path, std::ios::binary);
+
+        outstream.write(buffer.data(), buffer.size());
+        outstream.close();
+        failed = outstream.fail();
+    }
+
+    buffer.clear();
+    buffer.shrink_to_fit();
+    data = nullptr;
+    size = 0;
+    mapped = false;
+
+    return failed;
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stdint.h>
+#include <filesystem>
+#include <vector>
+
+// Read only view of a whole file. The file is memory mapped where the platform allows it, so only the parts
+// being looked at take up memory, and read into memory otherwise. "-" reads all of stdin.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // Returns true on failure.
+    bool Open(const std::filesystem::path &path);
+    void Close();
+
+    const char *Data() const {return data;}
+    uint64_t Size() const {return size;}
+
+    // Let the OS drop the pages before offset. For reading big files front to back without them piling up
+    // in memory. The data stays readable.
+    void Release(uint64_t offset);
+
+private:
+    bool ReadAll(const std::filesystem::path &path);
+
+    const char *data = nullptr;
+    uint64_t size = 0;
+    uint64_t released = 0;
+    bool mapped = false;
+    std::vector<char> buffer;
+
+#if defined(_WIN32)
+    void *mapping = nullptr;
+#endif
+};
+
+// Writable view of a new file with a size decided up front, so that different parts of it can be filled at the
+// same time and in any order. The file starts out zeroed. Where it can't be mapped it's put together in memory
+// and written out by Close(). Only regular files can be mapped, see IsSequentialOutput().
+class MappedOutFile
+{
+public:
+    MappedOutFile() = default;
+    ~MappedOutFile();
+
+    MappedOutFile(const MappedOutFile &) = delete;
+    MappedOutFile &operator=(const MappedOutFile &) = delete;
+
+    // Replaces anything already at path. Returns true on failure.
+    bool Create(const std::filesystem::path &path, uint64_t size);
+
+    // Returns true if the file couldn't be finished.
+    bool Close();
+
+    char *Data() const {return data;}
+    uint64_t Size() const {return size;}
+
+private:
+    char *data = nullptr;
+    uint64_t size = 0;
+    bool mapped = false;
+    std::filesystem::path path;
+    std::vector<char> buffer;
+
+#if defined(_WIN32)
+    void *file = nullptr;
+    void *mapping = nullptr;
+#endif
+};
\ No newline at end of file
@@ -0,0 +1,64 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stddef.h>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+
+// The stream buffer behind MemoryInStream. It's a base class rather than a member so that it's constructed
+// before the istream that uses it.
+class MemoryStreamBuf : public std::streambuf
+{
+public:
+    MemoryStreamBuf(const char *data, size_t size)
+    {
+        char *begin = const_cast<char*>(data);
+        setg(begin, begin, begin + size);
+    }
+};
+
+// An istream that reads straight out of a block of memory, such as an inflated subfile, without copying it
+// the way std::istringstream would. The memory has to outlive the stream.
+class MemoryInStream : private MemoryStreamBuf, public std::istream
+{
+public:
+    MemoryInStream(const char *data, size_t size) : MemoryStreamBuf(data, size), std::istream(static_cast<MemoryStreamBuf*>(this)) {}
+};
+
+// The stream buffer behind MemoryOutStream.
+class MemoryOutStreamBuf : public std::streambuf
+{
+public:
+    MemoryOutStreamBuf(char *data, size_t size)
+    {
+        setp(data, data + size);
+    }
+};
+
+// An ostream that writes straight into a block of memory, such as part of a mapped file. Writing past the end
+// fails the stream instead of growing anything.
+class MemoryOutStream : private MemoryOutStreamBuf, public std::ostream
+{
+public:
+    MemoryOutStream(char *data, size_t size) : MemoryOutStreamBuf(data, size), std::ostream(static_cast<MemoryOutStreamBuf*>(this)) {}
+};
\ No newline at end of file
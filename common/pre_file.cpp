@@ -0,0 +1,199 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "../common/pre_file.hpp"
+#include "../common/read_word.hpp"
+#include "../common/write_word.hpp"
+#include <iostream>
+
+bool ReadPreHeader(std::istream &infile, PreHeader &outheader)
+{
+    char bytes[12];
+
+    infile.read(bytes, 12);
+
+    if (!infile.good())
+    {
+        return true;
+    }
+
+    outheader.size = read_u32le(bytes);
+    outheader.version = read_u16le(&bytes[4]);
+    outheader.unknown = read_u16le(&bytes[6]);
+    outheader.numFiles = read_u32le(&bytes[8]);
+    
+    return false;
+}
+
+bool ReadSubFileHeader(std::istream &infile, SubFileHeader &outsubheader)
+{
+    char bytes[16];
+
+    infile.read(bytes, 16);
+
+    if (!infile.good())
+    {
+        return true;
+    }
+
+    outsubheader.inflatedSize = read_u32le(bytes);
+    outsubheader.deflatedSize = read_u32le(&bytes[4]);
+    outsubheader.pathSize = read_u32le(&bytes[8]);
+    outsubheader.pathCRC = read_u32le(&bytes[12]);
+
+    outsubheader.path.resize(outsubheader.pathSize);
+    infile.read(reinterpret_cast<std::istream::char_type*>(&outsubheader.path.front()), outsubheader.pathSize);
+
+    // Just like every other section of a pre/prx file, the subfile headers are 4 byte aligned.
+    // However, the subfile path length includes the padding at the end, so we don't have to manually skip any
+    // bytes.
+
+    if (infile.gcount() != outsubheader.pathSize)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+bool ReadSubFileHeader(const char *data, uint64_t size, SubFileHeader &outsubheader)
+{
+    if (size < 16)
+    {
+        return true;
+    }
+
+    outsubheader.inflatedSize = read_u32le(data);
+    outsubheader.deflatedSize = read_u32le(&data[4]);
+    outsubheader.pathSize = read_u32le(&data[8]);
+    outsubheader.pathCRC = read_u32le(&data[12]);
+
+    if (size - 16 < outsubheader.pathSize)
+    {
+        return true;
+    }
+
+    outsubheader.path.assign(data + 16, data + 16 + outsubheader.pathSize);
+
+    return false;
+}
+
+bool ReadPreIndex(const char *data, uint64_t size, const std::string &name, std::vector<PreIndexEntry> &outentries)
+{
+    if (size < 12)
+    {
+        std::cerr << "Error: Failed to read pre/prx header of \"" << name << "\"" << std::endl;
+        return true;
+    }
+
+    unsigned int numFiles = read_u32le(data + 8);
+    uint64_t offset = 12;
+
+    outentries.clear();
+
+    for (unsigned int i = 0; i < numFiles; ++i)
+    {
+        PreIndexEntry entry;
+
+        if (ReadSubFileHeader(data + offset, size - offset, entry.subheader))
+        {
+            std::cerr << "Error: Failed to read sub file header " << i << " of \"" << name << "\"" << std::endl;
+            return true;
+        }
+
+        for (char c : entry.subheader.path)
+        {
+            if (c < 32) break;
+            entry.path.push_back(c);
+        }
+
+        entry.start = offset;
+        entry.offset = offset + 16 + entry.subheader.pathSize;
+        entry.payloadSize = (entry.subheader.deflatedSize == 0) ? entry.subheader.inflatedSize : entry.subheader.deflatedSize;
+
+        if (size - entry.offset < entry.payloadSize)
+        {
+            std::cerr << "Error: Sub file " << i << " of \"" << name << "\" runs past the end of the file" << std::endl;
+            return true;
+        }
+
+        // The padding after the last payload can be missing, so never step past the end. Otherwise the next
+        // header would be read with a size that wrapped around.
+        entry.end = entry.offset + entry.payloadSize + ((entry.payloadSize % 4) ? (4 - (entry.payloadSize % 4)) : 0);
+        entry.end = (entry.end > size) ? size : entry.end;
+        offset = entry.end;
+
+        outentries.push_back(std::move(entry));
+    }
+
+    return false;
+}
+
+bool WritePreHeader(std::ostream &outstream, const PreHeader &header, uint64_t &sizeout)
+{
+    char bytes[12];
+
+    if (header.size > PreFieldMax)
+    {
+        return true;
+    }
+
+    write_u32le(bytes, header.size);
+    write_u16le(&bytes[4], 3);
+    write_u16le(&bytes[6], 0xabcd);
+    write_u32le(&bytes[8], header.numFiles);
+
+    outstream.write(bytes, 12);
+
+    if (outstream.fail())
+    {
+        return true;
+    }
+
+    sizeout += 12;
+    return false;
+}
+
+bool WriteSubFileHeader(std::ostream &outstream, const SubFileHeader &subheader, uint64_t &sizeout)
+{
+    std::vector<char> bytes(16);
+
+    if (subheader.inflatedSize > PreFieldMax || subheader.deflatedSize > PreFieldMax)
+    {
+        return true;
+    }
+
+    write_u32le(&bytes[0], subheader.inflatedSize);
+    write_u32le(&bytes[4], subheader.deflatedSize);
+    write_u32le(&bytes[8], subheader.pathSize);
+    write_u32le(&bytes[12], subheader.pathCRC);
+
+    bytes.insert(bytes.end(), subheader.path.begin(), subheader.path.end());
+
+    outstream.write(bytes.data(), bytes.size());
+
+    if (outstream.fail())
+    {
+        return true;
+    }
+
+    sizeout += bytes.size();
+    return false;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "../common/pre_header.hpp"
+#include "../common/subfile_header.hpp"
+#include <stdint.h>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Reading and writing the headers of pre/prx files. All of these return true on failure.
+
+bool ReadPreHeader(std::istream &infile, PreHeader &outheader);
+bool ReadSubFileHeader(std::istream &infile, SubFileHeader &outsubheader);
+
+// Same as above, from the size bytes at data, such as a memory mapped file. The header takes up
+// 16 + outsubheader.pathSize bytes.
+bool ReadSubFileHeader(const char *data, uint64_t size, SubFileHeader &outsubheader);
+
+// A subfile found by ReadPreIndex. Offsets are from the start of the pre file.
+struct PreIndexEntry
+{
+    SubFileHeader subheader;
+    std::string path;           // Internal path, up to the padding
+    uint64_t start;             // Start of the subfile header
+    uint64_t offset;            // Start of the payload
+    uint64_t payloadSize;       // Stored size, not including padding
+    uint64_t end;               // End of the padding, or of the file if the last payload isn't padded
+};
+
+// List the subfiles in the size bytes of a whole pre file at data, such as a loaded FileSource. Prints an error
+// naming name and returns true if a header is cut short or a payload runs past the end of the file.
+bool ReadPreIndex(const char *data, uint64_t size, const std::string &name, std::vector<PreIndexEntry> &outentries);
+
+// The writers add the number of bytes written to sizeout.
+// Sizes and offsets are 64 bits in memory so nothing wraps around while adding them up, but a pre file stores
+// them in 32 bit fields. The write functions fail on anything bigger than this, so check against it first to
+// give a better error.
+const uint64_t PreFieldMax = 0xffffffff;
+
+bool WritePreHeader(std::ostream &outstream, const PreHeader &header, uint64_t &sizeout);
+bool WriteSubFileHeader(std::ostream &outstream, const SubFileHeader &subheader, uint64_t &sizeout);
\ No newline at end of file
@@ -20,9 +20,11 @@
 
 #pragma once
 
+#include <stdint.h>
+
 struct PreHeader
 {
-    unsigned int size;
+    uint64_t size;
     unsigned short version;
     unsigned short unknown;
     unsigned int numFiles;
@@ -0,0 +1,226 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "../common/report.hpp"
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+
+namespace
+{
+    // Past this much pending output it is written to stdout early, so listing a huge archive doesn't hold
+    // all of it in memory.
+    const size_t write_threshold = 1024 * 1024;
+
+    ReportMode report_mode = ReportMode::Plain;
+    std::ostream *report_stream = &std::cout;
+    std::mutex pending_mutex;
+    std::string pending;
+
+    void WritePending()
+    {
+        report_stream->write(pending.data(), pending.size());
+        report_stream->flush();
+        pending.clear();
+    }
+
+    // std::cerr is tied to this stream, and flushing it flushes the report.
+    class FlushBuffer : public std::streambuf
+    {
+    protected:
+        int sync() override
+        {
+            ReportFlush();
+            return 0;
+        }
+    };
+
+    struct ReportTie
+    {
+        FlushBuffer buffer;
+        std::ostream stream;
+
+        ReportTie() : stream(&buffer)
+        {
+            std::cerr.tie(&stream);
+        }
+
+        ~ReportTie()
+        {
+            std::cerr.tie(nullptr);
+            ReportFlush();
+        }
+    };
+
+    ReportTie report_tie;
+
+    std::string JsonString(const std::string &str)
+    {
+        std::ostringstream out;
+
+        out << '"';
+
+        for (char c : str)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out << '\\' << c;
+            }
+            else if (static_cast<unsigned char>(c) < 32)
+            {
+                out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c);
+            }
+            else
+            {
+                out << c;
+            }
+        }
+
+        out << '"';
+
+        return out.str();
+    }
+}
+
+void ReportSetMode(ReportMode mode)
+{
+    report_mode = mode;
+}
+
+ReportMode ReportGetMode()
+{
+    return report_mode;
+}
+
+void ReportSetStream(std::ostream &stream)
+{
+    ReportFlush();
+    report_stream = &stream;
+
+    // A report written to std::cerr is already in order with the errors, and having std::cerr flush the report
+    // while the report is being written to it would deadlock.
+    std::cerr.tie(&stream == &std::cerr ? nullptr : &report_tie.stream);
+}
+
+void ReportFlush()
+{
+    std::lock_guard<std::mutex> lock(pending_mutex);
+
+    if (!pending.empty()) WritePending();
+}
+
+ReportRecord::ReportRecord(const char *type, bool always)
+{
+    text_active = (report_mode == ReportMode::Plain) || (report_mode == ReportMode::Quiet && always);
+    json_active = (report_mode == ReportMode::JsonLines);
+
+    // A stream in a failed state ignores everything written to it.
+    if (!text_active) text.setstate(std::ios::badbit);
+    if (json_active) json = "{\"type\": " + JsonString(type);
+}
+
+ReportRecord::~ReportRecord()
+{
+    std::string line;
+
+    if (text_active && has_text)
+    {
+        line = text.str();
+        line.push_back('\n');
+    }
+    else if (json_active && has_fields)
+    {
+        line = std::move(json);
+        line += "}\n";
+    }
+    else
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(pending_mutex);
+
+    pending += line;
+
+    if (pending.size() >= write_threshold) WritePending();
+}
+
+ReportRecord &ReportRecord::Field(const char *name, const std::string &value)
+{
+    if (json_active) AppendField(name, JsonString(value));
+    return *this;
+}
+
+ReportRecord &ReportRecord::Field(const char *name, const char *value)
+{
+    if (json_active) AppendField(name, JsonString(value));
+    return *this;
+}
+
+ReportRecord &ReportRecord::Field(const char *name, bool value)
+{
+    if (json_active) AppendField(name, value ? "true" : "false");
+    return *this;
+}
+
+ReportRecord &ReportRecord::Field(const char *name, double value)
+{
+    if (json_active)
+    {
+        std::ostringstream out;
+        out << std::setprecision(9) << value;
+        AppendField(name, out.str());
+    }
+
+    return *this;
+}
+
+ReportRecord &ReportRecord::Field(const char *name, const uint64_t *values, size_t count)
+{
+    if (json_active)
+    {
+        std::string array = "[";
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (i) array += ", ";
+            array += std::to_string(values[i]);
+        }
+
+        AppendField(name, array + "]");
+    }
+
+    return *this;
+}
+
+std::ostream &ReportRecord::Text()
+{
+    has_text = true;
+    return text;
+}
+
+void ReportRecord::AppendField(const char *name, const std::string &json_value)
+{
+    has_fields = true;
+    json += ", ";
+    json += JsonString(name);
+    json += ": ";
+    json += json_value;
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+// Console output for listings and results. Lines are collected in memory and written to stdout in one go when
+// ReportFlush() is called, when the program exits, or right before anything is written to std::cerr, so errors
+// still show up after the lines that led to them.
+
+enum class ReportMode
+{
+    Plain,          // Human readable text
+    Quiet,          // Only records marked as always shown
+    JsonLines       // One JSON object per record
+};
+
+void ReportSetMode(ReportMode mode);
+ReportMode ReportGetMode();
+
+// Send the report to stream instead of stdout, for when stdout carries something else, like a tar stream.
+void ReportSetStream(std::ostream &stream);
+
+// Write out everything reported so far.
+void ReportFlush();
+
+// One record of output, added to the report as a whole when it goes out of scope, so records from different
+// threads never interleave. Fields are only kept in JSON lines mode and text only in plain mode (or quiet mode
+// if always is set), otherwise they cost next to nothing. Records without any fields, like table headings, are
+// left out of JSON lines output.
+class ReportRecord
+{
+public:
+    explicit ReportRecord(const char *type, bool always = false);
+    ~ReportRecord();
+
+    ReportRecord(const ReportRecord &) = delete;
+    ReportRecord &operator=(const ReportRecord &) = delete;
+
+    ReportRecord &Field(const char *name, const std::string &value);
+    ReportRecord &Field(const char *name, const char *value);
+    ReportRecord &Field(const char *name, bool value);
+    ReportRecord &Field(const char *name, double value);
+    ReportRecord &Field(const char *name, const uint64_t *values, size_t count);
+
+    template <typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+    ReportRecord &Field(const char *name, T value)
+    {
+        if (json_active) AppendField(name, std::to_string(value));
+        return *this;
+    }
+
+    // The text of the record in plain mode. The record ends with a newline of its own.
+    std::ostream &Text();
+
+private:
+    void AppendField(const char *name, const std::string &json_value);
+
+    bool text_active;
+    bool json_active;
+    bool has_text = false;
+    bool has_fields = false;
+    std::ostringstream text;
+    std::string json;
+};
\ No newline at end of file
@@ -0,0 +1,217 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "../common/stats.hpp"
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+bool stats_enabled = false;
+
+namespace
+{
+    const char *phase_names[] = {"parse", "filesystem", "read", "inflate", "deflate", "convert", "write"};
+
+    struct PhaseTotals
+    {
+        std::atomic<uint64_t> wall_ns {0};
+        std::atomic<uint64_t> cpu_ns {0};
+        std::atomic<uint64_t> count {0};
+    };
+
+    PhaseTotals phases[static_cast<int>(StatsPhase::Count)];
+    std::atomic<uint64_t> bytes_read {0};
+    std::atomic<uint64_t> bytes_written {0};
+    std::atomic<uint64_t> entries {0};
+    uint64_t run_wall_start = 0;
+    uint64_t run_cpu_start = 0;
+
+    uint64_t WallNow()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Cpu time of the calling thread where the platform has it, otherwise of the whole process.
+    uint64_t ThreadCpuNow()
+    {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+        return static_cast<uint64_t>(std::clock()) * (1000000000 / CLOCKS_PER_SEC);
+#endif
+    }
+
+    uint64_t ProcessCpuNow()
+    {
+#if defined(CLOCK_PROCESS_CPUTIME_ID)
+        timespec ts;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+        return static_cast<uint64_t>(std::clock()) * (1000000000 / CLOCKS_PER_SEC);
+#endif
+    }
+
+    // Peak resident set size in bytes, or 0 where we don't know how to get it.
+    uint64_t PeakRss()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        rusage usage;
+
+        if (getrusage(RUSAGE_SELF, &usage)) return 0;
+
+#if defined(__APPLE__)
+        return usage.ru_maxrss;
+#else
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+        return 0;
+#endif
+    }
+
+    double MiBPerSecond(uint64_t bytes, double seconds)
+    {
+        return (seconds > 0) ? bytes / (1024.0 * 1024.0) / seconds : 0;
+    }
+}
+
+void StatsEnable()
+{
+    stats_enabled = true;
+    run_wall_start = WallNow();
+    run_cpu_start = ProcessCpuNow();
+}
+
+void StatsTimer::Start()
+{
+    wall_start = WallNow();
+    cpu_start = ThreadCpuNow();
+}
+
+void StatsTimer::Stop()
+{
+    PhaseTotals &totals = phases[static_cast<int>(phase)];
+
+    totals.wall_ns += WallNow() - wall_start;
+    totals.cpu_ns += ThreadCpuNow() - cpu_start;
+    ++totals.count;
+}
+
+void StatsAddRead(uint64_t bytes)
+{
+    if (stats_enabled) bytes_read += bytes;
+}
+
+void StatsAddWritten(uint64_t bytes)
+{
+    if (stats_enabled) bytes_written += bytes;
+}
+
+void StatsAddEntries(uint64_t count)
+{
+    if (stats_enabled) entries += count;
+}
+
+void StatsPrint(std::ostream &outstream)
+{
+    double wall = (WallNow() - run_wall_start) / 1e9;
+    double cpu = (ProcessCpuNow() - run_cpu_start) / 1e9;
+
+    outstream << std::endl;
+    outstream << "phase        wall s      cpu s      calls" << std::endl << std::endl;
+    outstream << std::fixed << std::setprecision(4);
+
+    for (int i = 0; i < static_cast<int>(StatsPhase::Count); ++i)
+    {
+        if (!phases[i].count) continue;
+
+        outstream << std::left << std::setw(10) << phase_names[i] << std::right;
+        outstream << std::setw(11) << phases[i].wall_ns / 1e9 << std::setw(11) << phases[i].cpu_ns / 1e9;
+        outstream << std::setw(11) << phases[i].count << std::endl;
+    }
+
+    outstream << std::left << std::setw(10) << "total" << std::right << std::setw(11) << wall << std::setw(11) << cpu << std::endl << std::endl;
+    outstream << std::setprecision(1);
+    outstream << "entries: " << entries << std::endl;
+    outstream << "read: " << bytes_read << " bytes, " << MiBPerSecond(bytes_read, wall) << " MiB/s" << std::endl;
+    outstream << "written: " << bytes_written << " bytes, " << MiBPerSecond(bytes_written, wall) << " MiB/s" << std::endl;
+    outstream << "peak rss: " << PeakRss() / 1024 << " KiB" << std::endl;
+    outstream << std::defaultfloat;
+}
+
+bool StatsWriteJson(const std::filesystem::path &path)
+{
+    std::ofstream filestream;
+    std::ostream *outstream = &std::cout;
+    double wall = (WallNow() - run_wall_start) / 1e9;
+    double cpu = (ProcessCpuNow() - run_cpu_start) / 1e9;
+
+    if (path != "-")
+    {
+        filestream.open(path);
+
+        if (filestream.fail())
+        {
+            std::cerr << "Error: Failed to create stats file \"" << path.string() << "\"" << std::endl;
+            return true;
+        }
+
+        outstream = &filestream;
+    }
+
+    *outstream << std::setprecision(9);
+    *outstream << "{\"wall_s\": " << wall << ", \"cpu_s\": " << cpu << ", \"entries\": " << entries;
+    *outstream << ", \"bytes_read\": " << bytes_read << ", \"bytes_written\": " << bytes_written;
+    *outstream << ", \"read_mib_per_s\": " << MiBPerSecond(bytes_read, wall) << ", \"write_mib_per_s\": " << MiBPerSecond(bytes_written, wall);
+    *outstream << ", \"peak_rss_bytes\": " << PeakRss() << ", \"phases\": {";
+
+    bool first = true;
+
+    for (int i = 0; i < static_cast<int>(StatsPhase::Count); ++i)
+    {
+        if (!phases[i].count) continue;
+
+        *outstream << (first ? "" : ", ") << "\"" << phase_names[i] << "\": {\"wall_s\": " << phases[i].wall_ns / 1e9;
+        *outstream << ", \"cpu_s\": " << phases[i].cpu_ns / 1e9 << ", \"calls\": " << phases[i].count << "}";
+        first = false;
+    }
+
+    *outstream << "}}" << std::endl;
+    *outstream << std::defaultfloat;
+
+    if (outstream->fail())
+    {
+        std::cerr << "Error: Failed to write stats" << std::endl;
+        return true;
+    }
+
+    return false;
+}
\ No newline at end of file
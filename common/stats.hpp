@@ -0,0 +1,81 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stdint.h>
+#include <filesystem>
+#include <ostream>
+
+// Optional per-phase timing and throughput reporting for the tools. Nothing is collected until StatsEnable()
+// is called, and until then every call here is a single check of a flag.
+
+enum class StatsPhase
+{
+    Parse,          // Reading headers, prespecs and filelists
+    Filesystem,     // Checking for, opening and creating files
+    Read,           // Reading file data
+    Inflate,
+    Deflate,
+    Convert,        // Copying image data between tex and dds layouts
+    Write,          // Writing file data
+    Count
+};
+
+extern bool stats_enabled;
+
+void StatsEnable();
+
+// Time spent in the enclosing scope is added to phase, both wall clock and cpu time of the calling thread.
+class StatsTimer
+{
+public:
+    explicit StatsTimer(StatsPhase phase) : phase(phase), active(stats_enabled)
+    {
+        if (active) Start();
+    }
+
+    ~StatsTimer()
+    {
+        if (active) Stop();
+    }
+
+    StatsTimer(const StatsTimer &) = delete;
+    StatsTimer &operator=(const StatsTimer &) = delete;
+
+private:
+    void Start();
+    void Stop();
+
+    StatsPhase phase;
+    bool active;
+    uint64_t wall_start = 0;
+    uint64_t cpu_start = 0;
+};
+
+void StatsAddRead(uint64_t bytes);
+void StatsAddWritten(uint64_t bytes);
+void StatsAddEntries(uint64_t count);
+
+// Print a summary of everything collected since StatsEnable().
+void StatsPrint(std::ostream &outstream);
+
+// Write the same summary as JSON to path, or to stdout if path is "-".
+bool StatsWriteJson(const std::filesystem::path &path);
\ No newline at end of file
@@ -0,0 +1,93 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "../common/std_stream.hpp"
+#include <stdio.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+bool IsStdStream(const std::filesystem::path &path)
+{
+    return path == "-";
+}
+
+std::istream &OpenInStream(const std::filesystem::path &path, std::ifstream &file, std::ios::openmode mode)
+{
+    if (!IsStdStream(path))
+    {
+        file.open(path, mode | std::ios::in);
+        return file;
+    }
+
+#if defined(_WIN32)
+    if (mode & std::ios::binary) _setmode(_fileno(stdin), _O_BINARY);
+#endif
+
+    return std::cin;
+}
+
+std::ostream &OpenOutStream(const std::filesystem::path &path, std::ofstream &file, std::ios::openmode mode)
+{
+    if (!IsStdStream(path))
+    {
+        file.open(path, mode | std::ios::out);
+        return file;
+    }
+
+#if defined(_WIN32)
+    if (mode & std::ios::binary) _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    return std::cout;
+}
+
+bool IsSequentialOutput(const std::filesystem::path &path)
+{
+    std::error_code ec;
+
+    if (IsStdStream(path)) return true;
+
+    // A file that doesn't exist yet is about to be created as a regular file.
+    std::filesystem::file_status status = std::filesystem::status(path, ec);
+
+    return !ec && std::filesystem::exists(status) && !std::filesystem::is_regular_file(status);
+}
+
+bool ReadWholeStream(std::istream &in_stream, std::vector<char> &data)
+{
+    const size_t chunksize = 1024 * 1024;
+    size_t size = 0;
+
+    data.clear();
+
+    while (in_stream.good())
+    {
+        data.resize(size + chunksize);
+        in_stream.read(data.data() + size, chunksize);
+        size += in_stream.gcount();
+    }
+
+    data.resize(size);
+
+    return in_stream.bad();
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// "-" stands for stdin or stdout wherever the tools take a file, so they can sit in a pipeline. Anything read
+// through these is only read forward, and anything written through them is never seeked back over.
+
+bool IsStdStream(const std::filesystem::path &path);
+
+// Open path into file and return it, or return std::cin or std::cout for "-". Check fail() on the result as
+// with any file stream.
+std::istream &OpenInStream(const std::filesystem::path &path, std::ifstream &file, std::ios::openmode mode = std::ios::binary);
+std::ostream &OpenOutStream(const std::filesystem::path &path, std::ofstream &file, std::ios::openmode mode = std::ios::binary);
+
+// Whether path can only be written front to back, like stdout, a pipe or a terminal.
+bool IsSequentialOutput(const std::filesystem::path &path);
+
+// Read everything left in a stream, for inputs with no size to ask for up front. Returns true on failure.
+bool ReadWholeStream(std::istream &in_stream, std::vector<char> &data);
\ No newline at end of file
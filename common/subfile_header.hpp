@@ -24,8 +24,8 @@
 
 struct SubFileHeader
 {
-    unsigned int inflatedSize;
-    unsigned int deflatedSize;
+    uint64_t inflatedSize;
+    uint64_t deflatedSize;
     unsigned int pathSize;
     unsigned int pathCRC;
     std::vector<char> path;
@@ -0,0 +1,398 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "../common/tar_file.hpp"
+#include "../common/pre_file.hpp"
+#include <string.h>
+#include <iostream>
+#include <algorithm>
+
+namespace
+{
+    const unsigned int block_size = 512;
+
+    // Long names and pax headers are read whole, and are never anywhere near this big in a real tar stream.
+    const uint64_t max_metadata_size = 1024 * 1024;
+
+    uint64_t PaddedSize(uint64_t size)
+    {
+        return (size + block_size - 1) / block_size * block_size;
+    }
+
+    // Octal fields are zero padded and end in a null.
+    void WriteOctal(char *field, size_t field_size, uint64_t value)
+    {
+        for (size_t i = field_size - 1; i > 0; --i)
+        {
+            field[i - 1] = '0' + (value & 7);
+            value >>= 3;
+        }
+
+        field[field_size - 1] = 0;
+    }
+
+    // GNU tar writes sizes too big for the octal field in base 256, marked by the high bit of the first byte.
+    bool ReadNumber(const char *field, size_t field_size, uint64_t &value)
+    {
+        value = 0;
+
+        if (static_cast<unsigned char>(field[0]) & 0x80)
+        {
+            value = static_cast<unsigned char>(field[0]) & 0x7f;
+
+            for (size_t i = 1; i < field_size; ++i)
+            {
+                if (value >> 56) return true;
+                value = (value << 8) | static_cast<unsigned char>(field[i]);
+            }
+
+            return false;
+        }
+
+        size_t i = 0;
+
+        while (i < field_size && field[i] == ' ') ++i;
+
+        for (; i < field_size && field[i] >= '0' && field[i] <= '7'; ++i)
+        {
+            value = (value << 3) | (field[i] - '0');
+        }
+
+        return false;
+    }
+
+    std::string ReadString(const char *field, size_t field_size)
+    {
+        return std::string(field, strnlen(field, field_size));
+    }
+
+    unsigned int HeaderChecksum(const char *block)
+    {
+        unsigned int sum = 0;
+
+        for (unsigned int i = 0; i < block_size; ++i)
+        {
+            // The checksum field itself counts as spaces.
+            sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(block[i]);
+        }
+
+        return sum;
+    }
+
+    bool WriteHeader(std::ostream &out_stream, const std::string &name, uint64_t size, char type)
+    {
+        char block[block_size] = {};
+
+        // Sizes up to 8 GiB fit in the octal field, which is plenty for anything in a pre file.
+        if (size >> 33)
+        {
+            std::cerr << "Error: \"" << name << "\" is too big for a tar entry" << std::endl;
+            return true;
+        }
+
+        memcpy(block, name.data(), std::min<size_t>(name.size(), 100));
+        WriteOctal(block + 100, 8, 0644);
+        WriteOctal(block + 108, 8, 0);
+        WriteOctal(block + 116, 8, 0);
+        WriteOctal(block + 124, 12, size);
+        WriteOctal(block + 136, 12, 0);
+        block[156] = type;
+        memcpy(block + 257, "ustar", 6);
+        memcpy(block + 263, "00", 2);
+
+        WriteOctal(block + 148, 7, HeaderChecksum(block));
+        block[155] = ' ';
+
+        out_stream.write(block, block_size);
+
+        if (out_stream.fail())
+        {
+            std::cerr << "Error: Failed to write tar header" << std::endl;
+            return true;
+        }
+
+        return false;
+    }
+
+    bool WriteData(std::ostream &out_stream, const char *data, uint64_t size)
+    {
+        const char zeros[block_size] = {};
+
+        out_stream.write(data, size);
+
+        out_stream.write(zeros, PaddedSize(size) - size);
+
+        if (out_stream.fail())
+        {
+            std::cerr << "Error: Failed to write tar data" << std::endl;
+            return true;
+        }
+
+        return false;
+    }
+
+    // Skip by reading, so this works on pipes too.
+    bool SkipBytes(std::istream &in_stream, uint64_t size)
+    {
+        while (size)
+        {
+            std::streamsize count = std::min<uint64_t>(size, 1024 * 1024);
+
+            in_stream.ignore(count);
+
+            if (in_stream.gcount() != count)
+            {
+                std::cerr << "Error: Failed to read tar data" << std::endl;
+                return true;
+            }
+
+            size -= count;
+        }
+
+        return false;
+    }
+
+    // A pax extended header is a list of "LENGTH KEY=VALUE\n" records. Only the path and size matter here.
+    bool ReadPaxHeader(const std::vector<char> &data, std::string &path, uint64_t &size, bool &has_size)
+    {
+        size_t pos = 0;
+
+        while (pos < data.size())
+        {
+            size_t length = 0;
+            size_t i = pos;
+
+            for (; i < data.size() && data[i] >= '0' && data[i] <= '9'; ++i) length = length * 10 + (data[i] - '0');
+
+            if (length == 0 || pos + length > data.size() || i >= data.size() || data[i] != ' ')
+            {
+                std::cerr << "Error: Invalid pax header in tar stream" << std::endl;
+                return true;
+            }
+
+            std::string record(data.data() + i + 1, pos + length - i - 2);
+            size_t equals = record.find('=');
+
+            if (equals != std::string::npos)
+            {
+                std::string key = record.substr(0, equals);
+
+                if (key == "path")
+                {
+                    path = record.substr(equals + 1);
+                }
+                else if (key == "size")
+                {
+                    try
+                    {
+                        size = std::stoull(record.substr(equals + 1));
+                        has_size = true;
+                    }
+                    catch (const std::exception &)
+                    {
+                        std::cerr << "Error: Invalid size in pax header" << std::endl;
+                        return true;
+                    }
+                }
+            }
+
+            pos += length;
+        }
+
+        return false;
+    }
+}
+
+bool WriteTarFile(std::ostream &out_stream, const std::string &name, const char *data, uint64_t size)
+{
+    if (name.size() > 100)
+    {
+        if (WriteHeader(out_stream, "././@LongLink", name.size() + 1, 'L')) return true;
+        if (WriteData(out_stream, name.c_str(), name.size() + 1)) return true;
+    }
+
+    if (WriteHeader(out_stream, name, size, '0')) return true;
+
+    return WriteData(out_stream, data, size);
+}
+
+bool WriteTarEnd(std::ostream &out_stream)
+{
+    const char zeros[block_size * 2] = {};
+
+    out_stream.write(zeros, sizeof(zeros));
+    out_stream.flush();
+
+    if (out_stream.fail())
+    {
+        std::cerr << "Error: Failed to write end of tar stream" << std::endl;
+        return true;
+    }
+
+    return false;
+}
+
+bool ReadTarHeader(std::istream &in_stream, TarEntryHeader &header, bool &end)
+{
+    std::string long_name;
+    uint64_t pax_size = 0;
+    bool has_pax_size = false;
+    std::vector<char> data;
+
+    end = false;
+
+    while (true)
+    {
+        char block[block_size];
+
+        in_stream.read(block, block_size);
+
+        // Some writers leave out the empty blocks at the end.
+        if (in_stream.gcount() == 0 && in_stream.eof() && long_name.empty())
+        {
+            end = true;
+            return false;
+        }
+
+        if (in_stream.gcount() != block_size)
+        {
+            std::cerr << "Error: Failed to read tar header" << std::endl;
+            return true;
+        }
+
+        bool empty = true;
+
+        for (char c : block) if (c) empty = false;
+
+        if (empty)
+        {
+            end = true;
+            return false;
+        }
+
+        uint64_t checksum;
+        uint64_t size;
+
+        ReadNumber(block + 148, 8, checksum);
+
+        if (checksum != HeaderChecksum(block))
+        {
+            std::cerr << "Error: Tar header checksum mismatch" << std::endl;
+            return true;
+        }
+
+        if (ReadNumber(block + 124, 12, size))
+        {
+            std::cerr << "Error: Tar entry too big" << std::endl;
+            return true;
+        }
+
+        char type = block[156];
+
+        if (type == 'L' || type == 'x')
+        {
+            if (size > max_metadata_size)
+            {
+                std::cerr << "Error: Tar " << (type == 'L' ? "long name" : "pax header") << " of " << size << " bytes is too big" << std::endl;
+                return true;
+            }
+
+            header.size = size;
+
+            if (ReadTarData(in_stream, header, data)) return true;
+
+            if (type == 'L')
+            {
+                long_name = ReadString(data.data(), data.size());
+            }
+            else if (ReadPaxHeader(data, long_name, pax_size, has_pax_size))
+            {
+                return true;
+            }
+
+            continue;
+        }
+
+        if (type == '0' || type == 0 || type == '7')
+        {
+            if (!long_name.empty())
+            {
+                header.name = long_name;
+            }
+            else
+            {
+                header.name = ReadString(block, 100);
+
+                // POSIX ustar splits long names between the name field and a prefix field.
+                if (memcmp(block + 257, "ustar", 6) == 0 && block[345])
+                {
+                    header.name = ReadString(block + 345, 155) + "/" + header.name;
+                }
+            }
+
+            header.size = has_pax_size ? pax_size : size;
+
+            // Checked before anything is read, since the size can be anything up to 8 GiB.
+            if (header.size > PreFieldMax)
+            {
+                std::cerr << "Error: \"" << header.name << "\" in the tar stream is too big for a pre file" << std::endl;
+                return true;
+            }
+
+            return false;
+        }
+
+        if (type == '5' || type == 'g')
+        {
+            if (SkipBytes(in_stream, PaddedSize(size))) return true;
+
+            long_name.clear();
+            has_pax_size = false;
+
+            continue;
+        }
+
+        std::cerr << "Error: Unsupported tar entry type '" << type << "' for \"" << ReadString(block, 100) << "\"" << std::endl;
+        return true;
+    }
+}
+
+// Read in chunks, so a stream that ends early fails before a buffer for the whole size is allocated.
+bool ReadTarData(std::istream &in_stream, const TarEntryHeader &header, std::vector<char> &data)
+{
+    data.clear();
+
+    while (data.size() < header.size)
+    {
+        size_t done = data.size();
+        size_t count = std::min<uint64_t>(header.size - done, 1024 * 1024);
+
+        data.resize(done + count);
+        in_stream.read(data.data() + done, count);
+
+        if (static_cast<size_t>(in_stream.gcount()) != count)
+        {
+            std::cerr << "Error: Failed to read tar data" << std::endl;
+            return true;
+        }
+    }
+
+    return SkipBytes(in_stream, PaddedSize(header.size) - header.size);
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stdint.h>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Reading and writing tar streams, so files can be passed between tools through a pipe instead of the disk.
+// Files are written as POSIX ustar entries, with a GNU long name entry in front of names that don't fit. All of
+// these print an error and return true on failure.
+
+struct TarEntryHeader
+{
+    std::string name;
+    uint64_t size = 0;
+};
+
+bool WriteTarFile(std::ostream &out_stream, const std::string &name, const char *data, uint64_t size);
+
+// The two empty blocks that mark the end of a tar stream.
+bool WriteTarEnd(std::ostream &out_stream);
+
+// Read the header of the next file, skipping directories and pax global headers. end is set instead at the end
+// of the stream. Only reads forward, so the stream doesn't need to be seekable. Files too big to go in a pre file
+// are an error.
+bool ReadTarHeader(std::istream &in_stream, TarEntryHeader &header, bool &end);
+
+// Read the contents of the file whose header was just read, along with the padding after them.
+bool ReadTarData(std::istream &in_stream, const TarEntryHeader &header, std::vector<char> &data);
\ No newline at end of file
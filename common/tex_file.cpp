@@ -0,0 +1,527 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "../common/tex_file.hpp"
+#include "../common/read_word.hpp"
+#include "../common/write_word.hpp"
+#include "../common/std_stream.hpp"
+#include "../common/file_io.hpp"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <memory>
+#include <algorithm>
+
+bool ReadTexHeader(std::istream &in_stream, TexFileHeader &out_header)
+{
+    char buffer[8];
+
+    in_stream.read(buffer, 8);
+
+    if (in_stream.fail() || in_stream.gcount() != 8)
+    {
+        std::cerr << "Error: Failed to read file header" << std::endl;
+        return true;
+    }
+
+    out_header.version = read_u32le(&buffer[0]);
+    out_header.num_files = read_u32le(&buffer[4]);
+
+    return false;
+}
+
+bool ReadImageHeader(std::istream &in_stream, TexImageHeader &out_header)
+{
+    char buffer[36];
+
+    in_stream.read(buffer, 36);
+
+    if (in_stream.fail() || in_stream.gcount() != 36)
+    {
+        std::cerr << "Error: Failed to read image header" << std::endl;
+        return true;
+    }
+
+    out_header.checksum = read_u32le(buffer + 0);
+    out_header.width = read_u32le(buffer + 4);
+    out_header.height = read_u32le(buffer + 8);
+    out_header.levels = read_u32le(buffer + 12);
+    out_header.dxt = read_u32le(buffer + 24);
+    out_header.size = read_u32le(buffer + 32);
+
+    return false;
+}
+
+bool ReadImageLevelSize(std::istream &in_stream, uint32_t &out_size)
+{
+    char size_buffer[4];
+    
+    in_stream.read(size_buffer, 4);
+
+    if (in_stream.fail() || in_stream.gcount() != 4)
+    {
+        std::cerr << "Error: Failed to read mipmap level size" << std::endl;
+        return true;
+    }
+
+    out_size = read_u32le(size_buffer);
+
+    return false;
+}
+
+bool SkipImageLevel(std::istream &in_stream, unsigned int size)
+{
+    in_stream.ignore(size);
+
+    if (in_stream.fail() || in_stream.gcount() != size)
+    {
+        std::cerr << "Error: Failed to skip image data" << std::endl;
+        return true;
+    }
+
+    return false;
+}
+
+bool ReadImageLevel(std::istream &in_stream, std::ostream &out_stream, unsigned int size)
+{
+    // Big enough that most mip levels are copied in one go.
+    const unsigned int chunk_size = 256 * 1024;
+    auto data_buffer = std::make_unique<char[]>(std::min(size, chunk_size));
+    unsigned int pos = 0;
+
+    while (pos < size)
+    {
+        unsigned int read_count = (size - pos > chunk_size) ? chunk_size : (size - pos);
+        
+        in_stream.read(data_buffer.get(), read_count);
+
+        if (in_stream.fail() || in_stream.gcount() != read_count)
+        {
+            std::cerr << "Error: Failed to read image data" << std::endl;
+            return true;
+        }
+
+        out_stream.write(data_buffer.get(), read_count);
+
+        if (out_stream.fail())
+        {
+            std::cerr << "Error: Failed to write image data" << std::endl;
+            return true;
+        }
+
+        pos += read_count;
+    }
+
+    if (pos != size)
+    {
+        std::cerr << "Error: Failed to read/write image data" << std::endl;
+        return true;
+    }
+
+    return false;
+}
+
+bool WriteTexHeader(std::ostream &out_stream, unsigned int num_files)
+{
+    char buffer[8];
+
+    write_u32le(buffer, 1);
+    write_u32le(buffer + 4, num_files);
+
+    out_stream.write(buffer, 8);
+
+    if (out_stream.fail())
+    {
+        std::cerr << "Error: Failed to write tex file header" << std::endl;
+        return true;
+    }
+        
+    return false;
+}
+
+bool WriteImageHeader(std::ostream &out_stream, const TexImageHeader &image_header)
+{
+    char buffer[32];
+
+    write_u32le(buffer, image_header.checksum);
+    write_u32le(buffer + 4, image_header.width);
+    write_u32le(buffer + 8, image_header.height);
+    write_u32le(buffer + 12, image_header.levels);
+    write_u32le(buffer + 16, 32); // Don't know what these are. Often 32.
+    write_u32le(buffer + 20, 32);
+    write_u32le(buffer + 24, image_header.dxt);
+    write_u32le(buffer + 28, 0); // Don't know what this is. Usually 0.
+
+    out_stream.write(buffer, 32);
+
+    if (out_stream.fail())
+    {
+        std::cerr << "Error: Failed to write image file header" << std::endl;
+        return true;
+    }
+
+    return false;
+}
+
+bool CheckImageHeader(TexImageHeader &i_header, unsigned int index, bool &dxt2)
+{
+    dxt2 = false;
+
+    if (i_header.dxt > 5 || i_header.dxt == 0)
+    {
+        std::cerr << "Error: Invalid dxt version (" << i_header.dxt << ") in image " << index << std::endl;
+        return true;
+    }
+
+    if (i_header.dxt == 2)
+    {
+        unsigned int expected_size = i_header.width * i_header.height;
+        
+        if (i_header.size == expected_size / 2)
+        {
+            dxt2 = true;
+            i_header.dxt = 1;
+        }
+        else if (i_header.size != expected_size)
+        {
+            std::cerr << "Error: " << i_header.width << "x" << i_header.height << " dxt" << i_header.dxt << " image should be " << expected_size << " bytes, but was " << i_header.size << std::endl;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void BuildDdsHeader(const TexImageHeader &i_header, DdsFileHeader &dds_header)
+{
+    const char char_table[5] = {'1', '2', '3', '4', '5'};
+
+    dds_header.flags = 0xa1007; // DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE
+    dds_header.height = i_header.height;
+    dds_header.width = i_header.width;
+    dds_header.pitch = i_header.size; // First mipmap level size
+    dds_header.depth = 0;
+    dds_header.levels = i_header.levels;
+    
+    dds_header.pix_fmt.flags = 0x4; // Indicate that the fourcc field is present
+    dds_header.pix_fmt.fourcc[0] = 'D';
+    dds_header.pix_fmt.fourcc[1] = 'X';
+    dds_header.pix_fmt.fourcc[2] = 'T';
+    dds_header.pix_fmt.fourcc[3] = char_table[i_header.dxt - 1];
+    dds_header.pix_fmt.rgb_bits = 0; // Leaving the rest of the pixel format as 0 seems to work fine
+    dds_header.pix_fmt.r_bitmask = 0;
+    dds_header.pix_fmt.g_bitmask = 0;
+    dds_header.pix_fmt.b_bitmask = 0;
+    dds_header.pix_fmt.a_bitmask = 0;
+
+    dds_header.caps = 0x401008; // DDSCAPS_COMPLEX | DDS_CAPS_MIPMAP | DDSCAPS_TEXTURE
+    dds_header.caps2 = 0; // Cubemap capabilities, not used.
+}
+
+bool WriteDdsHeader(std::ostream &out_stream, const DdsFileHeader &dds_header)
+{
+    char buffer[128];
+
+    // Magic number
+    buffer[0] = 'D';
+    buffer[1] = 'D';
+    buffer[2] = 'S';
+    buffer[3] = ' ';
+
+    write_u32le(buffer + 4, 124); // Size, always 124
+    write_u32le(buffer + 8, dds_header.flags);
+    write_u32le(buffer + 12, dds_header.height);
+    write_u32le(buffer + 16, dds_header.width);
+    write_u32le(buffer + 20, dds_header.pitch);
+    write_u32le(buffer + 24, dds_header.depth);
+    write_u32le(buffer + 28, dds_header.levels);
+    std::fill(buffer + 32, buffer + 76, 0); // Zero out 44 unused reserved1 bytes.
+    
+    // DDS Pixel Format
+    write_u32le(buffer + 76, 32); // Size, always 32
+    write_u32le(buffer + 80, dds_header.pix_fmt.flags);
+    std::copy(dds_header.pix_fmt.fourcc, dds_header.pix_fmt.fourcc + 4, buffer + 84);
+    write_u32le(buffer + 88, dds_header.pix_fmt.rgb_bits);
+    write_u32le(buffer + 92, dds_header.pix_fmt.r_bitmask);
+    write_u32le(buffer + 96, dds_header.pix_fmt.g_bitmask);
+    write_u32le(buffer + 100, dds_header.pix_fmt.b_bitmask);
+    write_u32le(buffer + 104, dds_header.pix_fmt.a_bitmask);
+    
+    write_u32le(buffer + 108, dds_header.caps);
+    write_u32le(buffer + 112, dds_header.caps2);
+    std::fill(buffer + 116, buffer + 128, 0); // Zero out 12 unused cap3, cap4, and reserved2 bytes.
+
+    out_stream.write(buffer, 128);
+
+    if (out_stream.fail())
+    {
+        std::cerr << "Error: failed to write file header" << std::endl;
+        return true;
+    }
+
+    return false;
+}
+
+bool ReadDdsHeader(std::istream &in_stream, DdsFileHeader &dds_header)
+{
+    char buffer[128];
+
+    in_stream.read(buffer, 128);
+
+    if (in_stream.fail())
+    {
+        std::cerr << "Error: Failed to read dds file header" << std::endl;
+        return true;
+    }
+
+    if (!(buffer[0] == 'D') || !(buffer[1] == 'D') || !(buffer[2] == 'S') || !(buffer[3] = ' '))
+    {
+        std::cerr << "Error: DDS file doesn't begin with \"DDS \"" << std::endl;
+        return true;
+    }
+
+    if (read_u32le(buffer + 4) != 124)
+    {
+        std::cerr << "Error: DDS file reports header size other than 124" << std::endl;
+        return true;
+    }
+
+    if (read_u32le(buffer + 76) != 32)
+    {
+        std::cerr << "Error: DDS file reports pixel format header size other than 32" << std::endl;
+        return true;
+    }
+
+    dds_header.flags = read_u32le(buffer + 8);
+    dds_header.height = read_u32le(buffer + 12);
+    dds_header.width = read_u32le(buffer + 16);
+    dds_header.pitch = read_u32le(buffer + 20);
+    dds_header.depth = read_u32le(buffer + 24);
+    dds_header.levels = read_u32le(buffer + 28);
+    dds_header.pix_fmt.flags = read_u32le(buffer + 80);
+    std::copy(buffer + 84, buffer + 88, dds_header.pix_fmt.fourcc);
+    dds_header.pix_fmt.rgb_bits = read_u32le(buffer + 88);
+    dds_header.pix_fmt.r_bitmask = read_u32le(buffer + 92);
+    dds_header.pix_fmt.g_bitmask = read_u32le(buffer + 96);
+    dds_header.pix_fmt.b_bitmask = read_u32le(buffer + 100);
+    dds_header.pix_fmt.a_bitmask = read_u32le(buffer + 104);
+    dds_header.caps = read_u32le(buffer + 108);
+    dds_header.caps2 = read_u32le(buffer + 112);
+    
+    return false;
+}
+
+bool GetDdsData(std::istream &in_stream, std::vector<char> &dds_data, const DdsFileHeader &dds_header)
+{
+    unsigned int buffer_pos = 0;
+    unsigned int total_size = 0;
+    unsigned int level_size = dds_header.pitch;
+
+    // Calculate total size of image data assuming each level is 1/4 the size of the previous one.
+    for (unsigned int i = 0; i < dds_header.levels; ++i)
+    {
+        total_size += level_size;
+        level_size /= 4;
+    }
+
+    // Prepare the vector to receive the image data.
+    // An image in a TEX file differs from a DDS image in that each level is preceded by its size.
+    // In a DDS image, only the number of levels and the size of the first level are known.
+    dds_data.resize(total_size + (dds_header.levels * 4));
+
+    // In a compressed (DXTx/BCx) DDS file, the pitch indicates the size of the first level.
+    level_size = dds_header.pitch;
+    
+    for (unsigned int i = 0; i < dds_header.levels; ++i)
+    {
+        write_u32le(dds_data.data() + buffer_pos, level_size);
+        buffer_pos += 4;
+
+        in_stream.read(dds_data.data() + buffer_pos, level_size);
+        buffer_pos += level_size;
+        
+        if (in_stream.fail())
+        {
+            std::cerr << "Error: Failed to read dds pixel data" << std::endl;
+            return true;
+        }
+        
+        level_size /= 4;
+    }
+
+    return false;
+}
+
+bool WriteDdsImage(std::istream &in_stream, std::ostream &out_stream, const TexImageHeader &i_header, uint64_t &data_size)
+{
+    DdsFileHeader dds_header;
+    uint32_t level_size;
+
+    BuildDdsHeader(i_header, dds_header);
+
+    if (WriteDdsHeader(out_stream, dds_header)) return true;
+
+    // The first level's size was read with the image header.
+    if (ReadImageLevel(in_stream, out_stream, i_header.size)) return true;
+
+    data_size = i_header.size;
+
+    for (unsigned int i = 1; i < i_header.levels; ++i)
+    {
+        if (ReadImageLevelSize(in_stream, level_size)) return true;
+        if (ReadImageLevel(in_stream, out_stream, level_size)) return true;
+
+        data_size += level_size;
+    }
+
+    return false;
+}
+
+bool CheckDdsHeader(const DdsFileHeader &dds_header)
+{
+    if (!(dds_header.flags & 0xa1007))
+    {
+        std::cerr << "Error: DDS file flags incorrect" << std::endl;
+        return true;
+    }
+
+    if (!(dds_header.flags & 0x4))
+    {
+        std::cerr << "Error: DDS file pixel format flags incorrect" << std::endl;
+        return true;
+    }
+
+    return false;
+}
+
+bool BuildImageHeader(const DdsFileHeader &dds_header, uint32_t checksum, TexImageHeader &i_header)
+{
+    i_header.checksum = checksum;
+    i_header.width = dds_header.width;
+    i_header.height = dds_header.height;
+    i_header.levels = dds_header.levels;
+
+    // Copy over the DXT compression scheme used, or error out.
+    if ((dds_header.pix_fmt.fourcc[3] < '1') || (dds_header.pix_fmt.fourcc[3] > '5'))
+    {
+        std::cerr << "Error: DDS file unsupported fourcc \"" << std::string(dds_header.pix_fmt.fourcc, 4) << "\"" << std::endl;
+        return true;
+    }
+
+    i_header.dxt = dds_header.pix_fmt.fourcc[3] - '0';
+
+    return false;
+}
+
+bool ReadFileList(const std::filesystem::path &list_path, std::vector<std::filesystem::path> &file_list, std::vector<unsigned int> &checksum_list)
+{
+    std::ifstream in_file;
+    std::istream &in_stream = OpenInStream(list_path, in_file, std::ios::in);
+    std::string line;
+    std::vector<unsigned int> list_checksums;
+    size_t num_files = 0;
+
+    if (in_stream.fail())
+    {
+        std::cerr << "Error: Failed to read file list \"" << list_path.string() << "\"" << std::endl;
+        return true;
+    }
+
+    while (std::getline(in_stream, line))
+    {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+
+        size_t tab = line.find('\t');
+
+        if (tab != std::string::npos)
+        {
+            try
+            {
+                list_checksums.push_back(std::stoul(line.substr(tab + 1), nullptr, 0));
+            }
+            catch (const std::exception &)
+            {
+                std::cerr << "Error: Invalid checksum in file list \"" << list_path.string() << "\": " << line << std::endl;
+                return true;
+            }
+
+            line.resize(tab);
+        }
+
+        file_list.push_back(line);
+        ++num_files;
+    }
+
+    if (in_stream.bad())
+    {
+        std::cerr << "Error: Failed to read file list \"" << list_path.string() << "\"" << std::endl;
+        return true;
+    }
+
+    if (list_checksums.size() == num_files)
+    {
+        checksum_list.insert(checksum_list.end(), list_checksums.begin(), list_checksums.end());
+    }
+
+    return false;
+}
+
+bool WriteTexFromFileList(const std::filesystem::path &list_path, std::ostream &out_stream)
+{
+    std::vector<std::filesystem::path> file_list;
+    std::vector<unsigned int> checksum_list;
+    std::vector<char> dds_data;
+
+    if (ReadFileList(list_path, file_list, checksum_list)) return true;
+
+    if (WriteTexHeader(out_stream, file_list.size())) return true;
+
+    for (size_t i = 0; i < file_list.size(); ++i)
+    {
+        FileSource in_file;
+        bool failed = in_file.Open(file_list[i]);
+        std::istream &in_stream = in_file.Stream();
+        DdsFileHeader dds_header;
+        TexImageHeader image_header;
+
+        if (failed || in_stream.fail())
+        {
+            std::cerr << "Error: Failed to open dds file \"" << file_list[i].string() << "\"" << std::endl;
+            return true;
+        }
+
+        if (ReadDdsHeader(in_stream, dds_header)) return true;
+        if (CheckDdsHeader(dds_header)) return true;
+        if (BuildImageHeader(dds_header, checksum_list.size() ? checksum_list[i] : 0, image_header)) return true;
+        if (GetDdsData(in_stream, dds_data, dds_header)) return true;
+        if (WriteImageHeader(out_stream, image_header)) return true;
+
+        out_stream.write(dds_data.data(), dds_data.size());
+
+        if (out_stream.fail())
+        {
+            std::cerr << "Error: Failed to write image file data" << std::endl;
+            return true;
+        }
+    }
+
+    return false;
+}
\ No newline at end of file
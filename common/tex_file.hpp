@@ -0,0 +1,70 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "../common/tex_header.hpp"
+#include "../common/dds_header.hpp"
+#include <stdint.h>
+#include <istream>
+#include <ostream>
+#include <vector>
+#include <filesystem>
+
+// Reading and writing tex.xbx and dds files. All of these print an error and return true on failure.
+
+// tex.xbx
+bool ReadTexHeader(std::istream &in_stream, TexFileHeader &out_header);
+bool ReadImageHeader(std::istream &in_stream, TexImageHeader &out_header);
+bool ReadImageLevelSize(std::istream &in_stream, uint32_t &out_size);
+bool SkipImageLevel(std::istream &in_stream, unsigned int size);
+bool ReadImageLevel(std::istream &in_stream, std::ostream &out_stream, unsigned int size);
+bool WriteTexHeader(std::ostream &out_stream, unsigned int num_files);
+bool WriteImageHeader(std::ostream &out_stream, const TexImageHeader &image_header);
+
+// Check an image header from ReadImageHeader. Some THUG Pro tex.xbx files say their images are dxt2 when they
+// are dxt1; those are changed to dxt1 and dxt2 is set.
+bool CheckImageHeader(TexImageHeader &i_header, unsigned int index, bool &dxt2);
+
+// dds
+void BuildDdsHeader(const TexImageHeader &i_header, DdsFileHeader &dds_header);
+bool WriteDdsHeader(std::ostream &out_stream, const DdsFileHeader &dds_header);
+
+// Write the image whose header was just read from in_stream as a dds file: the header, then every mipmap
+// level. data_size gets the size of the image data, not counting headers.
+bool WriteDdsImage(std::istream &in_stream, std::ostream &out_stream, const TexImageHeader &i_header, uint64_t &data_size);
+bool ReadDdsHeader(std::istream &in_stream, DdsFileHeader &dds_header);
+bool GetDdsData(std::istream &in_stream, std::vector<char> &dds_data, const DdsFileHeader &dds_header);
+
+// Check the flags of a dds header from ReadDdsHeader.
+bool CheckDdsHeader(const DdsFileHeader &dds_header);
+
+// Fill in a tex.xbx image header for a dds header. Fails if its fourcc isn't DXT1-5.
+bool BuildImageHeader(const DdsFileHeader &dds_header, uint32_t checksum, TexImageHeader &i_header);
+
+// filelist
+
+// One dds file per line. A line may also have the image's checksum after the path, separated by a tab, as
+// written by ug2-pre-unpack --tex-to-dds. The checksums are only used if every line has one.
+bool ReadFileList(const std::filesystem::path &list_path, std::vector<std::filesystem::path> &file_list, std::vector<unsigned int> &checksum_list);
+
+// Build a whole tex.xbx file from the dds files in a filelist, the same way ug2-dds2tex does. Images without
+// a checksum in the filelist get 0.
+bool WriteTexFromFileList(const std::filesystem::path &list_path, std::ostream &out_stream);
\ No newline at end of file
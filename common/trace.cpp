@@ -0,0 +1,166 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "../common/trace.hpp"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+bool trace_enabled = false;
+
+namespace
+{
+    struct TraceEvent
+    {
+        const char *name;
+        std::string detail;
+        uint64_t start;
+        uint64_t duration;
+    };
+
+    struct ThreadBuffer
+    {
+        unsigned int tid;
+        std::vector<TraceEvent> events;
+    };
+
+    // Only touched when a thread records its first span, and when the trace is written.
+    std::mutex buffers_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    uint64_t trace_start = 0;
+
+    thread_local ThreadBuffer *thread_buffer = nullptr;
+
+    uint64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    ThreadBuffer &GetThreadBuffer()
+    {
+        if (!thread_buffer)
+        {
+            std::lock_guard<std::mutex> lock(buffers_mutex);
+
+            buffers.push_back(std::make_unique<ThreadBuffer>());
+            thread_buffer = buffers.back().get();
+            thread_buffer->tid = buffers.size();
+            thread_buffer->events.reserve(1024);
+        }
+
+        return *thread_buffer;
+    }
+
+    void WriteJsonString(std::ostream &outstream, const std::string &str)
+    {
+        outstream << '"';
+
+        for (char c : str)
+        {
+            if (c == '"' || c == '\\')
+            {
+                outstream << '\\' << c;
+            }
+            else if (static_cast<unsigned char>(c) < 32)
+            {
+                outstream << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec << std::setfill(' ');
+            }
+            else
+            {
+                outstream << c;
+            }
+        }
+
+        outstream << '"';
+    }
+}
+
+void TraceEnable()
+{
+    trace_enabled = true;
+    trace_start = Now();
+}
+
+void TraceSpan::Start()
+{
+    start = Now();
+}
+
+void TraceSpan::Stop()
+{
+    GetThreadBuffer().events.push_back({name, std::move(detail), start - trace_start, Now() - start});
+}
+
+bool TraceWrite(const std::filesystem::path &path)
+{
+    std::ofstream outstream(path);
+    bool first = true;
+
+    if (outstream.fail())
+    {
+        std::cerr << "Error: Failed to create trace file \"" << path.string() << "\"" << std::endl;
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+
+    // Timestamps are in microseconds.
+    outstream << std::fixed << std::setprecision(3);
+    outstream << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+
+    for (const std::unique_ptr<ThreadBuffer> &buffer : buffers)
+    {
+        outstream << (first ? "" : ",\n");
+        outstream << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->tid;
+        outstream << ", \"args\": {\"name\": \"thread " << buffer->tid << "\"}}";
+        first = false;
+
+        for (const TraceEvent &event : buffer->events)
+        {
+            outstream << ",\n{\"name\": ";
+            WriteJsonString(outstream, event.name);
+            outstream << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->tid;
+            outstream << ", \"ts\": " << event.start / 1e3 << ", \"dur\": " << event.duration / 1e3;
+
+            if (!event.detail.empty())
+            {
+                outstream << ", \"args\": {\"detail\": ";
+                WriteJsonString(outstream, event.detail);
+                outstream << "}";
+            }
+
+            outstream << "}";
+        }
+    }
+
+    outstream << "\n]}" << std::endl;
+
+    if (outstream.fail())
+    {
+        std::cerr << "Error: Failed to write trace file \"" << path.string() << "\"" << std::endl;
+        return true;
+    }
+
+    return false;
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stdint.h>
+#include <filesystem>
+#include <string>
+
+// Optional timeline of what each thread was doing, written in the Chrome trace event format so it can be
+// opened in chrome://tracing or Perfetto. Spans are recorded into a buffer owned by the recording thread, so
+// threads never wait on each other while tracing. Until TraceEnable() is called a span is a single flag check.
+
+extern bool trace_enabled;
+
+void TraceEnable();
+
+// Records the enclosing scope as a span named name. name must outlive the trace, in practice a string
+// literal. detail is shown as an argument of the span, e.g. the subfile being worked on.
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name) : name(name), active(trace_enabled)
+    {
+        if (active) Start();
+    }
+
+    TraceSpan(const char *name, const std::string &detail) : name(name), active(trace_enabled)
+    {
+        if (active)
+        {
+            this->detail = detail;
+            Start();
+        }
+    }
+
+    ~TraceSpan()
+    {
+        if (active) Stop();
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    void Start();
+    void Stop();
+
+    const char *name;
+    bool active;
+    std::string detail;
+    uint64_t start = 0;
+};
+
+// Write every span recorded so far. Only call once the threads that recorded them are done.
+bool TraceWrite(const std::filesystem::path &path);
\ No newline at end of file
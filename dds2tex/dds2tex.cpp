@@ -23,10 +23,12 @@
 #include <string>
 #include <iostream>
 #include <fstream>
-#include "../common/dds_header.hpp"
-#include "../common/write_word.hpp"
+#include "../common/tex_file.hpp"
+#include "../common/std_stream.hpp"
+#include "../common/file_io.hpp"
 #include "../common/read_word.hpp"
-#include "../common/tex_header.hpp"
+#include "../common/report.hpp"
+#include "../common/stats.hpp"
 
 typedef std::vector<std::filesystem::path> FileList;
 typedef std::vector<unsigned int> ChecksumList;
@@ -35,8 +37,11 @@ struct OptionStruct
 {
 	bool write = true;
 	bool quiet = false;
+	bool json = false;
 	bool print_help = false;
 	bool overwrite = false;
+	bool stats = false;
+	FileIoBackend file_io = FileIoBackend::Stream;
 };
 
 struct PathStruct
@@ -44,11 +49,11 @@ struct PathStruct
 	std::filesystem::path out_path = "";
 	std::filesystem::path checksum_path = "";
 	std::filesystem::path list_path = "";
+	std::filesystem::path stats_json = "";
 };
 
 void PrintHelp();
 bool ReadArgs(int argc, char **argv, PathStruct &paths, FileList &file_list, OptionStruct &options);
-bool ReadList(std::filesystem::path &list_path, FileList &file_list);
 bool ReadChecksums(std::filesystem::path &checksum_path, ChecksumList &checksum_list);
 bool ReadFiles(std::filesystem::path &out_path, FileList &file_list, ChecksumList &checksum_list, OptionStruct &options);
 
@@ -74,19 +79,46 @@ int main(int argc, char **argv)
 		return 0;
 	}
 
+	ReportSetMode(options.json ? ReportMode::JsonLines : (options.quiet ? ReportMode::Quiet : ReportMode::Plain));
+
+	if (options.stats || !paths.stats_json.empty()) StatsEnable();
+
+	SetFileIoBackend(options.file_io);
+
+	// The tex file goes to stdout, so everything else goes to stderr.
+	if (options.write && IsStdStream(paths.out_path))
+	{
+		if (IsStdStream(paths.stats_json))
+		{
+			std::cerr << "Error: --stats-json can't write to stdout along with the tex file" << std::endl;
+			return -1;
+		}
+
+		ReportSetStream(std::cerr);
+	}
+
 	if (!paths.list_path.empty())
 	{
-		if (ReadList(paths.list_path, file_list)) return -1;
+		StatsTimer timer(StatsPhase::Parse);
+
+		if (ReadFileList(paths.list_path, file_list, checksum_list)) return -1;
 	}
 	
 	if (!paths.checksum_path.empty())
 	{
-		if (ReadChecksums(paths.checksum_path, checksum_list)) return -1;
+		// Checksums from a tex file take the place of any in the file list.
+		checksum_list.clear();
 
-		if (!options.quiet)
 		{
-			std::cout << "Read " << checksum_list.size() << " checksums from \"" << paths.checksum_path.string() << "\"" << std::endl << std::endl;
+			StatsTimer timer(StatsPhase::Parse);
+
+			if (ReadChecksums(paths.checksum_path, checksum_list)) return -1;
 		}
+
+		ReportRecord record("checksums");
+
+		record.Field("path", paths.checksum_path.string()).Field("count", checksum_list.size());
+		record.Text() << "Read " << checksum_list.size() << " checksums from \"" << paths.checksum_path.string() << "\"\n";
 	}
 
 	if (paths.out_path.empty())
@@ -96,6 +128,11 @@ int main(int argc, char **argv)
 	}
 
 	if (ReadFiles(paths.out_path, file_list, checksum_list, options)) return -1;
+
+	ReportFlush();
+
+	if (options.stats) StatsPrint((options.write && IsStdStream(paths.out_path)) ? std::cerr : std::cout);
+	if (!paths.stats_json.empty() && StatsWriteJson(paths.stats_json)) return -1;
 		
 	return 0;
 }
@@ -115,6 +152,10 @@ void PrintHelp()
 	std::cout << "    -l FILELIST                 Provide list of input files." << std::endl;
 	std::cout << "    -c TEXFILE                  Provide tex.xbx file to copy checksums from." << std::endl;
 	std::cout << "    -w                          Overwrite existing output file." << std::endl;
+	std::cout << "    --file-io BACKEND           Read and write files with stream, the default, mmap, pread or memory." << std::endl;
+	std::cout << "    --json                      Print the listing as one JSON object per line." << std::endl;
+	std::cout << "    --stats                     Print time spent in each phase, throughput and peak memory." << std::endl;
+	std::cout << "    --stats-json FILE           Write the same report as JSON to FILE, or stdout if FILE is -." << std::endl;
 }
 
 bool ReadArgs(int argc, char **argv, PathStruct &paths, FileList &file_list, OptionStruct &options)
@@ -125,7 +166,42 @@ bool ReadArgs(int argc, char **argv, PathStruct &paths, FileList &file_list, Opt
 	{
 		arg = argv[i];
 
-		if ((arg[0] == '-') && (arg.size() > 1))
+		if (arg == "--json")
+		{
+			options.json = true;
+		}
+		else if (arg == "--stats")
+		{
+			options.stats = true;
+		}
+		else if (arg == "--stats-json")
+		{
+			if (i + 1 >= argc)
+			{
+				std::cerr << "Error: Wrong number of arguments after --stats-json" << std::endl;
+				return true;
+			}
+
+			++i;
+			paths.stats_json = argv[i];
+		}
+		else if (arg == "--file-io")
+		{
+			if (i + 1 >= argc)
+			{
+				std::cerr << "Error: Wrong number of arguments after --file-io" << std::endl;
+				return true;
+			}
+
+			++i;
+
+			if (ParseFileIoBackend(argv[i], options.file_io))
+			{
+				std::cerr << "Error: Unknown file I/O backend \"" << argv[i] << "\"" << std::endl;
+				return true;
+			}
+		}
+		else if ((arg[0] == '-') && (arg.size() > 1))
 		{
 			std::string switches = arg.substr(1, arg.size() - 1);
 			bool exclusive_sw = false;
@@ -216,40 +292,15 @@ bool ReadArgs(int argc, char **argv, PathStruct &paths, FileList &file_list, Opt
 	return false;
 }
 
-bool ReadList(std::filesystem::path &list_path, FileList &file_list)
-{
-	std::ifstream in_stream(list_path);
-	std::string line;
-
-	if (in_stream.fail())
-	{
-		std::cerr << "Error: Failed to read file list \"" << list_path.string() << "\"" << std::endl;
-		return true;
-	}
-
-	while (!in_stream.eof())
-	{
-		std::getline(in_stream, line);
-
-		if (in_stream.fail())
-		{
-			std::cerr << "Error: Failed to read file list \"" << list_path.string() << "\"" << std::endl;
-			return true;
-		}
-
-		file_list.push_back(line);
-	}
-
-	return false;
-}
-
 bool ReadChecksums(std::filesystem::path &checksum_path, ChecksumList &checksum_list)
 {
 	unsigned int num_images = 0;
 	char word[4];
-	std::ifstream in_stream(checksum_path, std::ios::binary);
+	FileSource in_file;
+	bool failed = in_file.Open(checksum_path);
+	std::istream &in_stream = in_file.Stream();
 
-	if (in_stream.fail())
+	if (failed || in_stream.fail())
 	{
 		std::cerr << "Error: Failed to read tex file \"" << checksum_path.string() << "\"" << std::endl;
 		return true;
@@ -309,141 +360,10 @@ bool ReadChecksums(std::filesystem::path &checksum_path, ChecksumList &checksum_
 	return false;
 }
 
-bool WriteTexHeader(std::ofstream &out_stream, unsigned int num_files)
-{
-	char buffer[8];
-
-	write_u32le(buffer, 1);
-	write_u32le(buffer + 4, num_files);
-
-	out_stream.write(buffer, 8);
-
-	if (out_stream.fail())
-	{
-		std::cerr << "Error: Failed to write tex file header" << std::endl;
-		return true;
-	}
-		
-	return false;
-}
-
-bool ReadDdsHeader(std::ifstream &in_stream, DdsFileHeader &dds_header)
-{
-	char buffer[128];
-
-	in_stream.read(buffer, 128);
-
-	if (in_stream.fail())
-	{
-		std::cerr << "Error: Failed to read dds file header" << std::endl;
-		return true;
-	}
-
-	if (!(buffer[0] == 'D') || !(buffer[1] == 'D') || !(buffer[2] == 'S') || !(buffer[3] = ' '))
-	{
-		std::cerr << "Error: DDS file doesn't begin with \"DDS \"" << std::endl;
-		return true;
-	}
-
-	if (read_u32le(buffer + 4) != 124)
-	{
-		std::cerr << "Error: DDS file reports header size other than 124" << std::endl;
-		return true;
-	}
-
-	if (read_u32le(buffer + 76) != 32)
-	{
-		std::cerr << "Error: DDS file reports pixel format header size other than 32" << std::endl;
-		return true;
-	}
-
-	dds_header.flags = read_u32le(buffer + 8);
-	dds_header.height = read_u32le(buffer + 12);
-	dds_header.width = read_u32le(buffer + 16);
-	dds_header.pitch = read_u32le(buffer + 20);
-	dds_header.depth = read_u32le(buffer + 24);
-	dds_header.levels = read_u32le(buffer + 28);
-	dds_header.pix_fmt.flags = read_u32le(buffer + 80);
-	std::copy(buffer + 84, buffer + 88, dds_header.pix_fmt.fourcc);
-	dds_header.pix_fmt.rgb_bits = read_u32le(buffer + 88);
-	dds_header.pix_fmt.r_bitmask = read_u32le(buffer + 92);
-	dds_header.pix_fmt.g_bitmask = read_u32le(buffer + 96);
-	dds_header.pix_fmt.b_bitmask = read_u32le(buffer + 100);
-	dds_header.pix_fmt.a_bitmask = read_u32le(buffer + 104);
-	dds_header.caps = read_u32le(buffer + 108);
-	dds_header.caps2 = read_u32le(buffer + 112);
-	
-	return false;
-}
-
-bool GetDdsData(std::ifstream &in_stream, std::vector<char> &dds_data, const DdsFileHeader &dds_header)
-{
-	unsigned int buffer_pos = 0;
-	unsigned int total_size = 0;
-	unsigned int level_size = dds_header.pitch;
-
-	// Calculate total size of image data assuming each level is 1/4 the size of the previous one.
-	for (unsigned int i = 0; i < dds_header.levels; ++i)
-	{
-		total_size += level_size;
-		level_size /= 4;
-	}
-
-	// Prepare the vector to receive the image data.
-	// An image in a TEX file differs from a DDS image in that each level is preceded by its size.
-	// In a DDS image, only the number of levels and the size of the first level are known.
-	dds_data.resize(total_size + (dds_header.levels * 4));
-
-	// In a compressed (DXTx/BCx) DDS file, the pitch indicates the size of the first level.
-	level_size = dds_header.pitch;
-	
-	for (unsigned int i = 0; i < dds_header.levels; ++i)
-	{
-		write_u32le(dds_data.data() + buffer_pos, level_size);
-		buffer_pos += 4;
-
-		in_stream.read(dds_data.data() + buffer_pos, level_size);
-		buffer_pos += level_size;
-		
-		if (in_stream.fail())
-		{
-			std::cerr << "Error: Failed to read dds pixel data" << std::endl;
-			return true;
-		}
-		
-		level_size /= 4;
-	}
-
-	return false;
-}
-
-bool WriteImageHeader(std::ofstream &out_stream, TexImageHeader &image_header)
-{
-	char buffer[32];
-
-	write_u32le(buffer, image_header.checksum);
-	write_u32le(buffer + 4, image_header.width);
-	write_u32le(buffer + 8, image_header.height);
-	write_u32le(buffer + 12, image_header.levels);
-	write_u32le(buffer + 16, 32); // Don't know what these are. Often 32.
-	write_u32le(buffer + 20, 32);
-	write_u32le(buffer + 24, image_header.dxt);
-	write_u32le(buffer + 28, 0); // Don't know what this is. Usually 0.
-
-	out_stream.write(buffer, 32);
-
-	if (out_stream.fail())
-	{
-		std::cerr << "Error: Failed to write image file header" << std::endl;
-		return true;
-	}
-
-	return false;
-}
-
 bool ReadFiles(std::filesystem::path &out_path, FileList &file_list, ChecksumList &checksum_list, OptionStruct &options)
 {
-	std::ofstream out_stream;
+	FileSink out_file;
+	std::ostream *out_stream = &out_file.Stream();
 	std::vector<char> dds_data;
 
 	if ((checksum_list.size() != 0) && (checksum_list.size() != file_list.size()))
@@ -454,105 +374,109 @@ bool ReadFiles(std::filesystem::path &out_path, FileList &file_list, ChecksumLis
 
 	if (options.write)
 	{
-		if (std::filesystem::exists(out_path) && !options.overwrite)
+		StatsTimer timer(StatsPhase::Filesystem);
+
+		if (!IsStdStream(out_path) && std::filesystem::exists(out_path) && !options.overwrite)
 		{
 			std::cerr << "Error: File \"" << out_path.string() << "\" already exists and overwrite not enabled" << std::endl;
 			return true;
 		}
 		
-		out_stream.open(out_path, std::ios::binary);
-
-		if (out_stream.fail())
+		if (out_file.Create(out_path))
 		{
 			std::cerr << "Error: Failed to open output file \"" << out_path.string() << "\"" << std::endl;
 			return true;
 		}
 
-		if (WriteTexHeader(out_stream, file_list.size())) return true;
+		out_stream = &out_file.Stream();
+
+		if (WriteTexHeader(*out_stream, file_list.size())) return true;
+
+		StatsAddWritten(8);
 	}
 
 	for (unsigned int i = 0; i < file_list.size(); ++i)
 	{
-		std::ifstream in_stream(file_list[i], std::ios::binary);
+		FileSource in_file;
+		std::istream *in_stream;
 		DdsFileHeader dds_header;
 		TexImageHeader image_header;
+		bool failed;
 
-		if (in_stream.fail())
 		{
-			std::cerr << "Error: Failed to open dds file \"" << file_list[i].string() << "\"" << std::endl;
-			return true;
+			StatsTimer timer(StatsPhase::Filesystem);
+			failed = in_file.Open(file_list[i]);
+			in_stream = &in_file.Stream();
 		}
 
-		if (ReadDdsHeader(in_stream, dds_header)) return true;
-
-		if (!options.quiet)
+		if (failed || in_stream->fail())
 		{
-			std::cout << file_list[i].string() << std::endl;
-			std::cout << "width: " << dds_header.width << std::endl;
-			std::cout << "height: " << dds_header.height << std::endl;
-			std::cout << "dxt: " << dds_header.pix_fmt.fourcc[3] << std::endl;
-			std::cout << "mipmap levels: " << dds_header.levels << std::endl << std::endl;
+			std::cerr << "Error: Failed to open dds file \"" << file_list[i].string() << "\"" << std::endl;
+			return true;
 		}
 
-		if (!(dds_header.flags & 0xa1007))
 		{
-			std::cerr << "Error: DDS file flags incorrect" << std::endl;
-			return true;
+			StatsTimer timer(StatsPhase::Parse);
+
+			if (ReadDdsHeader(*in_stream, dds_header)) return true;
+
+			StatsAddRead(128);
 		}
 
-		if (!(dds_header.flags & 0x4))
 		{
-			std::cerr << "Error: DDS file pixel format flags incorrect" << std::endl;
-			return true;
+			ReportRecord record("dds");
+
+			record.Field("path", file_list[i].string()).Field("width", dds_header.width).Field("height", dds_header.height);
+			record.Field("dxt", std::string(1, dds_header.pix_fmt.fourcc[3])).Field("levels", dds_header.levels);
+			record.Text() << file_list[i].string() << "\n";
+			record.Text() << "width: " << dds_header.width << "\n";
+			record.Text() << "height: " << dds_header.height << "\n";
+			record.Text() << "dxt: " << dds_header.pix_fmt.fourcc[3] << "\n";
+			record.Text() << "mipmap levels: " << dds_header.levels << "\n";
 		}
 
+		if (CheckDdsHeader(dds_header)) return true;
+
 		if (options.write)
 		{
-			if (GetDdsData(in_stream, dds_data, dds_header)) return true;
+			{
+				StatsTimer timer(StatsPhase::Read);
 
-			// If we were provided with a file to copy checksums from, use one of those. Otherwise, just use 0.
-			image_header.checksum = checksum_list.size() ? checksum_list[i] : 0; 
-			image_header.width = dds_header.width;
-			image_header.height = dds_header.height;
-			image_header.levels = dds_header.levels;
+				if (GetDdsData(*in_stream, dds_data, dds_header)) return true;
 
-			// Copy over the DXT compression scheme used, or error out.
-			switch (dds_header.pix_fmt.fourcc[3])
-			{
-				case '1':
-					image_header.dxt = 1;
-					break;
-
-				case '2':
-					image_header.dxt = 2;
-					break;
-					
-				case '3':
-					image_header.dxt = 3;
-					break;
-
-				case '4':
-					image_header.dxt = 4;
-					break;
-
-				case '5':
-					image_header.dxt = 5;
-					break;
-			
-				default:
-					std::cerr << "Error: DDS file unsupported fourcc \"" << dds_header.pix_fmt.fourcc << "\"" << std::endl;
-					return true;
+				// dds_data has the tex level sizes interleaved with the image data.
+				StatsAddRead(dds_data.size() - 4 * dds_header.levels);
 			}
 
-			if (WriteImageHeader(out_stream, image_header)) return true;
+			// If we were provided with a file to copy checksums from, use one of those. Otherwise, just use 0.
+			if (BuildImageHeader(dds_header, checksum_list.size() ? checksum_list[i] : 0, image_header)) return true;
+
+			StatsTimer timer(StatsPhase::Write);
 
-			out_stream.write(dds_data.data(), dds_data.size());
+			if (WriteImageHeader(*out_stream, image_header)) return true;
+
+			out_stream->write(dds_data.data(), dds_data.size());
 			
-			if (out_stream.fail())
+			if (out_stream->fail())
 			{
 				std::cerr << "Error: Failed to write image file data" << std::endl;
 				return true;
 			}
+
+			StatsAddWritten(32 + dds_data.size());
+		}
+
+		StatsAddEntries(1);
+	}
+
+	if (options.write)
+	{
+		StatsTimer timer(StatsPhase::Filesystem);
+
+		if (out_file.Close())
+		{
+			std::cerr << "Error: Failed to write output file \"" << out_path.string() << "\"" << std::endl;
+			return true;
 		}
 	}
 
@@ -0,0 +1,610 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <random>
+#include "../common/pre_file.hpp"
+#include "../common/crc.hpp"
+#include "../common/lzss.hpp"
+#include "../common/generate.hpp"
+#include "../common/file_io.hpp"
+
+enum class EntryProfile
+{
+    Text,
+    Sparse,
+    Noise,
+    Tex,
+    Mixed
+};
+
+struct
+{
+    std::filesystem::path out_dir;
+    std::string name = "corpus";
+    std::string extension = ".pre";
+    unsigned int seed = 1;
+    unsigned int num_archives = 1;
+    unsigned int num_entries = 100;
+    unsigned long long min_size = 1024;
+    unsigned long long max_size = 65536;
+    bool log_sizes = true;
+    EntryProfile profile = EntryProfile::Mixed;
+    bool compress = true;
+    unsigned int num_tex = 0;
+    TexSettings tex_settings;
+    bool loose = false;
+    bool overwrite = false;
+    bool quiet = false;
+    bool printhelp = false;
+    FileIoBackend file_io = FileIoBackend::Stream;
+} options;
+
+void PrintHelp();
+bool ReadArgs(int argc, char **argv);
+bool ReadNumber(const char *str, unsigned long long &out_number);
+unsigned long long RandomSize(std::mt19937 &rng);
+bool CheckOutPath(const std::filesystem::path &path);
+bool WriteArchive(std::mt19937 &rng, unsigned int index);
+bool WriteTexFile(std::mt19937 &rng, unsigned int index);
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Error: No arguments" << std::endl;
+        std::cerr << "Generation failed." << std::endl;
+        PrintHelp();
+        return -1;
+    }
+
+    if (ReadArgs(argc, argv))
+    {
+        std::cerr << "Generation failed." << std::endl;
+        return -1;
+    }
+
+    if (options.printhelp)
+    {
+        PrintHelp();
+        return 0;
+    }
+
+    SetFileIoBackend(options.file_io);
+
+    if (!options.out_dir.empty())
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(options.out_dir, ec);
+
+        if (ec)
+        {
+            std::cerr << "Error: Failed to create directory \"" << options.out_dir.string() << "\"" << std::endl;
+            std::cerr << "Generation failed." << std::endl;
+            return -1;
+        }
+    }
+
+    // Archives and tex files get their own generators so that changing the number of one doesn't change the
+    // contents of the other.
+    std::mt19937 archive_rng(options.seed);
+    std::mt19937 tex_rng(options.seed ^ 0x5eed7e70);
+
+    for (unsigned int i = 0; i < options.num_archives; ++i)
+    {
+        if (WriteArchive(archive_rng, i))
+        {
+            std::cerr << "Generation failed." << std::endl;
+            return -1;
+        }
+    }
+
+    for (unsigned int i = 0; i < options.num_tex; ++i)
+    {
+        if (WriteTexFile(tex_rng, i))
+        {
+            std::cerr << "Generation failed." << std::endl;
+            return -1;
+        }
+    }
+
+    if (!options.quiet)
+    {
+        std::cout << "Generation successful." << std::endl;
+    }
+
+    return 0;
+}
+
+void PrintHelp()
+{
+    std::cout << "Usage: ug2-gen-corpus [OPTION]..." << std::endl << std::endl;
+    std::cout << "Generate pre/prx and tex.xbx files filled with synthetic data for benchmarking and testing." << std::endl << std::endl;
+    std::cout << "Examples:" << std::endl << std::endl;
+    std::cout << "        ug2-gen-corpus -o corpus -a 4 -e 1000 -z 1024 1048576" << std::endl << std::endl;
+    std::cout << "        Write corpus/corpus.0.pre to corpus/corpus.3.pre, each with 1000 compressed subfiles" << std::endl;
+    std::cout << "        between 1KiB and 1MiB." << std::endl << std::endl;
+    std::cout << "        ug2-gen-corpus -o textures -a 0 -t 8 -i 16 -x 15 -m 4" << std::endl << std::endl;
+    std::cout << "        Write 8 tex.xbx files with 16 DXT1 or DXT5 images each, with up to 4 mipmap levels." << std::endl << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "    -h                          Print this help text" << std::endl;
+    std::cout << "    -o DIRECTORY                Write files in DIRECTORY instead of current directory" << std::endl;
+    std::cout << "    -n NAME                     Name files NAME.[number].pre instead of corpus.[number].pre" << std::endl;
+    std::cout << "    -s SEED                     Seed for the generated data. Default 1" << std::endl;
+    std::cout << "    -a COUNT                    Number of pre files. Default 1" << std::endl;
+    std::cout << "    -e COUNT                    Number of subfiles in each pre file. Default 100" << std::endl;
+    std::cout << "    -z MIN MAX                  Subfile size range in bytes. Default 1024 65536" << std::endl;
+    std::cout << "    -u                          Pick subfile sizes uniformly instead of favoring small ones" << std::endl;
+    std::cout << "    -p PROFILE                  Subfile contents: text, sparse, noise, tex or mixed. Default mixed" << std::endl;
+    std::cout << "    -r                          Don't compress subfiles" << std::endl;
+    std::cout << "    -X                          Use the .prx extension instead of .pre" << std::endl;
+    std::cout << "    -t COUNT                    Number of separate tex.xbx files. Default 0" << std::endl;
+    std::cout << "    -i COUNT                    Images in each tex file. Default 4" << std::endl;
+    std::cout << "    -g SIZE                     Largest image width or height. Default 256" << std::endl;
+    std::cout << "    -x TYPES                    DXT versions to choose from, as digits. Default 15" << std::endl;
+    std::cout << "    -m LEVELS                   Most mipmap levels in an image. Default 16" << std::endl;
+    std::cout << "    -l                          Also write the subfiles of each pre file and a prespec for ug2-pre-pack" << std::endl;
+    std::cout << "    -w                          Overwrite existing files" << std::endl;
+    std::cout << "    -q                          Suppress some output. Does not include errors" << std::endl;
+    std::cout << "    --file-io BACKEND           Write files with stream, the default, mmap, pread or memory" << std::endl;
+}
+
+bool ReadArgs(int argc, char **argv)
+{
+    std::string arg;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        arg = argv[i];
+
+        if (arg == "--file-io")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: Wrong number of arguments after --file-io" << std::endl;
+                return true;
+            }
+
+            ++i;
+
+            if (ParseFileIoBackend(argv[i], options.file_io))
+            {
+                std::cerr << "Error: Unknown file I/O backend \"" << argv[i] << "\"" << std::endl;
+                return true;
+            }
+        }
+        else if ((arg[0] == '-') && (arg.size() > 1))
+        {
+            std::string switches = arg.substr(1, arg.size() - 1);
+            bool exclusive_sw = false;
+
+            for (char c : switches)
+            {
+                if (c == 'h')
+                {
+                    options.printhelp = true;
+                }
+                else if (c == 'u')
+                {
+                    options.log_sizes = false;
+                }
+                else if (c == 'r')
+                {
+                    options.compress = false;
+                }
+                else if (c == 'X')
+                {
+                    options.extension = ".prx";
+                }
+                else if (c == 'l')
+                {
+                    options.loose = true;
+                }
+                else if (c == 'w')
+                {
+                    options.overwrite = true;
+                }
+                else if (c == 'q')
+                {
+                    options.quiet = true;
+                }
+                else if (c == 'z')
+                {
+                    if (exclusive_sw)
+                    {
+                        std::cerr << "Error: Mutually exclusive switches combined" << std::endl;
+                        return true;
+                    }
+
+                    exclusive_sw = true;
+
+                    if (i + 2 >= argc)
+                    {
+                        std::cerr << "Error: Wrong number of arguments after -z" << std::endl;
+                        return true;
+                    }
+
+                    if (ReadNumber(argv[i + 1], options.min_size) || ReadNumber(argv[i + 2], options.max_size)) return true;
+
+                    if (options.min_size > options.max_size)
+                    {
+                        std::cerr << "Error: Minimum size is larger than maximum size" << std::endl;
+                        return true;
+                    }
+
+                    i += 2;
+                }
+                else if (c == 'o' || c == 'n' || c == 's' || c == 'a' || c == 'e' || c == 'p' || c == 't' || c == 'i' || c == 'g' || c == 'x' || c == 'm')
+                {
+                    if (exclusive_sw)
+                    {
+                        std::cerr << "Error: Mutually exclusive switches combined" << std::endl;
+                        return true;
+                    }
+
+                    exclusive_sw = true;
+
+                    if (i + 1 >= argc)
+                    {
+                        std::cerr << "Error: Wrong number of arguments after -" << c << std::endl;
+                        return true;
+                    }
+
+                    ++i;
+                    std::string value = argv[i];
+                    unsigned long long number = 0;
+
+                    if (c == 'o')
+                    {
+                        options.out_dir = value;
+                    }
+                    else if (c == 'n')
+                    {
+                        options.name = value;
+                    }
+                    else if (c == 'p')
+                    {
+                        if (value == "text") options.profile = EntryProfile::Text;
+                        else if (value == "sparse") options.profile = EntryProfile::Sparse;
+                        else if (value == "noise") options.profile = EntryProfile::Noise;
+                        else if (value == "tex") options.profile = EntryProfile::Tex;
+                        else if (value == "mixed") options.profile = EntryProfile::Mixed;
+                        else
+                        {
+                            std::cerr << "Error: Unknown profile \"" << value << "\"" << std::endl;
+                            return true;
+                        }
+                    }
+                    else if (c == 'x')
+                    {
+                        options.tex_settings.dxt_types.clear();
+
+                        for (char d : value)
+                        {
+                            if (d < '1' || d > '5')
+                            {
+                                std::cerr << "Error: Invalid dxt version '" << d << "'" << std::endl;
+                                return true;
+                            }
+
+                            options.tex_settings.dxt_types.push_back(d - '0');
+                        }
+
+                        if (options.tex_settings.dxt_types.empty())
+                        {
+                            std::cerr << "Error: No dxt versions after -x" << std::endl;
+                            return true;
+                        }
+                    }
+                    else
+                    {
+                        if (ReadNumber(value.c_str(), number)) return true;
+
+                        if (number > 0xffffffff)
+                        {
+                            std::cerr << "Error: \"" << value << "\" is too large" << std::endl;
+                            return true;
+                        }
+
+                        if (c == 's') options.seed = number;
+                        else if (c == 'a') options.num_archives = number;
+                        else if (c == 'e') options.num_entries = number;
+                        else if (c == 't') options.num_tex = number;
+                        else if (c == 'i') options.tex_settings.num_images = number;
+                        else if (c == 'g') options.tex_settings.max_dimension = number;
+                        else if (c == 'm') options.tex_settings.max_levels = number;
+                    }
+                }
+            }
+        }
+        else
+        {
+            std::cerr << "Error: Unexpected argument \"" << arg << "\"" << std::endl;
+            return true;
+        }
+    }
+
+    if (options.tex_settings.max_dimension < 16)
+    {
+        std::cerr << "Error: Images can't be smaller than 16x16" << std::endl;
+        return true;
+    }
+
+    if (options.tex_settings.max_levels < 1)
+    {
+        std::cerr << "Error: Images need at least 1 mipmap level" << std::endl;
+        return true;
+    }
+
+    return false;
+}
+
+bool ReadNumber(const char *str, unsigned long long &out_number)
+{
+    char *end;
+
+    out_number = std::strtoull(str, &end, 10);
+
+    if (*str == 0 || *end != 0 || *str == '-')
+    {
+        std::cerr << "Error: \"" << str << "\" isn't a number" << std::endl;
+        return true;
+    }
+
+    return false;
+}
+
+unsigned long long RandomNumber(std::mt19937 &rng, unsigned long long low, unsigned long long high)
+{
+    unsigned long long value = (static_cast<unsigned long long>(rng()) << 32) | rng();
+    unsigned long long range = high - low + 1;
+
+    return range ? low + value % range : value;
+}
+
+unsigned long long RandomSize(std::mt19937 &rng)
+{
+    if (!options.log_sizes)
+    {
+        return RandomNumber(rng, options.min_size, options.max_size);
+    }
+
+    // Pick a power of 2 first so that small and large sizes are equally likely, like files in a real archive.
+    unsigned int low_bits = 0;
+    unsigned int high_bits = 0;
+
+    while (low_bits < 64 && (options.min_size >> low_bits)) ++low_bits;
+    while (high_bits < 64 && (options.max_size >> high_bits)) ++high_bits;
+
+    unsigned int bits = RandomNumber(rng, low_bits, high_bits);
+    unsigned long long low = (bits > 0) ? (1ull << (bits - 1)) : 0;
+    unsigned long long high = (bits < 64) ? (1ull << bits) - 1 : ~0ull;
+
+    if (low < options.min_size) low = options.min_size;
+    if (high > options.max_size) high = options.max_size;
+
+    return RandomNumber(rng, low, high);
+}
+
+bool CheckOutPath(const std::filesystem::path &path)
+{
+    if (!options.overwrite && std::filesystem::exists(path))
+    {
+        std::cerr << "Error: file \"" << path.string() << "\" already exists and overwrite not enabled" << std::endl;
+        return true;
+    }
+
+    return false;
+}
+
+bool WriteArchive(std::mt19937 &rng, unsigned int index)
+{
+    const EntryProfile profiles[] = {EntryProfile::Text, EntryProfile::Sparse, EntryProfile::Noise, EntryProfile::Tex};
+    const char *extensions[] = {".qb", ".col.xbx", ".dat", ".tex.xbx"};
+    const char padding[4] = {0, 0, 0, 0};
+    std::string stem = options.name + "." + std::to_string(index);
+    std::filesystem::path outpath = options.out_dir / (stem + options.extension);
+    std::filesystem::path loose_dir = options.out_dir / stem;
+    FileSink outfile;
+    std::ofstream prespecstream;
+    std::vector<char> data;
+    std::vector<char> deflated;
+    unsigned long long presize = 0;
+    unsigned long long inflated_total = 0;
+    uint64_t sizeout = 0;
+    PreHeader header;
+
+    if (CheckOutPath(outpath)) return true;
+
+    if (outfile.Create(outpath))
+    {
+        std::cerr << "Error: Failed to create pre file \"" << outpath.string() << "\"" << std::endl;
+        return true;
+    }
+
+    std::ostream &outstream = outfile.Stream();
+
+    if (options.loose)
+    {
+        std::filesystem::path prespecpath = options.out_dir / (stem + ".prespec");
+        std::error_code ec;
+
+        if (CheckOutPath(prespecpath)) return true;
+
+        std::filesystem::create_directories(loose_dir, ec);
+        prespecstream.open(prespecpath);
+
+        if (ec || prespecstream.fail())
+        {
+            std::cerr << "Error: Failed to create prespec file \"" << prespecpath.string() << "\"" << std::endl;
+            return true;
+        }
+    }
+
+    if (WritePreHeader(outstream, PreHeader(), sizeout))
+    {
+        std::cerr << "Error: Failed to write pre file header" << std::endl;
+        return true;
+    }
+
+    presize = sizeout;
+
+    for (unsigned int i = 0; i < options.num_entries; ++i)
+    {
+        SubFileHeader subheader;
+        EntryProfile profile = (options.profile == EntryProfile::Mixed) ? profiles[i % 4] : options.profile;
+        std::string filename = stem + "_" + std::to_string(i) + extensions[static_cast<int>(profile)];
+        std::string internal_path = "generated\\" + stem + "\\" + filename;
+        const std::vector<char> *payload = &data;
+
+        switch (profile)
+        {
+            case EntryProfile::Text: GenerateData(rng, DataProfile::Text, RandomSize(rng), data); break;
+            case EntryProfile::Sparse: GenerateData(rng, DataProfile::Sparse, RandomSize(rng), data); break;
+            case EntryProfile::Noise: GenerateData(rng, DataProfile::Noise, RandomSize(rng), data); break;
+            default: GenerateTex(rng, options.tex_settings, data); break;
+        }
+
+        if (data.size() > 0xffffffff)
+        {
+            std::cerr << "Error: Subfiles can't be larger than 4GiB" << std::endl;
+            return true;
+        }
+
+        subheader.inflatedSize = data.size();
+        subheader.deflatedSize = 0;
+        subheader.pathCRC = StringCRC(internal_path);
+        subheader.path.assign(internal_path.begin(), internal_path.end());
+        subheader.path.resize(subheader.path.size() + 4 - (subheader.path.size() % 4), 0);
+        subheader.pathSize = subheader.path.size();
+
+        if (options.compress)
+        {
+            LzssDeflate(data.data(), data.size(), deflated);
+
+            if (deflated.size() < data.size())
+            {
+                subheader.deflatedSize = deflated.size();
+                payload = &deflated;
+            }
+        }
+
+        unsigned int pad = (payload->size() % 4) ? (4 - (payload->size() % 4)) : 0;
+
+        presize += 16 + subheader.pathSize + payload->size() + pad;
+        inflated_total += data.size();
+
+        if (presize > 0xffffffff)
+        {
+            std::cerr << "Error: pre files can't be larger than 4GiB, use fewer or smaller subfiles" << std::endl;
+            return true;
+        }
+
+        if (WriteSubFileHeader(outstream, subheader, sizeout))
+        {
+            std::cerr << "Error: Failed to write sub file header" << std::endl;
+            return true;
+        }
+
+        outstream.write(payload->data(), payload->size());
+        outstream.write(padding, pad);
+
+        if (outstream.fail())
+        {
+            std::cerr << "Error: Failed to write sub file" << std::endl;
+            return true;
+        }
+
+        if (options.loose)
+        {
+            std::filesystem::path filepath = std::filesystem::absolute(loose_dir / filename);
+
+            if (CheckOutPath(filepath)) return true;
+
+            FileSink file;
+            bool failed = file.Create(filepath, data.size());
+
+            file.Stream().write(data.data(), data.size());
+            failed = file.Close() || failed;
+            prespecstream << filepath.string() << "\n" << internal_path << "\n\n";
+
+            if (failed || prespecstream.fail())
+            {
+                std::cerr << "Error: Failed to write \"" << filepath.string() << "\"" << std::endl;
+                return true;
+            }
+        }
+    }
+
+    header.size = presize;
+    header.numFiles = options.num_entries;
+    outstream.seekp(0);
+
+    if (WritePreHeader(outstream, header, sizeout))
+    {
+        std::cerr << "Error: Failed to write pre file header" << std::endl;
+        return true;
+    }
+
+    if (outfile.Close())
+    {
+        std::cerr << "Error: Failed to write pre file \"" << outpath.string() << "\"" << std::endl;
+        return true;
+    }
+
+    if (!options.quiet)
+    {
+        std::cout << outpath.string() << ": " << header.numFiles << " files, " << inflated_total << " bytes inflated, " << header.size << " bytes" << std::endl;
+    }
+
+    return false;
+}
+
+bool WriteTexFile(std::mt19937 &rng, unsigned int index)
+{
+    std::filesystem::path outpath = options.out_dir / (options.name + "." + std::to_string(index) + ".tex.xbx");
+    std::vector<char> data;
+
+    if (CheckOutPath(outpath)) return true;
+
+    GenerateTex(rng, options.tex_settings, data);
+
+    FileSink outfile;
+    bool failed = outfile.Create(outpath, data.size());
+
+    outfile.Stream().write(data.data(), data.size());
+
+    if (outfile.Close() || failed)
+    {
+        std::cerr << "Error: Failed to write tex file \"" << outpath.string() << "\"" << std::endl;
+        return true;
+    }
+
+    if (!options.quiet)
+    {
+        std::cout << outpath.string() << ": " << options.tex_settings.num_images << " images, " << data.size() << " bytes" << std::endl;
+    }
+
+    return false;
+}
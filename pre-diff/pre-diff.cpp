@@ -0,0 +1,504 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <iostream>
+#include "../common/pre_file.hpp"
+#include "../common/lzss.hpp"
+#include "../common/file_io.hpp"
+#include "../common/report.hpp"
+#include "../common/stats.hpp"
+
+// A subfile of one of the archives, pointing into its loaded file.
+struct DiffEntry
+{
+    SubFileHeader subheader;
+    std::string path;
+    const char *payload;
+    uint64_t payloadSize;
+};
+
+enum class DiffResult
+{
+    Unchanged,
+    Added,
+    Removed,
+    Resized,        // Different inflated size
+    Changed,        // Same size, different contents
+    Undecided       // Stored differently, needs to be inflated to tell
+};
+
+struct DiffPair
+{
+    const DiffEntry *oldEntry;
+    const DiffEntry *newEntry;
+    DiffResult result;
+};
+
+struct
+{
+    std::filesystem::path oldpath;
+    std::filesystem::path newpath;
+    unsigned int threads = 1;
+    bool quiet = false;
+    bool json = false;
+    bool printhelp = false;
+    bool stats = false;
+    FileIoBackend fileio = FileIoBackend::Mmap;
+    std::filesystem::path statsjson;
+} globalValues;
+
+void PrintHelp();
+bool ReadArgs(int argc, char **argv);
+bool ReadEntries(const std::filesystem::path &path, FileSource &infile, std::vector<DiffEntry> &entries);
+std::vector<DiffPair> PairEntries(const std::vector<DiffEntry> &oldEntries, const std::vector<DiffEntry> &newEntries);
+bool CompareContents(std::vector<DiffPair> &pairs);
+bool InflateEntry(const DiffEntry &entry, std::vector<char> &buffer, const char *&data);
+void PrintDiff(const std::vector<DiffPair> &pairs);
+
+int main(int argc, char **argv)
+{
+    if (!(argc > 1))
+    {
+        std::cerr << "Error: No arguments" << std::endl;
+        std::cerr << "Diff failed." << std::endl;
+        PrintHelp();
+        return -1;
+    }
+
+    if (ReadArgs(argc, argv))
+    {
+        std::cerr << "Diff failed." << std::endl;
+        return -1;
+    }
+
+    if (globalValues.printhelp)
+    {
+        PrintHelp();
+        return 0;
+    }
+
+    ReportSetMode(globalValues.json ? ReportMode::JsonLines : (globalValues.quiet ? ReportMode::Quiet : ReportMode::Plain));
+
+    if (globalValues.stats || !globalValues.statsjson.empty()) StatsEnable();
+
+    SetFileIoBackend(globalValues.fileio);
+
+    if (globalValues.oldpath.empty() || globalValues.newpath.empty())
+    {
+        std::cerr << "Error: Two pre files are needed" << std::endl;
+        std::cerr << "Diff failed." << std::endl;
+        return -1;
+    }
+
+    FileSource oldfile;
+    FileSource newfile;
+    std::vector<DiffEntry> oldEntries;
+    std::vector<DiffEntry> newEntries;
+
+    if (ReadEntries(globalValues.oldpath, oldfile, oldEntries) || ReadEntries(globalValues.newpath, newfile, newEntries))
+    {
+        std::cerr << "Diff failed." << std::endl;
+        return -1;
+    }
+
+    std::vector<DiffPair> pairs = PairEntries(oldEntries, newEntries);
+
+    if (CompareContents(pairs))
+    {
+        std::cerr << "Diff failed." << std::endl;
+        return -1;
+    }
+
+    PrintDiff(pairs);
+
+    ReportFlush();
+
+    if (globalValues.stats) StatsPrint(std::cout);
+
+    if (!globalValues.statsjson.empty() && StatsWriteJson(globalValues.statsjson))
+    {
+        std::cerr << "Diff failed." << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+void PrintHelp()
+{
+    std::cout << "Usage: ug2-pre-diff [OLD FILE] [NEW FILE] [OPTION]..." << std::endl << std::endl;
+    std::cout << "List the files added, removed and modified between two pre/prx files." << std::endl << std::endl;
+    std::cout << "Examples:" << std::endl << std::endl;
+    std::cout << "        ug2-pre-diff old.pre new.pre -j 4" << std::endl << std::endl;
+    std::cout << "        Compare old.pre to new.pre, inflating files on 4 threads where their compressed data differs." << std::endl << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "    -h                          Print this help text" << std::endl;
+    std::cout << "    -j THREADS                  Inflate files on THREADS threads. 0 uses one per cpu core" << std::endl;
+    std::cout << "    -q                          Only print the totals. Does not include errors" << std::endl;
+    std::cout << "    --file-io BACKEND           Read files with mmap, the default, stream, pread or memory" << std::endl;
+    std::cout << "    --json                      Print the differences as one JSON object per line" << std::endl;
+    std::cout << "    --stats                     Print time spent in each phase, throughput and peak memory" << std::endl;
+    std::cout << "    --stats-json FILE           Write the same report as JSON to FILE, or stdout if FILE is -" << std::endl;
+}
+
+bool ReadArgs(int argc, char **argv)
+{
+    std::string arg;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        arg = argv[i];
+
+        if (arg == "--json")
+        {
+            globalValues.json = true;
+        }
+        else if (arg == "--stats")
+        {
+            globalValues.stats = true;
+        }
+        else if (arg == "--stats-json")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: Wrong number of arguments after --stats-json" << std::endl;
+                return true;
+            }
+
+            ++i;
+            globalValues.statsjson = argv[i];
+        }
+        else if (arg == "--file-io")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: Wrong number of arguments after --file-io" << std::endl;
+                return true;
+            }
+
+            ++i;
+
+            if (ParseFileIoBackend(argv[i], globalValues.fileio))
+            {
+                std::cerr << "Error: Unknown file I/O backend \"" << argv[i] << "\"" << std::endl;
+                return true;
+            }
+        }
+        else if ((arg[0] == '-') && (arg.size() > 1))
+        {
+            std::string switches = arg.substr(1, arg.size() - 1);
+
+            for (char c : switches)
+            {
+                if (c == 'j')
+                {
+                    if (i + 1 >= argc)
+                    {
+                        std::cerr << "Error: Wrong number of arguments after -j" << std::endl;
+                        return true;
+                    }
+
+                    ++i;
+
+                    try
+                    {
+                        globalValues.threads = std::stoul(argv[i]);
+                    }
+                    catch (const std::exception &)
+                    {
+                        std::cerr << "Error: Invalid thread count \"" << argv[i] << "\"" << std::endl;
+                        return true;
+                    }
+                }
+                else if (c == 'q')
+                {
+                    globalValues.quiet = true;
+                }
+                else if (c == 'h')
+                {
+                    globalValues.printhelp = true;
+                }
+            }
+        }
+        else if (globalValues.oldpath.empty())
+        {
+            globalValues.oldpath = arg;
+        }
+        else if (globalValues.newpath.empty())
+        {
+            globalValues.newpath = arg;
+        }
+        else
+        {
+            std::cerr << "Error: Too many input files" << std::endl;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Load a whole pre file and list its subfiles. Nothing is copied; entries point into the loaded file, which is
+// mapped by default.
+bool ReadEntries(const std::filesystem::path &path, FileSource &infile, std::vector<DiffEntry> &entries)
+{
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+
+        if (infile.Open(path) || infile.Load())
+        {
+            std::cerr << "Error: Failed to open \"" << path.string() << "\"" << std::endl;
+            return true;
+        }
+    }
+
+    StatsTimer timer(StatsPhase::Parse);
+    std::vector<PreIndexEntry> index;
+
+    if (ReadPreIndex(infile.Data(), infile.Size(), path.string(), index)) return true;
+
+    StatsAddRead(12);
+
+    for (PreIndexEntry &found : index)
+    {
+        DiffEntry entry;
+
+        StatsAddRead(16 + found.subheader.pathSize);
+
+        entry.payload = infile.Data() + found.offset;
+        entry.payloadSize = found.payloadSize;
+        entry.subheader = std::move(found.subheader);
+        entry.path = std::move(found.path);
+
+        entries.push_back(std::move(entry));
+    }
+
+    return false;
+}
+
+// Match up subfiles by path checksum and path, and settle everything that can be told apart without inflating.
+// If an archive has the same path more than once, the nth copy in one is paired with the nth in the other.
+std::vector<DiffPair> PairEntries(const std::vector<DiffEntry> &oldEntries, const std::vector<DiffEntry> &newEntries)
+{
+    std::map<std::pair<unsigned int, std::string>, std::vector<size_t>> oldIndices;
+    std::map<std::pair<unsigned int, std::string>, size_t> used;
+    std::vector<bool> paired(oldEntries.size(), false);
+    std::vector<DiffPair> pairs;
+
+    StatsTimer timer(StatsPhase::Parse);
+
+    for (size_t i = 0; i < oldEntries.size(); ++i)
+    {
+        oldIndices[{oldEntries[i].subheader.pathCRC, oldEntries[i].path}].push_back(i);
+    }
+
+    for (const DiffEntry &newEntry : newEntries)
+    {
+        std::pair<unsigned int, std::string> key(newEntry.subheader.pathCRC, newEntry.path);
+        auto found = oldIndices.find(key);
+        size_t &n = used[key];
+
+        if (found == oldIndices.end() || n >= found->second.size())
+        {
+            pairs.push_back({nullptr, &newEntry, DiffResult::Added});
+            continue;
+        }
+
+        const DiffEntry &oldEntry = oldEntries[found->second[n]];
+        DiffResult result = DiffResult::Undecided;
+
+        paired[found->second[n]] = true;
+        ++n;
+
+        if (oldEntry.subheader.inflatedSize != newEntry.subheader.inflatedSize)
+        {
+            result = DiffResult::Resized;
+        }
+        else if ((oldEntry.subheader.deflatedSize == 0) == (newEntry.subheader.deflatedSize == 0) && oldEntry.payloadSize == newEntry.payloadSize)
+        {
+            // Stored the same way, so the stored bytes decide it. Identical compressed data inflates to the
+            // same thing, and two different stored files of the same size are different.
+            bool same = std::memcmp(oldEntry.payload, newEntry.payload, newEntry.payloadSize) == 0;
+
+            StatsAddRead(2 * newEntry.payloadSize);
+
+            if (same)
+            {
+                result = DiffResult::Unchanged;
+            }
+            else if (newEntry.subheader.deflatedSize == 0)
+            {
+                result = DiffResult::Changed;
+            }
+        }
+
+        pairs.push_back({&oldEntry, &newEntry, result});
+    }
+
+    for (size_t i = 0; i < oldEntries.size(); ++i)
+    {
+        if (!paired[i]) pairs.push_back({&oldEntries[i], nullptr, DiffResult::Removed});
+    }
+
+    StatsAddEntries(pairs.size());
+
+    return pairs;
+}
+
+// Inflate and compare the pairs that are still undecided, spread over globalValues.threads threads.
+bool CompareContents(std::vector<DiffPair> &pairs)
+{
+    std::vector<DiffPair*> undecided;
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+
+    for (DiffPair &pair : pairs)
+    {
+        if (pair.result == DiffResult::Undecided) undecided.push_back(&pair);
+    }
+
+    auto worker = [&]()
+    {
+        std::vector<char> oldBuffer;
+        std::vector<char> newBuffer;
+
+        for (size_t i = next++; i < undecided.size() && !failed; i = next++)
+        {
+            DiffPair &pair = *undecided[i];
+            const char *oldData;
+            const char *newData;
+
+            if (InflateEntry(*pair.oldEntry, oldBuffer, oldData) || InflateEntry(*pair.newEntry, newBuffer, newData))
+            {
+                failed = true;
+                return;
+            }
+
+            bool same = std::memcmp(oldData, newData, pair.newEntry->subheader.inflatedSize) == 0;
+            pair.result = same ? DiffResult::Unchanged : DiffResult::Changed;
+        }
+    };
+
+    unsigned int threads = globalValues.threads ? globalValues.threads : std::thread::hardware_concurrency();
+
+    if (threads > undecided.size()) threads = undecided.size();
+
+    if (threads <= 1)
+    {
+        worker();
+    }
+    else
+    {
+        std::vector<std::thread> pool;
+
+        for (unsigned int i = 0; i < threads; ++i)
+        {
+            pool.emplace_back(worker);
+        }
+
+        for (std::thread &t : pool)
+        {
+            t.join();
+        }
+    }
+
+    return failed;
+}
+
+// Point data at the inflated contents of entry, inflating into buffer if it's compressed.
+bool InflateEntry(const DiffEntry &entry, std::vector<char> &buffer, const char *&data)
+{
+    StatsAddRead(entry.payloadSize);
+
+    if (entry.subheader.deflatedSize == 0)
+    {
+        data = entry.payload;
+        return false;
+    }
+
+    StatsTimer timer(StatsPhase::Inflate);
+
+    buffer.resize(entry.subheader.inflatedSize);
+
+    if (LzssInflate(entry.payload, entry.payloadSize, buffer.data(), buffer.size()))
+    {
+        std::cerr << "Error: Failed to inflate \"" << entry.path << "\"" << std::endl;
+        return true;
+    }
+
+    data = buffer.data();
+    return false;
+}
+
+void PrintDiff(const std::vector<DiffPair> &pairs)
+{
+    unsigned int added = 0;
+    unsigned int removed = 0;
+    unsigned int modified = 0;
+    unsigned int unchanged = 0;
+
+    for (const DiffPair &pair : pairs)
+    {
+        if (pair.result == DiffResult::Unchanged)
+        {
+            ++unchanged;
+            continue;
+        }
+
+        ReportRecord record("entry");
+
+        if (pair.result == DiffResult::Added)
+        {
+            ++added;
+            record.Field("status", "added").Field("path", pair.newEntry->path).Field("size", pair.newEntry->subheader.inflatedSize);
+            record.Text() << "added:    " << pair.newEntry->path;
+        }
+        else if (pair.result == DiffResult::Removed)
+        {
+            ++removed;
+            record.Field("status", "removed").Field("path", pair.oldEntry->path).Field("size", pair.oldEntry->subheader.inflatedSize);
+            record.Text() << "removed:  " << pair.oldEntry->path;
+        }
+        else
+        {
+            ++modified;
+            record.Field("status", "modified").Field("path", pair.newEntry->path);
+            record.Field("old_size", pair.oldEntry->subheader.inflatedSize).Field("size", pair.newEntry->subheader.inflatedSize);
+            record.Text() << "modified: " << pair.newEntry->path;
+
+            if (pair.result == DiffResult::Resized)
+            {
+                record.Text() << " (" << pair.oldEntry->subheader.inflatedSize << " -> " << pair.newEntry->subheader.inflatedSize << " bytes)";
+            }
+        }
+    }
+
+    ReportRecord record("summary", true);
+
+    record.Field("added", added).Field("removed", removed).Field("modified", modified).Field("unchanged", unchanged);
+    record.Text() << added << " added, " << removed << " removed, " << modified << " modified, " << unchanged << " unchanged.";
+}
\ No newline at end of file
@@ -0,0 +1,483 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <fstream>
+#include "../common/pre_file.hpp"
+#include "../common/file_io.hpp"
+#include "../common/std_stream.hpp"
+#include "../common/report.hpp"
+#include "../common/stats.hpp"
+
+// A subfile to be copied into the merged archive, found by scanning the headers of one of the inputs.
+struct MergeEntry
+{
+    size_t archive;
+    uint64_t offset;            // Start of the payload in the input file
+    uint64_t payloadSize;       // Stored size, not including padding
+    SubFileHeader subheader;
+    std::string path;
+};
+
+struct
+{
+    std::vector<std::filesystem::path> inpaths;
+    std::filesystem::path outpath = "out.pre";
+    bool overwrite = false;
+    bool merge = true;
+    bool failonduplicate = false;
+    bool quiet = false;
+    bool json = false;
+    bool printhelp = false;
+    bool stats = false;
+    FileIoBackend fileio = FileIoBackend::Mmap;
+    std::filesystem::path statsjson;
+} globalValues;
+
+void PrintHelp();
+bool ReadArgs(int argc, char **argv);
+bool ReadArchive(size_t archive, const FileSource &infile, std::vector<MergeEntry> &entries, std::map<std::string, size_t> &indices);
+bool WriteMerged(const std::vector<FileSource> &infiles, const std::vector<MergeEntry> &entries);
+
+int main(int argc, char **argv)
+{
+    if (!(argc > 1))
+    {
+        std::cerr << "Error: No arguments" << std::endl;
+        std::cerr << "Merging failed." << std::endl;
+        PrintHelp();
+        return -1;
+    }
+
+    if (ReadArgs(argc, argv))
+    {
+        std::cerr << "Merging failed." << std::endl;
+        return -1;
+    }
+
+    if (globalValues.printhelp)
+    {
+        PrintHelp();
+        return 0;
+    }
+
+    ReportSetMode(globalValues.json ? ReportMode::JsonLines : (globalValues.quiet ? ReportMode::Quiet : ReportMode::Plain));
+
+    if (globalValues.stats || !globalValues.statsjson.empty()) StatsEnable();
+
+    SetFileIoBackend(globalValues.fileio);
+
+    // The pre file goes to stdout, so everything else goes to stderr.
+    bool prestdout = globalValues.merge && IsStdStream(globalValues.outpath);
+
+    if (prestdout)
+    {
+        if (IsStdStream(globalValues.statsjson))
+        {
+            std::cerr << "Error: --stats-json can't write to stdout along with the pre file" << std::endl;
+            std::cerr << "Merging failed." << std::endl;
+            return -1;
+        }
+
+        ReportSetStream(std::cerr);
+    }
+
+    if (globalValues.inpaths.size() == 0)
+    {
+        std::cerr << "Error: No files to merge" << std::endl;
+        std::cerr << "Merging failed." << std::endl;
+        return -1;
+    }
+
+    // Inputs are loaded whole, since the payloads are copied out of them in a second pass. By default they're
+    // mapped rather than read, and one that comes through a pipe is read into memory.
+    std::vector<FileSource> infiles(globalValues.inpaths.size());
+    std::vector<MergeEntry> entries;
+    std::map<std::string, size_t> indices;
+
+    for (size_t i = 0; i < globalValues.inpaths.size(); ++i)
+    {
+        bool failed;
+
+        {
+            StatsTimer timer(StatsPhase::Filesystem);
+            failed = infiles[i].Open(globalValues.inpaths[i]) || infiles[i].Load();
+        }
+
+        if (failed)
+        {
+            std::cerr << "Error: Failed to open \"" << globalValues.inpaths[i].string() << "\"" << std::endl;
+            std::cerr << "Merging failed." << std::endl;
+            return -1;
+        }
+
+        if (ReadArchive(i, infiles[i], entries, indices))
+        {
+            std::cerr << "Merging failed." << std::endl;
+            return -1;
+        }
+    }
+
+    if (WriteMerged(infiles, entries))
+    {
+        std::cerr << "Merging failed." << std::endl;
+        return -1;
+    }
+
+    ReportFlush();
+
+    if (globalValues.stats) StatsPrint(prestdout ? std::cerr : std::cout);
+
+    if (!globalValues.statsjson.empty() && StatsWriteJson(globalValues.statsjson))
+    {
+        std::cerr << "Merging failed." << std::endl;
+        return -1;
+    }
+
+    ReportRecord("result").Field("success", true).Text() << "Merging successful.";
+
+    return 0;
+}
+
+void PrintHelp()
+{
+    std::cout << "Usage: ug2-pre-merge [FILE]... [OPTION]..." << std::endl << std::endl;
+    std::cout << "Combine pre/prx files into one without unpacking them." << std::endl << std::endl;
+    std::cout << "Examples:" << std::endl << std::endl;
+    std::cout << "        ug2-pre-merge a.pre b.pre -o out.pre" << std::endl << std::endl;
+    std::cout << "        Create out.pre with the files in a.pre followed by those in b.pre. Files in b.pre replace files in a.pre with the same internal path." << std::endl << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "    -h                          Print this help text" << std::endl;
+    std::cout << "    -o PATH                     Output file at PATH instead of out.pre in current directory, or stdout if PATH is -" << std::endl;
+    std::cout << "    -q                          Suppress some output. Does not include errors" << std::endl;
+    std::cout << "    -w                          Overwrite existing file" << std::endl;
+    std::cout << "    -e                          Fail if two files have the same internal path instead of keeping the last one" << std::endl;
+    std::cout << "    -n                          Don't create pre file, just list files" << std::endl;
+    std::cout << "    --file-io BACKEND           Read and write files with mmap, the default, stream, pread or memory" << std::endl;
+    std::cout << "    --json                      Print the listing and results as one JSON object per line" << std::endl;
+    std::cout << "    --stats                     Print time spent in each phase, throughput and peak memory" << std::endl;
+    std::cout << "    --stats-json FILE           Write the same report as JSON to FILE, or stdout if FILE is -" << std::endl;
+}
+
+bool ReadArgs(int argc, char **argv)
+{
+    std::string arg;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        arg = argv[i];
+
+        if (arg == "--json")
+        {
+            globalValues.json = true;
+        }
+        else if (arg == "--stats")
+        {
+            globalValues.stats = true;
+        }
+        else if (arg == "--stats-json")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: Wrong number of arguments after --stats-json" << std::endl;
+                return true;
+            }
+
+            ++i;
+            globalValues.statsjson = argv[i];
+        }
+        else if (arg == "--file-io")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: Wrong number of arguments after --file-io" << std::endl;
+                return true;
+            }
+
+            ++i;
+
+            if (ParseFileIoBackend(argv[i], globalValues.fileio))
+            {
+                std::cerr << "Error: Unknown file I/O backend \"" << argv[i] << "\"" << std::endl;
+                return true;
+            }
+        }
+        else if ((arg[0] == '-') && (arg.size() > 1))
+        {
+            std::string switches = arg.substr(1, arg.size() - 1);
+            bool exclusive_sw = false;
+
+            for (char c : switches)
+            {
+                if (c == 'o')
+                {
+                    if (exclusive_sw)
+                    {
+                        std::cerr << "Error: Mutually exclusive switches combined" << std::endl;
+                        return true;
+                    }
+
+                    exclusive_sw = true;
+                    
+                    if (i + 1 >= argc)
+                    {
+                        std::cerr << "Error: Wrong number of arguments after -o" << std::endl;
+                        return true;
+                    }
+
+                    ++i;
+                    globalValues.outpath = argv[i];
+                }
+                else if (c == 'w')
+                {
+                    globalValues.overwrite = true;
+                }
+                else if (c == 'e')
+                {
+                    globalValues.failonduplicate = true;
+                }
+                else if (c == 'n')
+                {
+                    globalValues.merge = false;
+                }
+                else if (c == 'q')
+                {
+                    globalValues.quiet = true;
+                }
+                else if (c == 'h')
+                {
+                    globalValues.printhelp = true;
+                }
+            }
+        }
+        else
+        {
+            globalValues.inpaths.push_back(arg);
+        }
+    }
+
+    return false;
+}
+
+// Add the subfiles of one input to entries, skipping over their payloads. A subfile with the same internal
+// path as an earlier one takes its place in the list, so the merged archive keeps the order of the first input
+// that had each file.
+bool ReadArchive(size_t archive, const FileSource &infile, std::vector<MergeEntry> &entries, std::map<std::string, size_t> &indices)
+{
+    const std::filesystem::path &inpath = globalValues.inpaths[archive];
+    std::vector<PreIndexEntry> index;
+
+    StatsTimer timer(StatsPhase::Parse);
+
+    if (ReadPreIndex(infile.Data(), infile.Size(), inpath.string(), index)) return true;
+
+    StatsAddRead(12);
+
+    for (PreIndexEntry &found : index)
+    {
+        MergeEntry entry;
+
+        StatsAddRead(16 + found.subheader.pathSize);
+
+        entry.archive = archive;
+        entry.offset = found.offset;
+        entry.payloadSize = found.payloadSize;
+        entry.subheader = std::move(found.subheader);
+        entry.path = std::move(found.path);
+
+        auto inserted = indices.emplace(entry.path, entries.size());
+        const std::filesystem::path *previous = nullptr;
+
+        if (!inserted.second)
+        {
+            previous = &globalValues.inpaths[entries[inserted.first->second].archive];
+
+            if (globalValues.failonduplicate)
+            {
+                std::cerr << "Error: \"" << entry.path << "\" is in both \"" << previous->string() << "\" and \"" << inpath.string() << "\"" << std::endl;
+                return true;
+            }
+        }
+
+        {
+            ReportRecord record("file");
+
+            record.Field("archive", inpath.string()).Field("internal_path", entry.path);
+            record.Field("size", entry.subheader.inflatedSize).Field("compressed_size", entry.subheader.deflatedSize);
+            record.Text() << inpath.string() << ": " << entry.path;
+
+            if (previous)
+            {
+                record.Field("replaces", previous->string());
+                record.Text() << " (replaces " << previous->string() << ")";
+            }
+        }
+
+        if (previous)
+        {
+            entries[inserted.first->second] = std::move(entry);
+        }
+        else
+        {
+            entries.push_back(std::move(entry));
+        }
+    }
+
+    return false;
+}
+
+// Write the merged archive front to back. Every size is known from the headers, so the pre header goes out
+// first and the payloads are copied across as they are, without being inflated.
+bool WriteMerged(const std::vector<FileSource> &infiles, const std::vector<MergeEntry> &entries)
+{
+    PreHeader header;
+    uint64_t totalsize = 12;
+    uint64_t presize = 0;
+    FileSink outfile;
+    std::ostream *outstream = &outfile.Stream();
+    const char zeros[4] = {};
+
+    for (const MergeEntry &entry : entries)
+    {
+        totalsize += 16 + entry.subheader.pathSize + entry.payloadSize;
+        totalsize += (entry.payloadSize % 4) ? (4 - (entry.payloadSize % 4)) : 0;
+    }
+
+    // The size field of the pre header is only 32 bits. Listing with -n still adds up past that.
+    if (globalValues.merge && totalsize > PreFieldMax)
+    {
+        std::cerr << "Error: Merged pre file would be " << totalsize << " bytes, which is too big for a pre file" << std::endl;
+        return true;
+    }
+
+    header.size = totalsize;
+    header.numFiles = entries.size();
+
+    if (globalValues.merge)
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+
+        if (!IsStdStream(globalValues.outpath) && std::filesystem::exists(globalValues.outpath))
+        {
+            if (!globalValues.overwrite)
+            {
+                std::cerr << "Error: file \"" << globalValues.outpath.string() << "\" already exists and overwrite not enabled" << std::endl;
+                return true;
+            }
+
+            // Opening the output would truncate an input that is still to be read.
+            for (const std::filesystem::path &inpath : globalValues.inpaths)
+            {
+                std::error_code ec;
+
+                if (std::filesystem::equivalent(inpath, globalValues.outpath, ec))
+                {
+                    std::cerr << "Error: Output file \"" << globalValues.outpath.string() << "\" is also an input" << std::endl;
+                    return true;
+                }
+            }
+        }
+
+        if (outfile.Create(globalValues.outpath, totalsize))
+        {
+            std::cerr << "Error: Failed to create pre file \"" << globalValues.outpath.string() << "\"" << std::endl;
+            return true;
+        }
+
+        outstream = &outfile.Stream();
+
+        if (WritePreHeader(*outstream, header, presize))
+        {
+            std::cerr << "Error: Failed to write pre file header" << std::endl;
+            return true;
+        }
+    }
+
+    for (const MergeEntry &entry : entries)
+    {
+        StatsAddEntries(1);
+
+        if (!globalValues.merge) continue;
+
+        const FileSource &infile = infiles[entry.archive];
+
+        {
+            StatsTimer timer(StatsPhase::Write);
+
+            if (WriteSubFileHeader(*outstream, entry.subheader, presize))
+            {
+                std::cerr << "Error: Failed to write sub file header" << std::endl;
+                return true;
+            }
+
+            outstream->write(infile.Data() + entry.offset, entry.payloadSize);
+
+            if (outstream->fail())
+            {
+                std::cerr << "Error: Failed to write sub file" << std::endl;
+                return true;
+            }
+
+            StatsAddRead(entry.payloadSize);
+        }
+
+        presize += entry.payloadSize;
+
+        unsigned int pad = (presize % 4) ? (4 - (presize % 4)) : 0;
+
+        outstream->write(zeros, pad);
+
+        if (outstream->fail())
+        {
+            std::cerr << "Error: Failed to pad sub file" << std::endl;
+            return true;
+        }
+
+        presize += pad;
+    }
+
+    if (globalValues.merge)
+    {
+        StatsTimer timer(StatsPhase::Write);
+
+        if (outfile.Close())
+        {
+            std::cerr << "Error: Failed to write pre file \"" << globalValues.outpath.string() << "\"" << std::endl;
+            return true;
+        }
+
+        StatsAddWritten(presize);
+    }
+
+    {
+        ReportRecord record("archive");
+
+        record.Field("path", globalValues.outpath.string()).Field("files", header.numFiles).Field("size", header.size);
+        record.Text() << globalValues.outpath.string() << "\n";
+        record.Text() << "total files: " << header.numFiles << "\n";
+        record.Text() << "total size: " << header.size;
+    }
+
+    return false;
+}
\ No newline at end of file
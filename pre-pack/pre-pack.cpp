@@ -21,12 +21,27 @@
 #include <filesystem>
 #include <string>
 #include <vector>
+#include <map>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
 #include <iostream>
 #include <fstream>
-#include "../common/pre_header.hpp"
-#include "../common/subfile_header.hpp"
+#include <sstream>
+#include "../common/pre_file.hpp"
 #include "../common/crc.hpp"
-#include "../common/write_word.hpp"
+#include "../common/mapped_file.hpp"
+#include "../common/file_io.hpp"
+#include "../common/tex_file.hpp"
+#include "../common/tar_file.hpp"
+#include "../common/std_stream.hpp"
+#include "../common/memory_stream.hpp"
+#include "../common/lzss.hpp"
+#include "../common/hash.hpp"
+#include "../common/report.hpp"
+#include "../common/stats.hpp"
+#include "../common/trace.hpp"
 
 struct FilePair
 {
@@ -43,17 +58,87 @@ struct
     std::vector<FilePair> filelist;
     bool overwrite = false;
     bool pack = true;
+    bool compress = false;
+    bool update = false;
     bool quiet = false;
+    bool json = false;
     bool printhelp = false;
+    bool stats = false;
+    unsigned int threads = 1;
+    FileIoBackend fileio = FileIoBackend::Stream;
+    std::filesystem::path statsjson;
+    std::filesystem::path tracepath;
+    std::filesystem::path tarpath;
 } globalValues;
 
+// A file on its way into the pre file with WritePreMapped().
+struct PackedFile
+{
+    SubFileHeader subheader;
+    std::vector<char> payload;  // Empty when the file is stored as it is and read straight into the pre file
+    uint64_t hash = 0;          // Of the uncompressed contents, for pointing out duplicates
+    uint64_t offset = 0;        // Of the sub file header in the pre file
+};
+
+// Internal path of the first file seen with each size and content hash, and how many bytes the files that
+// repeat one take up, for pointing out duplicates.
+struct DuplicateValues
+{
+    std::map<std::pair<uint64_t, uint64_t>, std::string> contents;
+    unsigned int files = 0;
+    uint64_t bytes = 0;
+};
+
+// A subfile of the pre file being updated with -u. Existing subfiles that aren't replaced are copied over from
+// the old pre file as they are.
+struct UpdateSlot
+{
+    const PreIndexEntry *existing = nullptr;    // Where it is in the old pre file, or null for a new file
+    bool replaced = false;
+    SubFileHeader subheader;
+    std::vector<char> payload;
+};
+
+// An input file put into the pre file with -u, reported once it's known whether the pre file gets rewritten.
+struct UpdatedFile
+{
+    std::string internal_path;
+    size_t slot;
+    bool found;                 // Replaces a file that was already there, or one added before it
+    uint64_t inflatedSize;
+    uint64_t deflatedSize;
+};
+
+// Where files come from with --tar, instead of the file list.
+struct
+{
+    FileSource file;
+    std::istream *stream = nullptr;
+} tarValues;
+
 void PrintHelp();
 bool ReadArgs(int argc, char **argv);
 bool ReadPrespec();
-bool ReadLine(std::ifstream &instream, std::string &outstr);
+bool ReadLine(std::istream &instream, std::string &outstr);
+bool ReadInputFile(const std::filesystem::path &path, std::vector<char> &buffer);
+bool BuildTexFile(const std::filesystem::path &path, std::vector<char> &buffer);
+bool OpenTarInput();
+bool NextInputFile(size_t index, std::filesystem::path &path, std::string &internal_path, std::vector<char> &buffer, bool &done);
+void SetSubFilePath(SubFileHeader &subheader, const std::string &internal_path);
+bool PlainFileSize(const FilePair &fp, uint64_t &size);
+bool PlanPreHeader(PreHeader &header);
+bool ParallelFor(size_t count, const std::function<bool(size_t)> &work);
 bool WritePre();
-bool WritePreHeader(std::ofstream &outstream, const PreHeader &header, unsigned int &sizeout);
-bool WriteSubFileHeader(std::ofstream &outstream, const SubFileHeader &subheader, unsigned int &sizeout);
+bool WritePreMapped();
+bool ReadPlainFile(const std::filesystem::path &path, char *data, uint64_t size);
+void ReportFile(const std::filesystem::path &path, const std::string &internal_path, const SubFileHeader &subheader, uint64_t hash, uint64_t storedSize, DuplicateValues &duplicates);
+void ReportArchive(const PreHeader &header, const DuplicateValues &duplicates);
+bool UpdatePre();
+uint64_t UpdateSlotSize(const UpdateSlot &slot);
+uint64_t PaddedEnd(const PreIndexEntry &entry);
+bool WriteUpdateSlot(std::ostream &outstream, const UpdateSlot &slot);
+bool WriteUpdatedInPlace(FileSource &prefile, const std::vector<UpdateSlot> &slots);
+bool RewriteUpdatedPre(FileSource &prefile, const std::vector<UpdateSlot> &slots);
 
 int main(int argc, char **argv)
 {
@@ -77,8 +162,39 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    ReportSetMode(globalValues.json ? ReportMode::JsonLines : (globalValues.quiet ? ReportMode::Quiet : ReportMode::Plain));
+
+    if (globalValues.stats || !globalValues.statsjson.empty()) StatsEnable();
+    if (!globalValues.tracepath.empty()) TraceEnable();
+
+    SetFileIoBackend(globalValues.fileio);
+
+    if (globalValues.update && IsStdStream(globalValues.outpath))
+    {
+        std::cerr << "Error: -u needs an existing pre file to update, not stdout" << std::endl;
+        std::cerr << "Packing failed." << std::endl;
+        return -1;
+    }
+
+    // The pre file goes to stdout, so everything else goes to stderr.
+    bool prestdout = globalValues.pack && !globalValues.update && IsStdStream(globalValues.outpath);
+
+    if (prestdout)
+    {
+        if (IsStdStream(globalValues.statsjson))
+        {
+            std::cerr << "Error: --stats-json can't write to stdout along with the pre file" << std::endl;
+            std::cerr << "Packing failed." << std::endl;
+            return -1;
+        }
+
+        ReportSetStream(std::cerr);
+    }
+
     if (!globalValues.prespecpath.empty())
     {
+        StatsTimer timer(StatsPhase::Parse);
+
         if (ReadPrespec())
         {
             std::cerr << "Packing failed." << std::endl;
@@ -86,24 +202,45 @@ int main(int argc, char **argv)
         }
     }
 
-    if (globalValues.filelist.size() == 0)
+    if (!globalValues.tarpath.empty())
+    {
+        if (OpenTarInput())
+        {
+            std::cerr << "Packing failed." << std::endl;
+            return -1;
+        }
+    }
+    else if (globalValues.filelist.size() == 0)
     {
         std::cerr << "Error: No files to pack" << std::endl;
         std::cerr << "Packing failed." << std::endl;
         return -1;
     }
 
-    if (WritePre())
+    if (globalValues.update ? UpdatePre() : WritePre())
     {
         std::cerr << "Packing failed." << std::endl;
         return -1;
     }
 
-    if (!globalValues.quiet)
+    ReportFlush();
+
+    if (globalValues.stats) StatsPrint(prestdout ? std::cerr : std::cout);
+
+    if (!globalValues.statsjson.empty() && StatsWriteJson(globalValues.statsjson))
+    {
+        std::cerr << "Packing failed." << std::endl;
+        return -1;
+    }
+
+    if (!globalValues.tracepath.empty() && TraceWrite(globalValues.tracepath))
     {
-        std::cout << "Packing successful." << std::endl;
+        std::cerr << "Packing failed." << std::endl;
+        return -1;
     }
 
+    ReportRecord("result").Field("success", true).Text() << "Packing successful.";
+
     return 0;
 }
 
@@ -118,11 +255,21 @@ void PrintHelp()
     std::cout << "        Manually specify files and their internal paths using the -f switch and write pre file in specific location." << std::endl << std::endl;
     std::cout << "Options:" << std::endl;
     std::cout << "    -h                          Print this help text" << std::endl;
-    std::cout << "    -o PATH                     Output file at PATH instead of out.pre in current directory" << std::endl;
+    std::cout << "    -o PATH                     Output file at PATH instead of out.pre in current directory, or stdout if PATH is -" << std::endl;
     std::cout << "    -f FILE INTERNAL_PATH       Embed FILE with internal path INTERNAL_PATH" << std::endl;
     std::cout << "    -q                          Suppress some output. Does not include errors" << std::endl;
     std::cout << "    -w                          Overwrite existing file" << std::endl;
+    std::cout << "    -c                          Compress files" << std::endl;
+    std::cout << "    -u                          Update the existing pre file at PATH, replacing files with the same internal path and adding the rest" << std::endl;
     std::cout << "    -n                          Don't create pre file, just list files" << std::endl;
+    std::cout << "    -j THREADS                  Read, compress and write files on THREADS threads. 0 uses one per cpu core" << std::endl;
+    std::cout << "    --tar FILE                  Pack the files in the tar stream FILE, or stdin if FILE is -, with the" << std::endl;
+    std::cout << "                                paths in the tar stream as internal paths" << std::endl;
+    std::cout << "    --file-io BACKEND           Read and write files with stream, the default, mmap, pread or memory" << std::endl;
+    std::cout << "    --json                      Print the listing and results as one JSON object per line" << std::endl;
+    std::cout << "    --stats                     Print time spent in each phase, throughput and peak memory" << std::endl;
+    std::cout << "    --stats-json FILE           Write the same report as JSON to FILE, or stdout if FILE is -" << std::endl;
+    std::cout << "    --trace FILE                Write a timeline of each file in Chrome trace format to FILE" << std::endl;
 }
 
 bool ReadArgs(int argc, char **argv)
@@ -133,7 +280,64 @@ bool ReadArgs(int argc, char **argv)
     {
         arg = argv[i];
 
-        if ((arg[0] == '-') && (arg.size() > 1))
+        if (arg == "--json")
+        {
+            globalValues.json = true;
+        }
+        else if (arg == "--stats")
+        {
+            globalValues.stats = true;
+        }
+        else if (arg == "--stats-json")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: Wrong number of arguments after --stats-json" << std::endl;
+                return true;
+            }
+
+            ++i;
+            globalValues.statsjson = argv[i];
+        }
+        else if (arg == "--tar")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: Wrong number of arguments after --tar" << std::endl;
+                return true;
+            }
+
+            ++i;
+            globalValues.tarpath = argv[i];
+        }
+        else if (arg == "--file-io")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: Wrong number of arguments after --file-io" << std::endl;
+                return true;
+            }
+
+            ++i;
+
+            if (ParseFileIoBackend(argv[i], globalValues.fileio))
+            {
+                std::cerr << "Error: Unknown file I/O backend \"" << argv[i] << "\"" << std::endl;
+                return true;
+            }
+        }
+        else if (arg == "--trace")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: Wrong number of arguments after --trace" << std::endl;
+                return true;
+            }
+
+            ++i;
+            globalValues.tracepath = argv[i];
+        }
+        else if ((arg[0] == '-') && (arg.size() > 1))
         {
             std::string switches = arg.substr(1, arg.size() - 1);
             bool exclusive_sw = false;
@@ -178,6 +382,34 @@ bool ReadArgs(int argc, char **argv)
                     ++i;
                     globalValues.outpath = argv[i];
                 }
+                else if (c == 'j')
+                {
+                    if (exclusive_sw)
+                    {
+                        std::cerr << "Error: Mutually exclusive switches combined" << std::endl;
+                        return true;
+                    }
+
+                    exclusive_sw = true;
+
+                    if (i + 1 >= argc)
+                    {
+                        std::cerr << "Error: Wrong number of arguments after -j" << std::endl;
+                        return true;
+                    }
+
+                    ++i;
+
+                    try
+                    {
+                        globalValues.threads = std::stoul(argv[i]);
+                    }
+                    catch (const std::exception &)
+                    {
+                        std::cerr << "Error: Invalid thread count \"" << argv[i] << "\"" << std::endl;
+                        return true;
+                    }
+                }
                 else if (c == 'w')
                 {
                     globalValues.overwrite = true;
@@ -186,6 +418,14 @@ bool ReadArgs(int argc, char **argv)
                 {
                     globalValues.pack = false;
                 }
+                else if (c == 'c')
+                {
+                    globalValues.compress = true;
+                }
+                else if (c == 'u')
+                {
+                    globalValues.update = true;
+                }
                 else if (c == 'q')
                 {
                     globalValues.quiet = true;
@@ -207,7 +447,8 @@ bool ReadArgs(int argc, char **argv)
 
 bool ReadPrespec()
 {
-    std::ifstream psstream(globalValues.prespecpath);
+    std::ifstream psfile;
+    std::istream &psstream = OpenInStream(globalValues.prespecpath, psfile, std::ios::in);
 
     if (!psstream.good())
     {
@@ -245,7 +486,7 @@ bool ReadPrespec()
     return false;
 }
 
-bool ReadLine(std::ifstream &instream, std::string &outstr)
+bool ReadLine(std::istream &instream, std::string &outstr)
 {
     bool line_ended = false;
     outstr = "";
@@ -277,203 +518,1064 @@ bool ReadLine(std::ifstream &instream, std::string &outstr)
     return false;
 }
 
-bool WritePre()
+bool ReadInputFile(const std::filesystem::path &path, std::vector<char> &buffer)
 {
-    unsigned int presize = 0;
-    unsigned int precount = 0;
-    std::ofstream outstream;
-    std::vector<char> buffer;
-    PreHeader header;
-    const unsigned int chunksize = 1024 * 1024;
+    FileSource file;
+    bool failed;
 
-    buffer.reserve(chunksize);
-    
-    if (globalValues.pack)
-    {
-        if (std::filesystem::exists(globalValues.outpath) && !globalValues.overwrite)
-        {
-            std::cerr << "Error: file \"" << globalValues.outpath.string() << "\" already exists and overwrite not enabled" << std::endl;
-            return true;
-        }
-        
-        outstream.open(globalValues.outpath, outstream.binary);
+    if (path.extension() == ".filelist") return BuildTexFile(path, buffer);
 
-        if (outstream.fail())
-        {
-            std::cerr << "Error: Failed to create pre file \"" << globalValues.outpath.string() << "\"" << std::endl;
-            return true;
-        }
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+        TraceSpan span("open");
+        failed = file.Open(path);
+    }
 
-        if (WritePreHeader(outstream, PreHeader(), presize))
-        {
-            std::cerr << "Error: Failed to write pre file header" << std::endl;
-            return true;
-        }
+    if (failed)
+    {
+        std::cerr << "Error: Failed to open \"" << path.string() << "\"" << std::endl;
+        return true;
     }
 
-    for (FilePair fp : globalValues.filelist)
     {
-        std::ifstream instream;
-        SubFileHeader subheader;
-        unsigned int pad;
-        
-        if (!globalValues.quiet)
+        StatsTimer timer(StatsPhase::Read);
+        TraceSpan span("read");
+
+        if (file.ReadAll(buffer))
         {
-            std::cout << "file: " << fp.path.string() << std::endl;
-            std::cout << "internal path: " << fp.internal_path << std::endl;
+            std::cerr << "Error: Failed to read \"" << path.string() << "\"" << std::endl;
+            return true;
         }
 
-        subheader.pathCRC = StringCRC(fp.internal_path);
-        
-        // Even if the path string ends up being a multiple of 4 we need to pad it because there
-        // needs to be a null at the end.
-        pad = 4 - (fp.internal_path.size() % 4);
+        StatsAddRead(buffer.size());
+    }
 
-        for (char c : fp.internal_path)
-        {
-            subheader.path.push_back(c);
-        }
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+        TraceSpan span("close");
+        file.Close();
+    }
 
-        for (unsigned int i = 0; i < pad; ++i)
-        {
-            subheader.path.push_back(0);
-        }
+    return false;
+}
 
-        subheader.pathSize = subheader.path.size();
+// A filelist of dds files, like the ones ug2-pre-unpack --tex-to-dds writes, is packed as the tex.xbx file
+// ug2-dds2tex would build from it. The tex.xbx file is only ever built in memory.
+bool BuildTexFile(const std::filesystem::path &path, std::vector<char> &buffer)
+{
+    std::ostringstream texstream;
 
-        instream.open(fp.path, instream.binary);
+    {
+        StatsTimer timer(StatsPhase::Convert);
+        TraceSpan span("convert");
 
-        if (!instream.good())
+        if (WriteTexFromFileList(path, texstream))
         {
-            std::cerr << "Error: Failed to open \"" << fp.path.string() << "\"" << std::endl;
+            std::cerr << "Error: Failed to build tex.xbx file from \"" << path.string() << "\"" << std::endl;
             return true;
         }
+    }
 
-        subheader.inflatedSize = 0;
-        subheader.deflatedSize = 0;
-        buffer.clear();
-        buffer.resize(chunksize);
-        
-        while (!instream.eof())
-        {
-            if (subheader.inflatedSize == buffer.size())
-            {
-                buffer.resize(buffer.size() + chunksize);
-            }
-
-            instream.read(buffer.data() + subheader.inflatedSize, chunksize);
-            subheader.inflatedSize += instream.gcount();
-        }
+    const std::string &texdata = texstream.str();
 
-        buffer.resize(subheader.inflatedSize);
+    buffer.assign(texdata.begin(), texdata.end());
+    StatsAddRead(buffer.size());
 
-        if (globalValues.pack)
-        {
-            if (WriteSubFileHeader(outstream, subheader, presize))
-            {
-                std::cerr << "Error: Failed to write sub file header" << std::endl;
-                return true;
-            }
+    return false;
+}
 
-            outstream.write(buffer.data(), buffer.size());
+bool OpenTarInput()
+{
+    if (globalValues.filelist.size() != 0)
+    {
+        std::cerr << "Error: --tar can't be combined with -f or a prespec" << std::endl;
+        return true;
+    }
 
-            if (outstream.fail())
-            {
-                std::cerr << "Error: Failed to write sub file" << std::endl;
-                return true;
-            }
-        }
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
 
-        if (!globalValues.quiet)
+        if (tarValues.file.Open(globalValues.tarpath))
         {
-            std::cout << "size: " << subheader.inflatedSize << std::endl << std::endl;
+            std::cerr << "Error: Failed to open tar file \"" << globalValues.tarpath.string() << "\"" << std::endl;
+            return true;
         }
+    }
 
-        presize += subheader.inflatedSize;
+    tarValues.stream = &tarValues.file.Stream();
 
-        pad = (presize % 4) ? (4 - (presize % 4)) : 0;
+    return false;
+}
 
-        for (unsigned int i = 0; i < pad; ++i)
-        {
-            if (globalValues.pack)
-            {
-                outstream.put(0);
+// The next file to pack, from the tar stream with --tar and from the file list otherwise. The tar stream is only
+// read forward, one file at a time, so it can come through a pipe. done is set when there are no files left.
+bool NextInputFile(size_t index, std::filesystem::path &path, std::string &internal_path, std::vector<char> &buffer, bool &done)
+{
+    done = false;
 
-                if (outstream.fail())
-                {
-                    std::cerr << "Error: Failed to pad sub file" << std::endl;
-                    return true;
-                }
-            }
+    if (!tarValues.stream)
+    {
+        done = (index >= globalValues.filelist.size());
 
-            ++presize;
-        }
+        if (done) return false;
 
-        ++precount;
+        path = globalValues.filelist[index].path;
+        internal_path = globalValues.filelist[index].internal_path;
+
+        return ReadInputFile(path, buffer);
     }
 
-    header.size = presize;
-    header.numFiles = precount;
+    TarEntryHeader header;
 
-    if (globalValues.pack)
     {
-        outstream.seekp(0);
+        StatsTimer timer(StatsPhase::Parse);
 
-        if (WritePreHeader(outstream, header, presize))
-        {
-            std::cerr << "Error: Failed to write pre file header" << std::endl;
-            return true;
-        }
+        if (ReadTarHeader(*tarValues.stream, header, done)) return true;
+        if (done) return false;
     }
 
-    if (!globalValues.quiet)
     {
-        std::cout << globalValues.outpath.string() << std::endl;
-        std::cout << "total files: " << header.numFiles << std::endl;
-        std::cout << "total size: " << header.size << std::endl;
+        StatsTimer timer(StatsPhase::Read);
+        TraceSpan span("read");
+
+        if (ReadTarData(*tarValues.stream, header, buffer)) return true;
+
+        StatsAddRead(buffer.size());
     }
-    
+
+    // Tar paths use forward slashes, and pre files use backslashes.
+    internal_path = header.name;
+
+    if (internal_path.compare(0, 2, "./") == 0) internal_path.erase(0, 2);
+
+    std::replace(internal_path.begin(), internal_path.end(), '/', '\\');
+    path = header.name;
+
     return false;
 }
 
-bool WritePreHeader(std::ofstream &outstream, const PreHeader &header, unsigned int &sizeout)
+void SetSubFilePath(SubFileHeader &subheader, const std::string &internal_path)
 {
-    char bytes[12];
+    subheader.pathCRC = StringCRC(internal_path);
+    
+    // Even if the path string ends up being a multiple of 4 we need to pad it because there
+    // needs to be a null at the end.
+    unsigned int pad = 4 - (internal_path.size() % 4);
 
-    write_u32le(bytes, header.size);
-    write_u16le(&bytes[4], 3);
-    write_u16le(&bytes[6], 0xabcd);
-    write_u32le(&bytes[8], header.numFiles);
+    subheader.path.assign(internal_path.begin(), internal_path.end());
+    subheader.path.resize(internal_path.size() + pad, 0);
+    subheader.pathSize = subheader.path.size();
+}
 
-    outstream.write(bytes, 12);
+// Whether fp is a plain file that's stored exactly as it is without -c, so its size in the pre file is known
+// without reading it.
+bool PlainFileSize(const FilePair &fp, uint64_t &size)
+{
+    std::error_code ec;
 
-    if (outstream.fail())
+    if (globalValues.compress || IsStdStream(fp.path) || fp.path.extension() == ".filelist") return false;
+    if (!std::filesystem::is_regular_file(fp.path, ec)) return false;
+
+    size = std::filesystem::file_size(fp.path, ec);
+
+    return !ec;
+}
+
+// Work out the pre header before packing anything. That's only possible when every file is stored as it is
+// and its size can be looked up.
+bool PlanPreHeader(PreHeader &header)
+{
+    uint64_t size = 12;
+
+    if (tarValues.stream) return false;
+
+    for (const FilePair &fp : globalValues.filelist)
     {
-        return true;
+        uint64_t filesize;
+
+        if (!PlainFileSize(fp, filesize)) return false;
+
+        size += 16 + fp.internal_path.size() + 4 - (fp.internal_path.size() % 4);
+        size += filesize + ((filesize % 4) ? (4 - (filesize % 4)) : 0);
     }
 
-    sizeout += 12;
-    return false;
+    if (size > PreFieldMax) return false;
+
+    header.size = size;
+    header.numFiles = globalValues.filelist.size();
+
+    return true;
 }
 
-bool WriteSubFileHeader(std::ofstream &outstream, const SubFileHeader &subheader, unsigned int &sizeout)
+// Run work(0) to work(count - 1) spread over globalValues.threads threads, stopping early once one fails.
+bool ParallelFor(size_t count, const std::function<bool(size_t)> &work)
 {
-    std::vector<char> bytes(16);
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < count && !failed; i = next++)
+        {
+            if (work(i)) failed = true;
+        }
+    };
+
+    unsigned int threads = globalValues.threads ? globalValues.threads : std::thread::hardware_concurrency();
 
-    write_u32le(&bytes[0], subheader.inflatedSize);
-    write_u32le(&bytes[4], subheader.deflatedSize);
-    write_u32le(&bytes[8], subheader.pathSize);
-    write_u32le(&bytes[12], subheader.pathCRC);
+    if (threads > count) threads = count;
 
-    bytes.insert(bytes.end(), subheader.path.begin(), subheader.path.end());
+    if (threads <= 1)
+    {
+        worker();
+    }
+    else
+    {
+        std::vector<std::thread> pool;
 
-    outstream.write(bytes.data(), bytes.size());
+        for (unsigned int i = 0; i < threads; ++i)
+        {
+            pool.emplace_back(worker);
+        }
 
-    if (outstream.fail())
+        for (std::thread &t : pool)
+        {
+            t.join();
+        }
+    }
+
+    return failed;
+}
+
+bool WritePre()
+{
+    // With more than one thread, files from the file list are put straight into their place in the pre file.
+    // Tar input and outputs that can only be written front to back go in order, one file at a time.
+    if (globalValues.pack && globalValues.threads != 1 && !tarValues.stream && !IsSequentialOutput(globalValues.outpath))
+    {
+        return WritePreMapped();
+    }
+
+    uint64_t presize = 0;
+    unsigned int precount = 0;
+    FileSink outfile;
+    std::ostream *outstream = &outfile.Stream();
+    std::stringstream held;
+    std::ostream *sendstream = nullptr;
+    std::vector<char> buffer;
+    std::vector<char> deflated;
+    PreHeader header;
+    bool sequential = IsSequentialOutput(globalValues.outpath);
+    bool planned = false;
+    DuplicateValues duplicates;
+
+    if (globalValues.pack)
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+
+        if (!sequential && std::filesystem::exists(globalValues.outpath) && !globalValues.overwrite)
+        {
+            std::cerr << "Error: file \"" << globalValues.outpath.string() << "\" already exists and overwrite not enabled" << std::endl;
+            return true;
+        }
+        
+        if (outfile.Create(globalValues.outpath))
+        {
+            std::cerr << "Error: Failed to create pre file \"" << globalValues.outpath.string() << "\"" << std::endl;
+            return true;
+        }
+
+        outstream = &outfile.Stream();
+
+        // Nothing can be patched once it's gone down a pipe, and the pre header in front holds the total size.
+        // If that can be worked out from the input files, only the header is decided ahead. Otherwise the pre
+        // file is put together in memory and sent once it's done.
+        if (sequential)
+        {
+            planned = PlanPreHeader(header);
+
+            if (!planned)
+            {
+                sendstream = outstream;
+                outstream = &held;
+            }
+        }
+
+        if (WritePreHeader(*outstream, planned ? header : PreHeader(), presize))
+        {
+            std::cerr << "Error: Failed to write pre file header" << std::endl;
+            return true;
+        }
+    }
+
+    for (size_t index = 0; ; ++index)
+    {
+        SubFileHeader subheader;
+        unsigned int pad;
+        std::filesystem::path path;
+        std::string internal_path;
+        bool done;
+
+        if (NextInputFile(index, path, internal_path, buffer, done)) return true;
+        if (done) break;
+
+        TraceSpan span("file", internal_path);
+
+        SetSubFilePath(subheader, internal_path);
+
+        subheader.inflatedSize = buffer.size();
+        subheader.deflatedSize = 0;
+
+        const std::vector<char> *payload = &buffer;
+
+        if (globalValues.compress)
+        {
+            StatsTimer timer(StatsPhase::Deflate);
+            TraceSpan span("deflate");
+            LzssDeflate(buffer.data(), buffer.size(), deflated);
+
+            // Files that don't get any smaller are stored uncompressed.
+            if (deflated.size() < buffer.size())
+            {
+                subheader.deflatedSize = deflated.size();
+                payload = &deflated;
+            }
+        }
+
+        uint64_t entrySize = 16 + subheader.pathSize + payload->size();
+
+        entrySize += (entrySize % 4) ? (4 - (entrySize % 4)) : 0;
+
+        // Listing without packing can go on past what a pre file can hold, since it's only adding up sizes.
+        if (globalValues.pack && presize + entrySize > PreFieldMax)
+        {
+            std::cerr << "Error: Adding \"" << internal_path << "\" takes the pre file past " << PreFieldMax << " bytes, which is too big for a pre file" << std::endl;
+            return true;
+        }
+
+        if (globalValues.pack)
+        {
+            StatsTimer timer(StatsPhase::Write);
+            TraceSpan span("write");
+
+            if (WriteSubFileHeader(*outstream, subheader, presize))
+            {
+                std::cerr << "Error: Failed to write sub file header" << std::endl;
+                return true;
+            }
+
+            outstream->write(payload->data(), payload->size());
+
+            if (outstream->fail())
+            {
+                std::cerr << "Error: Failed to write sub file" << std::endl;
+                return true;
+            }
+        }
+
+        ReportFile(path, internal_path, subheader, ContentHash(buffer.data(), buffer.size()), payload->size(), duplicates);
+
+        presize += payload->size();
+
+        pad = (presize % 4) ? (4 - (presize % 4)) : 0;
+
+        for (unsigned int i = 0; i < pad; ++i)
+        {
+            if (globalValues.pack)
+            {
+                outstream->put(0);
+
+                if (outstream->fail())
+                {
+                    std::cerr << "Error: Failed to pad sub file" << std::endl;
+                    return true;
+                }
+            }
+
+            ++presize;
+        }
+
+        ++precount;
+        StatsAddEntries(1);
+    }
+
+    if (planned && (header.size != presize || header.numFiles != precount))
+    {
+        std::cerr << "Error: Input files changed size while being packed" << std::endl;
+        return true;
+    }
+
+    header.size = presize;
+    header.numFiles = precount;
+
+    if (globalValues.pack && !planned)
+    {
+        StatsTimer timer(StatsPhase::Write);
+        TraceSpan span("header");
+        outstream->seekp(0);
+
+        if (WritePreHeader(*outstream, header, presize))
+        {
+            std::cerr << "Error: Failed to write pre file header" << std::endl;
+            return true;
+        }
+    }
+
+    if (sendstream)
+    {
+        StatsTimer timer(StatsPhase::Write);
+        TraceSpan span("send");
+
+        held.seekg(0);
+        *sendstream << held.rdbuf();
+        sendstream->flush();
+
+        if (sendstream->fail())
+        {
+            std::cerr << "Error: Failed to write pre file" << std::endl;
+            return true;
+        }
+    }
+
+    if (globalValues.pack)
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+        TraceSpan span("close");
+
+        if (outfile.Close())
+        {
+            std::cerr << "Error: Failed to write pre file \"" << globalValues.outpath.string() << "\"" << std::endl;
+            return true;
+        }
+
+        StatsAddWritten(header.size);
+    }
+
+    ReportArchive(header, duplicates);
+
+    return false;
+}
+
+// Pack the file list in two passes. The first reads and compresses every file that isn't stored as it is,
+// which settles where each one goes. The pre file is then created at its full size and every file is written
+// into its own part of it. Both passes are spread over globalValues.threads threads. Files stored as they are
+// only have their size looked up in the first pass and are read straight into the pre file in the second, so
+// only compressed files and built tex.xbx files are held in memory in between.
+bool WritePreMapped()
+{
+    std::vector<PackedFile> packed(globalValues.filelist.size());
+    MappedOutFile outfile;
+    PreHeader header;
+    uint64_t presize = 12;
+    DuplicateValues duplicates;
+
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+
+        if (std::filesystem::exists(globalValues.outpath) && !globalValues.overwrite)
+        {
+            std::cerr << "Error: file \"" << globalValues.outpath.string() << "\" already exists and overwrite not enabled" << std::endl;
+            return true;
+        }
+    }
+
+    bool failed = ParallelFor(packed.size(), [&](size_t index)
+    {
+        const FilePair &fp = globalValues.filelist[index];
+        PackedFile &file = packed[index];
+        std::vector<char> buffer;
+        std::vector<char> deflated;
+        uint64_t size;
+        TraceSpan span("file", fp.internal_path);
+
+        SetSubFilePath(file.subheader, fp.internal_path);
+        file.subheader.deflatedSize = 0;
+
+        if (PlainFileSize(fp, size))
+        {
+            file.subheader.inflatedSize = size;
+            return false;
+        }
+
+        bool done;
+        std::filesystem::path path;
+        std::string internal_path;
+
+        if (NextInputFile(index, path, internal_path, buffer, done)) return true;
+
+        file.subheader.inflatedSize = buffer.size();
+        file.hash = ContentHash(buffer.data(), buffer.size());
+
+        if (globalValues.compress)
+        {
+            StatsTimer timer(StatsPhase::Deflate);
+            TraceSpan span("deflate");
+            LzssDeflate(buffer.data(), buffer.size(), deflated);
+
+            // Files that don't get any smaller are stored uncompressed.
+            if (deflated.size() < buffer.size())
+            {
+                file.subheader.deflatedSize = deflated.size();
+                file.payload.swap(deflated);
+                return false;
+            }
+        }
+
+        file.payload.swap(buffer);
+        return false;
+    });
+
+    if (failed) return true;
+
+    for (size_t i = 0; i < packed.size(); ++i)
+    {
+        PackedFile &file = packed[i];
+        uint64_t storedSize = file.subheader.deflatedSize ? file.subheader.deflatedSize : file.subheader.inflatedSize;
+        uint64_t entrySize = 16 + file.subheader.pathSize + storedSize;
+
+        entrySize += (entrySize % 4) ? (4 - (entrySize % 4)) : 0;
+
+        if (presize + entrySize > PreFieldMax)
+        {
+            std::cerr << "Error: Adding \"" << globalValues.filelist[i].internal_path << "\" takes the pre file past " << PreFieldMax << " bytes, which is too big for a pre file" << std::endl;
+            return true;
+        }
+
+        file.offset = presize;
+        presize += entrySize;
+    }
+
+    header.size = presize;
+    header.numFiles = packed.size();
+
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+
+        if (outfile.Create(globalValues.outpath, presize))
+        {
+            std::cerr << "Error: Failed to create pre file \"" << globalValues.outpath.string() << "\"" << std::endl;
+            return true;
+        }
+    }
+
+    {
+        MemoryOutStream headerstream(outfile.Data(), 12);
+        uint64_t written = 0;
+
+        if (WritePreHeader(headerstream, header, written))
+        {
+            std::cerr << "Error: Failed to write pre file header" << std::endl;
+            return true;
+        }
+    }
+
+    // The padding after each file is already zero, since the pre file started out that way.
+    failed = ParallelFor(packed.size(), [&](size_t index)
+    {
+        const FilePair &fp = globalValues.filelist[index];
+        PackedFile &file = packed[index];
+        uint64_t storedSize = file.subheader.deflatedSize ? file.subheader.deflatedSize : file.subheader.inflatedSize;
+        char *region = outfile.Data() + file.offset;
+        uint64_t written = 0;
+        TraceSpan span("file", fp.internal_path);
+
+        {
+            StatsTimer timer(StatsPhase::Write);
+            MemoryOutStream headerstream(region, 16 + file.subheader.pathSize);
+
+            if (WriteSubFileHeader(headerstream, file.subheader, written))
+            {
+                std::cerr << "Error: Failed to write sub file header" << std::endl;
+                return true;
+            }
+        }
+
+        region += written;
+
+        if (file.payload.empty() && storedSize)
+        {
+            if (ReadPlainFile(fp.path, region, storedSize)) return true;
+
+            file.hash = ContentHash(region, storedSize);
+            return false;
+        }
+
+        StatsTimer timer(StatsPhase::Write);
+        TraceSpan writeSpan("write");
+
+        std::copy(file.payload.begin(), file.payload.end(), region);
+        std::vector<char>().swap(file.payload);
+
+        return false;
+    });
+
+    if (failed) return true;
+
+    {
+        StatsTimer timer(StatsPhase::Write);
+        TraceSpan span("close");
+
+        if (outfile.Close())
+        {
+            std::cerr << "Error: Failed to write pre file \"" << globalValues.outpath.string() << "\"" << std::endl;
+            return true;
+        }
+    }
+
+    StatsAddWritten(header.size);
+
+    for (size_t i = 0; i < packed.size(); ++i)
+    {
+        const PackedFile &file = packed[i];
+        uint64_t storedSize = file.subheader.deflatedSize ? file.subheader.deflatedSize : file.subheader.inflatedSize;
+
+        ReportFile(globalValues.filelist[i].path, globalValues.filelist[i].internal_path, file.subheader, file.hash, storedSize, duplicates);
+        StatsAddEntries(1);
+    }
+
+    ReportArchive(header, duplicates);
+
+    return false;
+}
+
+// Read a file that's stored as it is straight into its place in the pre file. It has to be exactly the size it
+// was when the pre file was laid out.
+bool ReadPlainFile(const std::filesystem::path &path, char *data, uint64_t size)
+{
+    FileSource file;
+    bool failed;
+
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+        TraceSpan span("open");
+        failed = file.Open(path);
+    }
+
+    std::istream &instream = file.Stream();
+
+    if (failed || !instream.good())
+    {
+        std::cerr << "Error: Failed to open \"" << path.string() << "\"" << std::endl;
+        return true;
+    }
+
+    StatsTimer timer(StatsPhase::Read);
+    TraceSpan span("read");
+
+    instream.read(data, size);
+
+    if (instream.fail() || static_cast<uint64_t>(instream.gcount()) != size || instream.peek() != EOF)
+    {
+        std::cerr << "Error: \"" << path.string() << "\" changed size while being packed" << std::endl;
+        return true;
+    }
+
+    StatsAddRead(size);
+
+    return false;
+}
+
+void ReportFile(const std::filesystem::path &path, const std::string &internal_path, const SubFileHeader &subheader, uint64_t hash, uint64_t storedSize, DuplicateValues &duplicates)
+{
+    ReportRecord record("file");
+    std::pair<uint64_t, uint64_t> key(subheader.inflatedSize, hash);
+    auto inserted = duplicates.contents.emplace(key, internal_path);
+
+    record.Field("path", path.string()).Field("internal_path", internal_path);
+    record.Field("size", subheader.inflatedSize).Field("compressed_size", subheader.deflatedSize);
+    record.Text() << "file: " << path.string() << "\n";
+    record.Text() << "internal path: " << internal_path << "\n";
+    record.Text() << "size: " << subheader.inflatedSize << "\n";
+
+    if (subheader.deflatedSize)
+    {
+        record.Text() << "compressed size: " << subheader.deflatedSize << "\n";
+    }
+
+    if (!inserted.second)
+    {
+        duplicates.files++;
+        duplicates.bytes += storedSize;
+        record.Field("duplicate_of", inserted.first->second);
+        record.Text() << "duplicate of: " << inserted.first->second << "\n";
+    }
+}
+
+void ReportArchive(const PreHeader &header, const DuplicateValues &duplicates)
+{
+    {
+        ReportRecord record("archive");
+
+        record.Field("path", globalValues.outpath.string()).Field("files", header.numFiles).Field("size", header.size);
+        record.Text() << globalValues.outpath.string() << "\n";
+        record.Text() << "total files: " << header.numFiles << "\n";
+        record.Text() << "total size: " << header.size;
+    }
+
+    if (duplicates.files)
+    {
+        ReportRecord record("duplicates", true);
+
+        record.Field("files", duplicates.files).Field("bytes", duplicates.bytes);
+        record.Text() << duplicates.files << " files are duplicates of earlier ones, taking up " << duplicates.bytes << " bytes.";
+    }
+}
+
+// Put the input files into the existing pre file, replacing the first subfile with the same internal path or
+// adding them to the end. The pre file is read and written once for all of them, so the new payloads are held in
+// memory until every input has been read.
+bool UpdatePre()
+{
+    FileSource prefile;
+    std::vector<PreIndexEntry> index;
+    std::vector<UpdateSlot> slots;
+    std::vector<UpdatedFile> updated;
+    std::map<std::string, size_t> slotIndices;
+    std::vector<char> buffer;
+    std::vector<char> deflated;
+
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+
+        if (!std::filesystem::exists(globalValues.outpath))
+        {
+            std::cerr << "Error: Pre file \"" << globalValues.outpath.string() << "\" to update doesn't exist" << std::endl;
+            return true;
+        }
+
+        if (prefile.Open(globalValues.outpath) || prefile.Load())
+        {
+            std::cerr << "Error: Failed to open pre file \"" << globalValues.outpath.string() << "\"" << std::endl;
+            return true;
+        }
+    }
+
+    {
+        StatsTimer timer(StatsPhase::Parse);
+        TraceSpan span("header");
+
+        if (ReadPreIndex(prefile.Data(), prefile.Size(), globalValues.outpath.string(), index)) return true;
+    }
+
+    slots.resize(index.size());
+
+    for (size_t i = 0; i < index.size(); ++i)
+    {
+        slots[i].existing = &index[i];
+        slots[i].subheader = index[i].subheader;
+
+        // Only the first subfile with a path gets replaced.
+        slotIndices.emplace(index[i].path, i);
+    }
+
+    for (size_t n = 0; ; ++n)
+    {
+        SubFileHeader subheader;
+        std::filesystem::path path;
+        std::string internal_path;
+        bool done;
+
+        if (NextInputFile(n, path, internal_path, buffer, done)) return true;
+        if (done) break;
+
+        TraceSpan span("file", internal_path);
+
+        subheader.inflatedSize = buffer.size();
+        subheader.deflatedSize = 0;
+
+        std::vector<char> *payload = &buffer;
+
+        if (globalValues.compress)
+        {
+            StatsTimer timer(StatsPhase::Deflate);
+            TraceSpan span("deflate");
+            LzssDeflate(buffer.data(), buffer.size(), deflated);
+
+            if (deflated.size() < buffer.size())
+            {
+                subheader.deflatedSize = deflated.size();
+                payload = &deflated;
+            }
+        }
+
+        auto found = slotIndices.find(internal_path);
+        bool replaces = found != slotIndices.end();
+
+        if (!replaces)
+        {
+            found = slotIndices.emplace(internal_path, slots.size()).first;
+            slots.emplace_back();
+            SetSubFilePath(slots.back().subheader, internal_path);
+        }
+
+        // Keep the path exactly as it was stored, padding and all.
+        UpdateSlot &slot = slots[found->second];
+
+        slot.subheader.inflatedSize = subheader.inflatedSize;
+        slot.subheader.deflatedSize = subheader.deflatedSize;
+        slot.payload.swap(*payload);
+        slot.replaced = true;
+
+        updated.push_back({internal_path, found->second, replaces, subheader.inflatedSize, subheader.deflatedSize});
+        StatsAddEntries(1);
+    }
+
+    // Everything after a subfile that changes size has to move, so then the whole pre file is rewritten.
+    // Otherwise replacements are written over the subfiles they replace and new files go on the end.
+    bool rewrite = false;
+
+    for (const UpdateSlot &slot : slots)
+    {
+        if (slot.existing && slot.replaced && UpdateSlotSize(slot) != slot.existing->end - slot.existing->start)
+        {
+            rewrite = true;
+        }
+    }
+
+    for (const UpdatedFile &file : updated)
+    {
+        ReportRecord record("file");
+        bool inPlace = !rewrite && slots[file.slot].existing;
+        const char *action = !file.found ? "added" : (inPlace ? "replaced in place" : "replaced");
+
+        record.Field("internal_path", file.internal_path).Field("action", action);
+        record.Field("size", file.inflatedSize).Field("compressed_size", file.deflatedSize);
+        record.Text() << "internal path: " << file.internal_path << "\n";
+        record.Text() << action << "\n";
+        record.Text() << "size: " << file.inflatedSize << "\n";
+
+        if (file.deflatedSize)
+        {
+            record.Text() << "compressed size: " << file.deflatedSize << "\n";
+        }
+    }
+
+    if (!globalValues.pack) return false;
+
+    StatsTimer timer(StatsPhase::Write);
+    TraceSpan span("write");
+
+    return rewrite ? RewriteUpdatedPre(prefile, slots) : WriteUpdatedInPlace(prefile, slots);
+}
+
+// How many bytes a subfile takes up in the updated pre file. Existing subfiles are copied as they were, plus any
+// padding missing from the end of the last one.
+uint64_t UpdateSlotSize(const UpdateSlot &slot)
+{
+    if (slot.existing && !slot.replaced)
+    {
+        return PaddedEnd(*slot.existing) - slot.existing->start;
+    }
+
+    uint64_t padding = (slot.payload.size() % 4) ? (4 - (slot.payload.size() % 4)) : 0;
+
+    return 16 + slot.subheader.pathSize + slot.payload.size() + padding;
+}
+
+// Where an existing subfile ends with its padding, even if the file ends before that.
+uint64_t PaddedEnd(const PreIndexEntry &entry)
+{
+    uint64_t padding = (entry.payloadSize % 4) ? (4 - (entry.payloadSize % 4)) : 0;
+
+    return entry.offset + entry.payloadSize + padding;
+}
+
+bool WriteUpdateSlot(std::ostream &outstream, const UpdateSlot &slot)
+{
+    const char zeros[4] = {};
+    uint64_t written = 0;
+
+    if (WriteSubFileHeader(outstream, slot.subheader, written))
+    {
+        std::cerr << "Error: Failed to write sub file header" << std::endl;
+        return true;
+    }
+
+    outstream.write(slot.payload.data(), slot.payload.size());
+    outstream.write(zeros, UpdateSlotSize(slot) - written - slot.payload.size());
+
+    return false;
+}
+
+// Write each replacement over the subfile it replaces, and add new files to the end followed by the pre header,
+// which is only written once the new subfiles are all there.
+bool WriteUpdatedInPlace(FileSource &prefile, const std::vector<UpdateSlot> &slots)
+{
+    std::fstream outstream;
+    PreHeader header;
+    const char zeros[4] = {};
+    uint64_t oldSize = prefile.Size();
+    uint64_t fileEnd = 12;
+    uint64_t appendStart = 12;
+    uint64_t written = 0;
+    bool added = false;
+
+    for (const UpdateSlot &slot : slots)
+    {
+        if (slot.existing)
+        {
+            fileEnd = slot.existing->end;
+            appendStart = PaddedEnd(*slot.existing);
+        }
+        else
+        {
+            added = true;
+        }
+    }
+
+    header.numFiles = slots.size();
+    header.size = added ? appendStart : fileEnd;
+
+    for (const UpdateSlot &slot : slots)
+    {
+        if (!slot.existing) header.size += UpdateSlotSize(slot);
+    }
+
+    // The size field of the pre header is only 32 bits.
+    if (header.size > PreFieldMax)
+    {
+        std::cerr << "Error: Updated pre file would be " << header.size << " bytes, which is too big for a pre file" << std::endl;
+        return true;
+    }
+
+    // The mapping has to go before writing to the file on some systems.
+    prefile.Close();
+    outstream.open(globalValues.outpath, outstream.in | outstream.out | outstream.binary);
+
+    if (outstream.fail())
+    {
+        std::cerr << "Error: Failed to open pre file \"" << globalValues.outpath.string() << "\" for writing" << std::endl;
+        return true;
+    }
+
+    for (const UpdateSlot &slot : slots)
+    {
+        if (!slot.existing || !slot.replaced) continue;
+
+        outstream.seekp(slot.existing->start);
+
+        if (WriteUpdateSlot(outstream, slot)) return true;
+
+        written += UpdateSlotSize(slot);
+    }
+
+    if (added)
+    {
+        // Pad out the last subfile first if the file ended without its padding.
+        outstream.seekp(fileEnd);
+        outstream.write(zeros, appendStart - fileEnd);
+        written += appendStart - fileEnd;
+
+        for (const UpdateSlot &slot : slots)
+        {
+            if (slot.existing) continue;
+
+            if (WriteUpdateSlot(outstream, slot)) return true;
+
+            written += UpdateSlotSize(slot);
+        }
+
+        outstream.seekp(0);
+
+        if (WritePreHeader(outstream, header, written))
+        {
+            std::cerr << "Error: Failed to write pre file header" << std::endl;
+            return true;
+        }
+    }
+
+    outstream.close();
+
+    if (outstream.fail())
+    {
+        std::cerr << "Error: Failed to write pre file \"" << globalValues.outpath.string() << "\"" << std::endl;
+        return true;
+    }
+
+    std::error_code ec;
+
+    // Drop anything that was after the last subfile before.
+    if (oldSize > header.size)
+    {
+        std::filesystem::resize_file(globalValues.outpath, header.size, ec);
+    }
+
+    StatsAddWritten(written);
+    return false;
+}
+
+// Copy the whole pre file to a temporary file with the replacements and new files in it, and rename that over the
+// old one once it's safely on the disk. That way a crash part way through leaves the original untouched.
+bool RewriteUpdatedPre(FileSource &prefile, const std::vector<UpdateSlot> &slots)
+{
+    std::filesystem::path temppath = globalValues.outpath;
+    FileSink outfile;
+    PreHeader header;
+    const char zeros[4] = {};
+    uint64_t written = 0;
+    std::error_code ec;
+
+    header.numFiles = slots.size();
+    header.size = 12;
+
+    for (const UpdateSlot &slot : slots)
+    {
+        header.size += UpdateSlotSize(slot);
+    }
+
+    // The size field of the pre header is only 32 bits.
+    if (header.size > PreFieldMax)
+    {
+        std::cerr << "Error: Updated pre file would be " << header.size << " bytes, which is too big for a pre file" << std::endl;
+        return true;
+    }
+
+    temppath += ".tmp";
+
+    if (outfile.Create(temppath, header.size))
+    {
+        std::cerr << "Error: Failed to create \"" << temppath.string() << "\"" << std::endl;
+        return true;
+    }
+
+    std::ostream &outstream = outfile.Stream();
+    bool failed = WritePreHeader(outstream, header, written);
+
+    for (size_t i = 0; !failed && i < slots.size(); ++i)
+    {
+        const UpdateSlot &slot = slots[i];
+
+        if (slot.existing && !slot.replaced)
+        {
+            outstream.write(prefile.Data() + slot.existing->start, slot.existing->end - slot.existing->start);
+            outstream.write(zeros, PaddedEnd(*slot.existing) - slot.existing->end);
+        }
+        else
+        {
+            failed = WriteUpdateSlot(outstream, slot);
+        }
+
+        failed = failed || outstream.fail();
+    }
+
+    failed = outfile.Close() || failed;
+
+    if (failed || SyncFile(temppath))
+    {
+        std::cerr << "Error: Failed to write \"" << temppath.string() << "\"" << std::endl;
+        std::filesystem::remove(temppath, ec);
+        return true;
+    }
+
+    prefile.Close();
+    std::filesystem::rename(temppath, globalValues.outpath, ec);
+
+    if (ec)
     {
+        std::cerr << "Error: Failed to replace \"" << globalValues.outpath.string() << "\" with \"" << temppath.string() << "\"" << std::endl;
         return true;
     }
 
-    sizeout += bytes.size();
+    StatsAddWritten(header.size);
     return false;
 }
\ No newline at end of file
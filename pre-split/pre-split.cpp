@@ -0,0 +1,771 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include "../common/pre_file.hpp"
+#include "../common/crc.hpp"
+#include "../common/file_io.hpp"
+#include "../common/std_stream.hpp"
+#include "../common/report.hpp"
+#include "../common/stats.hpp"
+
+struct FilePair
+{
+    std::filesystem::path path;
+    std::string internal_path;
+
+    FilePair(std::filesystem::path pathin, std::string internal_pathin) : path(pathin), internal_path(internal_pathin) {} 
+};
+
+struct
+{
+    std::filesystem::path inpath;
+    std::filesystem::path outDir;
+    std::string name;
+    uint64_t budget = 0;
+    bool overwrite = false;
+    bool split = true;
+    bool quiet = false;
+    bool json = false;
+    bool printhelp = false;
+    bool stats = false;
+    FileIoBackend fileio = FileIoBackend::Mmap;
+    std::filesystem::path statsjson;
+} globalValues;
+
+// The output archive currently being filled. Only one is open at a time, and its header is written last,
+// once its size and file count are known.
+struct
+{
+    unsigned int index = 0;
+    bool open = false;
+    std::filesystem::path path;
+    FileSink outfile;
+    uint64_t size = 0;
+    uint64_t unplaced = 0;      // Bytes of subfiles still to go into an archive, padding included
+    unsigned int numFiles = 0;
+    std::vector<std::string> names;
+    std::vector<std::pair<unsigned int, std::string>> placements;
+} archiveValues;
+
+void PrintHelp();
+bool ReadArgs(int argc, char **argv);
+bool ParseSize(const std::string &str, uint64_t &out);
+bool ReadPrespec(std::vector<FilePair> &filelist);
+bool ReadLine(std::ifstream &instream, std::string &outstr);
+bool SplitPre();
+bool SplitPrespec();
+bool PlaceSubFile(const SubFileHeader &subheader, const std::string &path, uint64_t payloadSize);
+uint64_t PaddedEntrySize(uint64_t pathSize, uint64_t payloadSize);
+bool StartArchive();
+bool FinishArchive();
+bool WriteManifest();
+
+int main(int argc, char **argv)
+{
+    if (!(argc > 1))
+    {
+        std::cerr << "Error: No arguments" << std::endl;
+        std::cerr << "Splitting failed." << std::endl;
+        PrintHelp();
+        return -1;
+    }
+
+    if (ReadArgs(argc, argv))
+    {
+        std::cerr << "Splitting failed." << std::endl;
+        return -1;
+    }
+
+    if (globalValues.printhelp)
+    {
+        PrintHelp();
+        return 0;
+    }
+
+    ReportSetMode(globalValues.json ? ReportMode::JsonLines : (globalValues.quiet ? ReportMode::Quiet : ReportMode::Plain));
+
+    if (globalValues.stats || !globalValues.statsjson.empty()) StatsEnable();
+
+    SetFileIoBackend(globalValues.fileio);
+
+    if (globalValues.inpath.empty())
+    {
+        std::cerr << "Error: No input file" << std::endl;
+        std::cerr << "Splitting failed." << std::endl;
+        return -1;
+    }
+
+    // Anything smaller can't even hold one file with a one character path.
+    if (globalValues.budget < 36 || globalValues.budget > 0xffffffff)
+    {
+        std::cerr << "Error: Size limit must be given with -s and be between 36 bytes and 4G" << std::endl;
+        std::cerr << "Splitting failed." << std::endl;
+        return -1;
+    }
+
+    if (globalValues.name.empty())
+    {
+        globalValues.name = IsStdStream(globalValues.inpath) ? "stdin" : globalValues.inpath.stem().string();
+    }
+
+    bool failed = (globalValues.inpath.extension() == ".prespec") ? SplitPrespec() : SplitPre();
+
+    if (failed || FinishArchive() || (globalValues.split && WriteManifest()))
+    {
+        std::cerr << "Splitting failed." << std::endl;
+        return -1;
+    }
+
+    ReportFlush();
+
+    if (globalValues.stats) StatsPrint(std::cout);
+
+    if (!globalValues.statsjson.empty() && StatsWriteJson(globalValues.statsjson))
+    {
+        std::cerr << "Splitting failed." << std::endl;
+        return -1;
+    }
+
+    ReportRecord("result").Field("success", true).Text() << "Splitting successful.";
+
+    return 0;
+}
+
+void PrintHelp()
+{
+    std::cout << "Usage: ug2-pre-split [FILE] [OPTION]..." << std::endl << std::endl;
+    std::cout << "Split a pre/prx file, or the files listed in a prespec, into pre files no bigger than a size limit." << std::endl << std::endl;
+    std::cout << "Examples:" << std::endl << std::endl;
+    std::cout << "        ug2-pre-split big.pre -s 64M -o parts" << std::endl << std::endl;
+    std::cout << "        Write parts/big_0.pre, parts/big_1.pre and so on, each at most 64 MiB, and list which internal path went where in parts/big.splitmanifest." << std::endl << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "    -h                          Print this help text" << std::endl;
+    std::cout << "    -s SIZE                     Limit each pre file to SIZE bytes. K, M or G after the number multiply it by 1024, 1024^2 or 1024^3" << std::endl;
+    std::cout << "    -o DIRECTORY                Output files in DIRECTORY instead of current directory" << std::endl;
+    std::cout << "    -f NAME                     Name output files NAME_0.pre, NAME_1.pre... instead of after the input file" << std::endl;
+    std::cout << "    -q                          Suppress some output. Does not include errors" << std::endl;
+    std::cout << "    -w                          Overwrite existing files" << std::endl;
+    std::cout << "    -n                          Don't create any files, just list where each file would go" << std::endl;
+    std::cout << "    --file-io BACKEND           Read and write files with mmap, the default, stream, pread or memory" << std::endl;
+    std::cout << "    --json                      Print the listing and results as one JSON object per line" << std::endl;
+    std::cout << "    --stats                     Print time spent in each phase, throughput and peak memory" << std::endl;
+    std::cout << "    --stats-json FILE           Write the same report as JSON to FILE, or stdout if FILE is -" << std::endl;
+}
+
+bool ReadArgs(int argc, char **argv)
+{
+    std::string arg;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        arg = argv[i];
+
+        if (arg == "--json")
+        {
+            globalValues.json = true;
+        }
+        else if (arg == "--stats")
+        {
+            globalValues.stats = true;
+        }
+        else if (arg == "--stats-json")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: Wrong number of arguments after --stats-json" << std::endl;
+                return true;
+            }
+
+            ++i;
+            globalValues.statsjson = argv[i];
+        }
+        else if (arg == "--file-io")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: Wrong number of arguments after --file-io" << std::endl;
+                return true;
+            }
+
+            ++i;
+
+            if (ParseFileIoBackend(argv[i], globalValues.fileio))
+            {
+                std::cerr << "Error: Unknown file I/O backend \"" << argv[i] << "\"" << std::endl;
+                return true;
+            }
+        }
+        else if ((arg[0] == '-') && (arg.size() > 1))
+        {
+            std::string switches = arg.substr(1, arg.size() - 1);
+            bool exclusive_sw = false;
+
+            for (char c : switches)
+            {
+                if (c == 's' || c == 'o' || c == 'f')
+                {
+                    if (exclusive_sw)
+                    {
+                        std::cerr << "Error: Mutually exclusive switches combined" << std::endl;
+                        return true;
+                    }
+
+                    exclusive_sw = true;
+                    
+                    if (i + 1 >= argc)
+                    {
+                        std::cerr << "Error: Wrong number of arguments after -" << c << std::endl;
+                        return true;
+                    }
+
+                    ++i;
+
+                    if (c == 's')
+                    {
+                        if (ParseSize(argv[i], globalValues.budget))
+                        {
+                            std::cerr << "Error: Invalid size \"" << argv[i] << "\"" << std::endl;
+                            return true;
+                        }
+                    }
+                    else if (c == 'o')
+                    {
+                        globalValues.outDir = argv[i];
+                    }
+                    else
+                    {
+                        globalValues.name = argv[i];
+                    }
+                }
+                else if (c == 'w')
+                {
+                    globalValues.overwrite = true;
+                }
+                else if (c == 'n')
+                {
+                    globalValues.split = false;
+                }
+                else if (c == 'q')
+                {
+                    globalValues.quiet = true;
+                }
+                else if (c == 'h')
+                {
+                    globalValues.printhelp = true;
+                }
+            }
+        }
+        else
+        {
+            globalValues.inpath = arg;
+        }
+    }
+
+    return false;
+}
+
+// A number of bytes, optionally followed by K, M or G.
+bool ParseSize(const std::string &str, uint64_t &out)
+{
+    uint64_t value = 0;
+    size_t i = 0;
+
+    for (; i < str.size() && str[i] >= '0' && str[i] <= '9'; ++i)
+    {
+        value = value * 10 + (str[i] - '0');
+
+        if (value > 0xffffffff) return true;
+    }
+
+    if (i == 0) return true;
+
+    if (i + 1 == str.size())
+    {
+        switch (str[i])
+        {
+            case 'k': case 'K': value <<= 10; break;
+            case 'm': case 'M': value <<= 20; break;
+            case 'g': case 'G': value <<= 30; break;
+            default: return true;
+        }
+    }
+    else if (i != str.size())
+    {
+        return true;
+    }
+
+    out = value;
+    return false;
+}
+
+bool ReadPrespec(std::vector<FilePair> &filelist)
+{
+    std::ifstream psstream(globalValues.inpath);
+
+    if (!psstream.good())
+    {
+        std::cerr << "Error: Failed to open prespec file \"" << globalValues.inpath.string() << "\"" << std::endl;
+        return true;
+    }
+
+    std::string line;
+
+    while (psstream.good() && !psstream.eof())
+    {
+        if (ReadLine(psstream, line))
+        {
+            std::cerr << "Error: Failed to read prespec file" << std::endl;
+            return true;
+        }
+
+        std::filesystem::path filepath = line;
+
+        if (psstream.eof())
+        {
+            std::cerr << "Error: Disk path/internal path mismatch in prespec file" << std::endl;
+            return true;
+        }
+
+        if (ReadLine(psstream, line))
+        {
+            std::cerr << "Error: Failed to read prespec file" << std::endl;
+            return true;
+        }
+
+        filelist.push_back(FilePair(filepath, line));
+    }
+
+    return false;
+}
+
+bool ReadLine(std::ifstream &instream, std::string &outstr)
+{
+    bool line_ended = false;
+    outstr = "";
+
+    while (true)
+    {
+
+        if (instream.fail()) {return true;}
+
+        int p = instream.peek();
+
+        if (p == EOF)
+        {
+            break;
+        }
+        else if (static_cast<char>(p) == '\r' || static_cast<char>(p) == '\n')
+        {
+            line_ended = true;
+            instream.get();
+        }
+        else
+        {
+            if (line_ended) {break;}
+
+            outstr.push_back(instream.get());
+        }
+    }
+
+    return false;
+}
+
+// Walk the input pre file, loaded whole and by default through a memory map, copying each subfile straight out
+// of it. Mapped pages that have been copied are released as we go, so memory use doesn't grow with the size of
+// the input.
+bool SplitPre()
+{
+    FileSource infile;
+    std::vector<PreIndexEntry> index;
+
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+
+        if (infile.Open(globalValues.inpath) || infile.Load())
+        {
+            std::cerr << "Error: Failed to open \"" << globalValues.inpath.string() << "\"" << std::endl;
+            return true;
+        }
+    }
+
+    {
+        StatsTimer timer(StatsPhase::Parse);
+
+        if (ReadPreIndex(infile.Data(), infile.Size(), globalValues.inpath.string(), index)) return true;
+    }
+
+    for (const PreIndexEntry &entry : index)
+        archiveValues.unplaced += PaddedEntrySize(entry.subheader.pathSize, entry.payloadSize);
+
+    StatsAddRead(12);
+
+    for (const PreIndexEntry &entry : index)
+    {
+        StatsAddRead(16 + entry.subheader.pathSize);
+
+        if (PlaceSubFile(entry.subheader, entry.path, entry.payloadSize)) return true;
+
+        if (globalValues.split)
+        {
+            {
+                StatsTimer timer(StatsPhase::Write);
+                archiveValues.outfile.Stream().write(infile.Data() + entry.offset, entry.payloadSize);
+
+                if (archiveValues.outfile.Stream().fail())
+                {
+                    std::cerr << "Error: Failed to write sub file" << std::endl;
+                    return true;
+                }
+            }
+
+            StatsAddRead(entry.payloadSize);
+        }
+
+        infile.Release(entry.end);
+    }
+
+    return false;
+}
+
+// Files listed in a prespec are stored without compression, just like ug2-pre-pack does without -c.
+bool SplitPrespec()
+{
+    std::vector<FilePair> filelist;
+    std::vector<char> buffer;
+    const unsigned int chunksize = 1024 * 1024;
+
+    {
+        StatsTimer timer(StatsPhase::Parse);
+
+        if (ReadPrespec(filelist)) return true;
+    }
+
+    // Every file is checked before anything is written, and the sizes tell StartArchive() how big each archive
+    // will get.
+    std::vector<uint64_t> filesizes;
+
+    for (const FilePair &fp : filelist)
+    {
+        std::error_code ec;
+        uint64_t filesize;
+
+        // Files are copied as they are, so there's nothing to build a tex.xbx file from a filelist here.
+        if (fp.path.extension() == ".filelist")
+        {
+            std::cerr << "Error: \"" << fp.path.string() << "\" is a filelist, pack the prespec with ug2-pre-pack first" << std::endl;
+            return true;
+        }
+
+        {
+            StatsTimer timer(StatsPhase::Filesystem);
+            filesize = std::filesystem::file_size(fp.path, ec);
+        }
+
+        if (ec)
+        {
+            std::cerr << "Error: Failed to open \"" << fp.path.string() << "\"" << std::endl;
+            return true;
+        }
+
+        if (filesize > PreFieldMax)
+        {
+            std::cerr << "Error: \"" << fp.path.string() << "\" is too big for a pre file" << std::endl;
+            return true;
+        }
+
+        filesizes.push_back(filesize);
+        archiveValues.unplaced += PaddedEntrySize(fp.internal_path.size() + 4 - (fp.internal_path.size() % 4), filesize);
+    }
+
+    for (size_t i = 0; i < filelist.size(); ++i)
+    {
+        const FilePair &fp = filelist[i];
+        SubFileHeader subheader;
+        uint64_t filesize = filesizes[i];
+
+        // Even if the path string ends up being a multiple of 4 it still needs padding for the null at the end.
+        subheader.path.assign(fp.internal_path.begin(), fp.internal_path.end());
+        subheader.path.resize(fp.internal_path.size() + 4 - (fp.internal_path.size() % 4), 0);
+        subheader.pathSize = subheader.path.size();
+        subheader.pathCRC = StringCRC(fp.internal_path);
+        subheader.inflatedSize = filesize;
+        subheader.deflatedSize = 0;
+
+        if (PlaceSubFile(subheader, fp.internal_path, subheader.inflatedSize)) return true;
+
+        if (!globalValues.split) continue;
+
+        FileSource infile;
+        uint64_t remaining = filesize;
+        bool failed;
+
+        {
+            StatsTimer timer(StatsPhase::Filesystem);
+            failed = infile.Open(fp.path);
+        }
+
+        std::istream &instream = infile.Stream();
+
+        if (failed || !instream.good())
+        {
+            std::cerr << "Error: Failed to open \"" << fp.path.string() << "\"" << std::endl;
+            return true;
+        }
+
+        buffer.resize(chunksize);
+
+        while (remaining)
+        {
+            unsigned int count = (remaining < chunksize) ? remaining : chunksize;
+
+            {
+                StatsTimer timer(StatsPhase::Read);
+                instream.read(buffer.data(), count);
+
+                if (instream.fail() || instream.gcount() != count)
+                {
+                    std::cerr << "Error: Failed to read \"" << fp.path.string() << "\"" << std::endl;
+                    return true;
+                }
+
+                StatsAddRead(count);
+            }
+
+            {
+                StatsTimer timer(StatsPhase::Write);
+                archiveValues.outfile.Stream().write(buffer.data(), count);
+
+                if (archiveValues.outfile.Stream().fail())
+                {
+                    std::cerr << "Error: Failed to write sub file" << std::endl;
+                    return true;
+                }
+            }
+
+            remaining -= count;
+        }
+    }
+
+    return false;
+}
+
+// Find room for a subfile, starting the next archive if it doesn't fit in the current one, and write its
+// header. The previous subfile's padding is written here too, since it's only needed if something follows it.
+bool PlaceSubFile(const SubFileHeader &subheader, const std::string &path, uint64_t payloadSize)
+{
+    const char zeros[4] = {};
+    unsigned int pad = (archiveValues.size % 4) ? (4 - (archiveValues.size % 4)) : 0;
+    uint64_t entrySize = 16 + subheader.pathSize + payloadSize;
+
+    // Checked with the padding FinishArchive() adds after the last subfile, so no archive ends up over budget.
+    uint64_t paddedSize = PaddedEntrySize(subheader.pathSize, payloadSize);
+
+    if (12 + paddedSize > globalValues.budget)
+    {
+        std::cerr << "Error: \"" << path << "\" takes up " << paddedSize << " bytes, too many to fit in any pre file" << std::endl;
+        return true;
+    }
+
+    if (archiveValues.open && archiveValues.size + pad + paddedSize > globalValues.budget)
+    {
+        if (FinishArchive()) return true;
+
+        ++archiveValues.index;
+        pad = 0;
+    }
+
+    if (!archiveValues.open && StartArchive()) return true;
+
+    if (globalValues.split)
+    {
+        StatsTimer timer(StatsPhase::Write);
+        uint64_t written = 0;
+
+        archiveValues.outfile.Stream().write(zeros, pad);
+
+        if (archiveValues.outfile.Stream().fail())
+        {
+            std::cerr << "Error: Failed to pad sub file" << std::endl;
+            return true;
+        }
+
+        if (WriteSubFileHeader(archiveValues.outfile.Stream(), subheader, written))
+        {
+            std::cerr << "Error: Failed to write sub file header" << std::endl;
+            return true;
+        }
+    }
+
+    archiveValues.size += pad + entrySize;
+    archiveValues.unplaced -= std::min(archiveValues.unplaced, paddedSize);
+    archiveValues.numFiles++;
+    archiveValues.placements.push_back({archiveValues.index, path});
+    StatsAddEntries(1);
+
+    {
+        ReportRecord record("file");
+
+        record.Field("archive", archiveValues.names.back()).Field("internal_path", path);
+        record.Field("size", subheader.inflatedSize).Field("compressed_size", subheader.deflatedSize);
+        record.Text() << archiveValues.names.back() << ": " << path;
+    }
+
+    return false;
+}
+
+// How many bytes a subfile takes up in an archive, including the padding after it.
+uint64_t PaddedEntrySize(uint64_t pathSize, uint64_t payloadSize)
+{
+    uint64_t entrySize = 16 + pathSize + payloadSize;
+
+    return entrySize + ((entrySize % 4) ? (4 - (entrySize % 4)) : 0);
+}
+
+bool StartArchive()
+{
+    uint64_t written = 0;
+    archiveValues.names.push_back(globalValues.name + "_" + std::to_string(archiveValues.index) + ".pre");
+    archiveValues.path = globalValues.outDir / archiveValues.names.back();
+    archiveValues.size = 12;
+    archiveValues.numFiles = 0;
+    archiveValues.open = true;
+
+    if (!globalValues.split) return false;
+
+    StatsTimer timer(StatsPhase::Filesystem);
+
+    if (std::filesystem::exists(archiveValues.path) && !globalValues.overwrite)
+    {
+        std::cerr << "Error: file \"" << archiveValues.path.string() << "\" already exists and overwrite not enabled" << std::endl;
+        return true;
+    }
+
+    // Only set aside as much space as the subfiles left can fill, since the budget can be far more than that.
+    uint64_t sizehint = std::min(globalValues.budget, 12 + archiveValues.unplaced);
+
+    if (archiveValues.outfile.Create(archiveValues.path, sizehint))
+    {
+        std::cerr << "Error: Failed to create pre file \"" << archiveValues.path.string() << "\"" << std::endl;
+        return true;
+    }
+
+    // Filled in by FinishArchive().
+    if (WritePreHeader(archiveValues.outfile.Stream(), PreHeader(), written))
+    {
+        std::cerr << "Error: Failed to write pre file header" << std::endl;
+        return true;
+    }
+
+    return false;
+}
+
+bool FinishArchive()
+{
+    if (!archiveValues.open) return false;
+
+    const char zeros[4] = {};
+    unsigned int pad = (archiveValues.size % 4) ? (4 - (archiveValues.size % 4)) : 0;
+    PreHeader header;
+    uint64_t written = 0;
+
+    archiveValues.open = false;
+    archiveValues.size += pad;
+    header.size = archiveValues.size;
+    header.numFiles = archiveValues.numFiles;
+
+    if (globalValues.split)
+    {
+        StatsTimer timer(StatsPhase::Write);
+
+        archiveValues.outfile.Stream().write(zeros, pad);
+        archiveValues.outfile.Stream().seekp(0);
+
+        if (WritePreHeader(archiveValues.outfile.Stream(), header, written))
+        {
+            std::cerr << "Error: Failed to write pre file header" << std::endl;
+            return true;
+        }
+
+        if (archiveValues.outfile.Close())
+        {
+            std::cerr << "Error: Failed to write pre file \"" << archiveValues.path.string() << "\"" << std::endl;
+            return true;
+        }
+
+        StatsAddWritten(header.size);
+    }
+
+    ReportRecord record("archive");
+
+    record.Field("path", archiveValues.path.string()).Field("files", header.numFiles).Field("size", header.size);
+    record.Text() << archiveValues.path.string() << "\n";
+    record.Text() << "total files: " << header.numFiles << "\n";
+    record.Text() << "total size: " << header.size;
+
+    return false;
+}
+
+// The manifest is a text file with a version line, then one line per subfile in the original order:
+//
+//      [archive filename]\t[internal path]
+bool WriteManifest()
+{
+    std::filesystem::path manifestpath = globalValues.outDir / (globalValues.name + ".splitmanifest");
+    std::ofstream manifest;
+
+    StatsTimer timer(StatsPhase::Write);
+
+    if (std::filesystem::exists(manifestpath) && !globalValues.overwrite)
+    {
+        std::cerr << "Error: file \"" << manifestpath.string() << "\" already exists and overwrite not enabled" << std::endl;
+        return true;
+    }
+
+    manifest.open(manifestpath);
+
+    if (manifest.fail())
+    {
+        std::cerr << "Error: Failed to create manifest file \"" << manifestpath.string() << "\"" << std::endl;
+        return true;
+    }
+
+    manifest << "ug2-pre-split manifest 1\n";
+
+    for (const auto &placement : archiveValues.placements)
+    {
+        manifest << archiveValues.names[placement.first] << "\t" << placement.second << "\n";
+    }
+
+    manifest.close();
+
+    if (manifest.fail())
+    {
+        std::cerr << "Error: Failed to write manifest file \"" << manifestpath.string() << "\"" << std::endl;
+        return true;
+    }
+
+    return false;
+}
\ No newline at end of file
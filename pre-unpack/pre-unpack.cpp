@@ -18,40 +18,118 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
-#include "../common/pre_header.hpp"
-#include "../common/subfile_header.hpp"
-#include "../common/read_word.hpp"
+#include "../common/pre_file.hpp"
+#include "../common/lzss.hpp"
+#include "../common/tex_file.hpp"
+#include "../common/memory_stream.hpp"
+#include "../common/tar_file.hpp"
+#include "../common/std_stream.hpp"
+#include "../common/file_io.hpp"
+#include "../common/file_writer.hpp"
+#include "../common/hash.hpp"
+#include "../common/report.hpp"
+#include "../common/stats.hpp"
+#include "../common/trace.hpp"
 #include <fstream>
 #include <iostream>
 #include <iomanip>
 #include <sstream>
 #include <filesystem>
+#include <map>
+#include <algorithm>
+#include <ctype.h>
+#include <vector>
 
 struct
 {
     bool printhelp = false;
     bool unpack = true;
     bool quiet = false;
+    bool json = false;
     bool overwrite = false;
+    bool dedup = false;
+    bool textodds = false;
+    bool incremental = false;
     bool prespec = true;
     bool prespecfullpath = true;
+    bool analyze = false;
+    bool stats = false;
+    FileWriterBackend io = FileWriterBackend::Blocking;
+    FileIoBackend fileio = FileIoBackend::Stream;
+    std::filesystem::path statsjson;
+    std::filesystem::path tracepath;
+    std::filesystem::path tarpath;
     std::filesystem::path inpath;
     std::filesystem::path outDir;
 } globalValues;
 
+// Extracted files go through here, so that with --io uring many of them are written at once.
+FileWriter fileWriter;
+
+// Files written so far when deduplicating, by inflated size and content hash. 64 bits of hash on top of the
+// size makes a false match vanishingly unlikely, so contents aren't compared byte for byte.
+struct
+{
+    std::map<std::pair<uint64_t, uint64_t>, std::filesystem::path> written;
+    std::map<std::filesystem::path, std::pair<uint64_t, uint64_t>> contents;
+    unsigned int linkedFiles = 0;
+    uint64_t linkedBytes = 0;
+} dedupValues;
+
+// What was extracted last time, by filename, for --incremental. The raw size and hash are of the subfile as
+// stored in the archive, so an entry whose stored bytes haven't changed can be skipped without inflating it.
+struct ManifestEntry
+{
+    uint64_t size = 0;
+    uint64_t hash = 0;
+    uint64_t rawSize = 0;
+    uint64_t rawHash = 0;
+    int64_t modified = 0;
+};
+
+struct
+{
+    std::filesystem::path path;
+    std::map<std::string, ManifestEntry> previous;
+    std::map<std::string, ManifestEntry> current;
+    std::vector<std::pair<std::string, std::filesystem::path>> unstamped;
+    unsigned int unchanged = 0;
+    unsigned int written = 0;
+} manifestValues;
+
+struct SubFileAnalysis
+{
+    std::string path;
+    uint64_t inflatedSize;
+    uint64_t deflatedSize;
+    LzssStreamStats stream;
+};
+
 void PrintHelp();
 bool ReadArgs(int argc, char **argv);
-bool ReadHeader(std::ifstream &infile, PreHeader &outheader);
-bool ReadSubFileHeader(std::ifstream &infile, SubFileHeader &outsubheader);
-bool SkipSubFile(std::ifstream &infile, const SubFileHeader &subheader);
-bool ExtractSubFile(std::ifstream &infile, const SubFileHeader &subheader);
+bool SkipSubFile(std::istream &infile, const SubFileHeader &subheader);
+bool ReadSubFileData(std::istream &infile, const SubFileHeader &subheader, std::vector<char> &data);
+bool InflateSubFileData(const SubFileHeader &subheader, const std::vector<char> &deflated, std::vector<char> &inflated, LzssStreamStats *analysis);
+bool ExtractSubFile(std::istream &infile, const SubFileHeader &subheader, LzssStreamStats *analysis);
+bool StreamSubFile(std::istream &infile, const SubFileHeader &subheader, const std::string &path, std::ostream &tarstream, LzssStreamStats *analysis);
+bool IsTexFile(const std::string &filename);
+bool ExtractTexAsDds(std::istream &infile, const SubFileHeader &subheader, const std::string &filename, LzssStreamStats *analysis);
+bool AnalyzeSubFile(std::istream &infile, const SubFileHeader &subheader, LzssStreamStats &analysis);
+bool ReadManifest();
+bool WriteManifest();
+void PrintAnalysis(const std::vector<SubFileAnalysis> &analyses);
 
 int main(int argc, char **argv)
 {
     PreHeader header;
-    std::ifstream instream;
+    FileSource infile;
+    std::istream *instream;
+    std::filesystem::path inname;
     std::ofstream prespecstream;
+    FileSink tarfile;
+    std::ostream *tarstream = nullptr;
     std::filesystem::path workingdir;
+    std::vector<SubFileAnalysis> analyses;
 
     if (!(argc > 1))
     {
@@ -73,6 +151,23 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    ReportSetMode(globalValues.json ? ReportMode::JsonLines : (globalValues.quiet ? ReportMode::Quiet : ReportMode::Plain));
+
+    if (globalValues.stats || !globalValues.statsjson.empty()) StatsEnable();
+    if (!globalValues.tracepath.empty()) TraceEnable();
+
+    // Files from the last run are expected to be there.
+    if (globalValues.incremental) globalValues.overwrite = true;
+
+    SetFileIoBackend(globalValues.fileio);
+
+    if (fileWriter.SetBackend(globalValues.io))
+    {
+        std::cerr << "Error: io_uring isn't available here, use --io blocking" << std::endl;
+        std::cerr << "Unpacking failed." << std::endl;
+        return -1;
+    }
+
     if (globalValues.inpath.empty())
     {
         std::cerr << "Error: No input file" << std::endl;
@@ -80,20 +175,71 @@ int main(int argc, char **argv)
         return -1;
     }
 
-    instream.open(globalValues.inpath, instream.binary);
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+        infile.Open(globalValues.inpath);
+        instream = &infile.Stream();
+    }
 
-    if (!instream.good())
+    if (!instream->good())
     {
         std::cerr << "Error: Failed to open input file" << std::endl;
         std::cerr << "Unpacking failed." << std::endl;
         return -1;
     }
 
+    // The prespec and manifest are named after the input.
+    inname = IsStdStream(globalValues.inpath) ? std::filesystem::path("stdin") : globalValues.inpath.filename();
+
+    if (!globalValues.tarpath.empty() && globalValues.unpack)
+    {
+        if (globalValues.incremental || globalValues.dedup || globalValues.textodds)
+        {
+            std::cerr << "Error: --tar can't be combined with --incremental, --dedup or --tex-to-dds" << std::endl;
+            std::cerr << "Unpacking failed." << std::endl;
+            return -1;
+        }
+
+        // Nothing goes to the disk for a prespec to list.
+        globalValues.prespec = false;
+
+        StatsTimer timer(StatsPhase::Filesystem);
+
+        if (IsStdStream(globalValues.tarpath))
+        {
+            if (IsStdStream(globalValues.statsjson))
+            {
+                std::cerr << "Error: --stats-json can't write to stdout along with the tar stream" << std::endl;
+                std::cerr << "Unpacking failed." << std::endl;
+                return -1;
+            }
+
+            ReportSetStream(std::cerr);
+        }
+        else if (!globalValues.overwrite && std::filesystem::exists(globalValues.tarpath))
+        {
+            std::cerr << "Error: file \"" << globalValues.tarpath << "\" already exists and overwrite not enabled" << std::endl;
+            std::cerr << "Unpacking failed." << std::endl;
+            return -1;
+        }
+
+        if (tarfile.Create(globalValues.tarpath))
+        {
+            std::cerr << "Error: Failed to create tar file \"" << globalValues.tarpath.string() << "\"" << std::endl;
+            std::cerr << "Unpacking failed." << std::endl;
+            return -1;
+        }
+
+        tarstream = &tarfile.Stream();
+    }
+
     if (globalValues.prespec && globalValues.unpack)
     {
-        std::filesystem::path prespecpath = globalValues.outDir / globalValues.inpath.filename();
+        std::filesystem::path prespecpath = globalValues.outDir / inname;
         prespecpath.replace_extension("prespec");
 
+        StatsTimer timer(StatsPhase::Filesystem);
+
         if (!globalValues.overwrite && std::filesystem::exists(prespecpath))
         {
             std::cerr << "Error: file \"" << prespecpath << "\" already exists and overwrite not enabled" << std::endl;
@@ -113,22 +259,42 @@ int main(int argc, char **argv)
         workingdir = std::filesystem::current_path();
     }
 
-    if (ReadHeader(instream, header))
+    if (globalValues.incremental && globalValues.unpack)
     {
-        std::cerr << "Error: Failed to read pre/prx header" << std::endl;
-        std::cerr << "Unpacking failed." << std::endl;
-        return -1;
+        manifestValues.path = globalValues.outDir / inname;
+        manifestValues.path.replace_extension("manifest");
+
+        if (ReadManifest())
+        {
+            std::cerr << "Unpacking failed." << std::endl;
+            return -1;
+        }
+    }
+
+    {
+        StatsTimer timer(StatsPhase::Parse);
+
+        if (ReadPreHeader(*instream, header))
+        {
+            std::cerr << "Error: Failed to read pre/prx header" << std::endl;
+            std::cerr << "Unpacking failed." << std::endl;
+            return -1;
+        }
+
+        StatsAddRead(12);
     }
 
-    if (!globalValues.quiet)
     {
-        std::cout << std::endl;
-        std::cout << "Size: " << header.size << std::endl;
-        std::cout << "Version: " << header.version << std::endl;
-        std::cout << "Files: " << header.numFiles << std::endl;
-        std::cout << std::endl; 
-        std::cout << "Index | Inflated Size | Deflated Size | Path" << std::endl;
-        std::cout << std::endl;
+        ReportRecord record("archive");
+
+        record.Field("path", globalValues.inpath.string()).Field("size", header.size);
+        record.Field("version", header.version).Field("files", header.numFiles);
+        record.Text() << "\n";
+        record.Text() << "Size: " << header.size << "\n";
+        record.Text() << "Version: " << header.version << "\n";
+        record.Text() << "Files: " << header.numFiles << "\n";
+        record.Text() << "\n";
+        record.Text() << "Index | Inflated Size | Deflated Size | Path\n";
     }
 
     // Loop though the subfiles.
@@ -137,11 +303,18 @@ int main(int argc, char **argv)
         SubFileHeader subheader;
         std::string path;
 
-        if (ReadSubFileHeader(instream, subheader))
         {
-            std::cerr << "Error: Failed to read sub file header " << i << std::endl;
-            std::cerr << "Unpacking failed." << std::endl;
-            return -1;
+            StatsTimer timer(StatsPhase::Parse);
+            TraceSpan span("header");
+
+            if (ReadSubFileHeader(*instream, subheader))
+            {
+                std::cerr << "Error: Failed to read sub file header " << i << std::endl;
+                std::cerr << "Unpacking failed." << std::endl;
+                return -1;
+            }
+
+            StatsAddRead(16 + subheader.path.size());
         }
 
         for (char c : subheader.path)
@@ -150,14 +323,42 @@ int main(int argc, char **argv)
             path.push_back(c);
         }
 
-        if (!globalValues.quiet)
         {
-            std::cout << std::setw(3) << i << std::setw(10) << subheader.inflatedSize << " " << std::setw(10) << subheader.deflatedSize << std::setw(0) << " " << path << std::endl;
+            ReportRecord record("subfile");
+
+            record.Field("index", i).Field("inflated_size", subheader.inflatedSize);
+            record.Field("deflated_size", subheader.deflatedSize).Field("path", path);
+            record.Text() << std::setw(3) << i << std::setw(10) << subheader.inflatedSize << " " << std::setw(10) << subheader.deflatedSize << std::setw(0) << " " << path;
+        }
+
+        TraceSpan span("subfile", path);
+        LzssStreamStats *analysis = nullptr;
+
+        if (globalValues.analyze)
+        {
+            analyses.push_back({path, subheader.inflatedSize, subheader.deflatedSize, LzssStreamStats()});
+            analysis = &analyses.back().stream;
         }
 
-        if (globalValues.unpack)
+        if (tarstream)
+        {
+            if (StreamSubFile(*instream, subheader, path, *tarstream, analysis)) // Inflate the file into the tar stream.
+            {
+                std::cerr << "Unpacking failed." << std::endl;
+                return -1;
+            }
+        }
+        else if (globalValues.unpack)
+        {
+            if (ExtractSubFile(*instream, subheader, analysis)) // Inflate the file.
+            {
+                std::cerr << "Unpacking failed." << std::endl;
+                return -1;
+            }
+        }
+        else if (analysis)
         {
-            if (ExtractSubFile(instream, subheader)) // Inflate the file.
+            if (AnalyzeSubFile(*instream, subheader, *analysis)) // Inflate without writing anything.
             {
                 std::cerr << "Unpacking failed." << std::endl;
                 return -1;
@@ -165,13 +366,15 @@ int main(int argc, char **argv)
         }
         else
         {
-            if (SkipSubFile(instream, subheader)) // Or just jump to the next header if -n flag is set.
+            if (SkipSubFile(*instream, subheader)) // Or just jump to the next header if -n flag is set.
             {
                 std::cerr << "Unpacking failed." << std::endl;
                 return -1;
             }
         }
 
+        StatsAddEntries(1);
+
         if (globalValues.prespec && globalValues.unpack)
         {
             unsigned int slash_loc = 0;
@@ -201,15 +404,91 @@ int main(int argc, char **argv)
 
             filepath /= filename;
 
-            prespecstream << filepath.string() << std::endl;
-            prespecstream << internal_path << std::endl << std::endl;
+            // ug2-pre-pack builds the tex.xbx file back from the filelist.
+            if (globalValues.textodds && IsTexFile(filename)) filepath += ".filelist";
+
+            prespecstream << filepath.string() << "\n";
+            prespecstream << internal_path << "\n\n";
+        }
+    }
+
+    if (fileWriter.Flush())
+    {
+        std::cerr << "Unpacking failed." << std::endl;
+        return -1;
+    }
+
+    if (globalValues.prespec && globalValues.unpack)
+    {
+        prespecstream.close();
+
+        if (prespecstream.fail())
+        {
+            std::cerr << "Error: Failed to write prespec file" << std::endl;
+            std::cerr << "Unpacking failed." << std::endl;
+            return -1;
+        }
+    }
+
+    if (tarstream)
+    {
+        StatsTimer timer(StatsPhase::Write);
+
+        if (WriteTarEnd(*tarstream))
+        {
+            std::cerr << "Unpacking failed." << std::endl;
+            return -1;
+        }
+
+        if (tarfile.Close())
+        {
+            std::cerr << "Error: Failed to write tar file \"" << globalValues.tarpath.string() << "\"" << std::endl;
+            std::cerr << "Unpacking failed." << std::endl;
+            return -1;
+        }
+    }
+
+    if (globalValues.incremental && globalValues.unpack)
+    {
+        ReportRecord record("incremental");
+
+        if (WriteManifest())
+        {
+            std::cerr << "Unpacking failed." << std::endl;
+            return -1;
         }
+
+        record.Field("written", manifestValues.written).Field("unchanged", manifestValues.unchanged);
+        record.Text() << "Wrote " << manifestValues.written << " changed files, " << manifestValues.unchanged << " unchanged.";
     }
 
-    if (!globalValues.quiet)
+    if (globalValues.analyze) PrintAnalysis(analyses);
+
+    if (globalValues.dedup && globalValues.unpack)
+    {
+        ReportRecord record("dedup");
+
+        record.Field("linked_files", dedupValues.linkedFiles).Field("linked_bytes", dedupValues.linkedBytes);
+        record.Text() << "Linked " << dedupValues.linkedFiles << " duplicate files, " << dedupValues.linkedBytes << " bytes not written.";
+    }
+
+    ReportFlush();
+
+    if (globalValues.stats) StatsPrint((tarstream && IsStdStream(globalValues.tarpath)) ? std::cerr : std::cout);
+
+    if (!globalValues.statsjson.empty() && StatsWriteJson(globalValues.statsjson))
+    {
+        std::cerr << "Unpacking failed." << std::endl;
+        return -1;
+    }
+
+    if (!globalValues.tracepath.empty() && TraceWrite(globalValues.tracepath))
     {
-        std::cout << "Unpacking successful." << std::endl;
+        std::cerr << "Unpacking failed." << std::endl;
+        return -1;
     }
+
+    ReportRecord("result").Field("success", true).Text() << "Unpacking successful.";
     
     return 0;
 }
@@ -230,6 +509,22 @@ void PrintHelp()
     std::cout << "    -p              Disable prespec file generation." << std::endl;
     std::cout << "    -P              Disable absolute paths in prespec file." << std::endl;
     std::cout << "    -n              Don't extract files or generate prespec." << std::endl;
+    std::cout << "    --incremental   Only write files that changed since the last run, as recorded in a" << std::endl;
+    std::cout << "                    manifest file next to the prespec. Implies -w." << std::endl;
+    std::cout << "    --dedup         Write identical subfiles once and hard link the rest to it." << std::endl;
+    std::cout << "                    Editing one of the linked files changes all of them." << std::endl;
+    std::cout << "    --tex-to-dds    Convert tex.xbx files to dds files and a filelist, like ug2-tex2dds," << std::endl;
+    std::cout << "                    instead of extracting them." << std::endl;
+    std::cout << "    --tar FILE      Write the extracted files to a tar stream at FILE, or stdout if FILE" << std::endl;
+    std::cout << "                    is -, instead of to the disk. No prespec is written." << std::endl;
+    std::cout << "    --io BACKEND    Write files one at a time with blocking, the default, or many at once" << std::endl;
+    std::cout << "                    with uring. uring needs Linux 5.6 or later." << std::endl;
+    std::cout << "    --file-io BACKEND   Read and write files with stream, the default, mmap, pread or memory" << std::endl;
+    std::cout << "    --json          Print the listing and results as one JSON object per line" << std::endl;
+    std::cout << "    --analyze       Report literals, matches and compression ratio per subfile and extension" << std::endl;
+    std::cout << "    --stats         Print time spent in each phase, throughput and peak memory" << std::endl;
+    std::cout << "    --stats-json FILE   Write the same report as JSON to FILE, or stdout if FILE is -" << std::endl;
+    std::cout << "    --trace FILE    Write a timeline of each subfile in Chrome trace format to FILE" << std::endl;
 }
 
 bool ReadArgs(int argc, char **argv)
@@ -240,7 +535,96 @@ bool ReadArgs(int argc, char **argv)
     {
         arg = argv[i];
 
-        if ((arg[0] == '-') && (arg.size() > 1))
+        if (arg == "--json")
+        {
+            globalValues.json = true;
+        }
+        else if (arg == "--dedup")
+        {
+            globalValues.dedup = true;
+        }
+        else if (arg == "--tex-to-dds")
+        {
+            globalValues.textodds = true;
+        }
+        else if (arg == "--incremental")
+        {
+            globalValues.incremental = true;
+        }
+        else if (arg == "--analyze")
+        {
+            globalValues.analyze = true;
+        }
+        else if (arg == "--stats")
+        {
+            globalValues.stats = true;
+        }
+        else if (arg == "--tar")
+        {
+            if ((i + 1) >= argc)
+            {
+                std::cerr << "Error: No file provided after --tar argument" << std::endl;
+                return true;
+            }
+
+            i++;
+            globalValues.tarpath = argv[i];
+        }
+        else if (arg == "--io")
+        {
+            if ((i + 1) >= argc)
+            {
+                std::cerr << "Error: No backend provided after --io argument" << std::endl;
+                return true;
+            }
+
+            i++;
+
+            if (ParseFileWriterBackend(argv[i], globalValues.io))
+            {
+                std::cerr << "Error: Unknown I/O backend \"" << argv[i] << "\"" << std::endl;
+                return true;
+            }
+        }
+        else if (arg == "--file-io")
+        {
+            if ((i + 1) >= argc)
+            {
+                std::cerr << "Error: No backend provided after --file-io argument" << std::endl;
+                return true;
+            }
+
+            i++;
+
+            if (ParseFileIoBackend(argv[i], globalValues.fileio))
+            {
+                std::cerr << "Error: Unknown file I/O backend \"" << argv[i] << "\"" << std::endl;
+                return true;
+            }
+        }
+        else if (arg == "--stats-json")
+        {
+            if ((i + 1) >= argc)
+            {
+                std::cerr << "Error: No file provided after --stats-json argument" << std::endl;
+                return true;
+            }
+
+            i++;
+            globalValues.statsjson = argv[i];
+        }
+        else if (arg == "--trace")
+        {
+            if ((i + 1) >= argc)
+            {
+                std::cerr << "Error: No file provided after --trace argument" << std::endl;
+                return true;
+            }
+
+            i++;
+            globalValues.tracepath = argv[i];
+        }
+        else if ((arg[0] == '-') && (arg.size() > 1))
         {
             std::string switches = arg.substr(1, arg.size() - 1);
 
@@ -292,289 +676,733 @@ bool ReadArgs(int argc, char **argv)
     return false;
 }
 
-bool ReadHeader(std::ifstream &infile, PreHeader &outheader)
+bool SkipSubFile(std::istream &infile, const SubFileHeader &subheader)
 {
-    char bytes[12];
+    uint64_t skipCount;
+
+    if (subheader.deflatedSize == 0)
+    {
+        skipCount = subheader.inflatedSize;
+    }
+    else
+    {
+        skipCount = subheader.deflatedSize;
+    }
+
+    // Align the skip to a multiple of 4.
+    skipCount += (skipCount % 4) ? (4 - (skipCount % 4)) : 0;
 
-    infile.read(bytes, 12);
+    StatsTimer timer(StatsPhase::Read);
+    TraceSpan span("skip");
+    infile.ignore(skipCount);
+    StatsAddRead(infile.gcount());
 
-    if (!infile.good())
+    if (infile.fail() || static_cast<uint64_t>(infile.gcount()) != skipCount)
     {
+        std::cerr << "Error: Failed to skip sub file" << std::endl;
         return true;
     }
 
-    outheader.size = read_u32le(bytes);
-    outheader.version = read_u16le(&bytes[4]);
-    outheader.unknown = read_u16le(&bytes[6]);
-    outheader.numFiles = read_u32le(&bytes[8]);
-    
     return false;
 }
 
-bool ReadSubFileHeader(std::ifstream &infile, SubFileHeader &outsubheader)
+bool ReadSubFileData(std::istream &infile, const SubFileHeader &subheader, std::vector<char> &data)
 {
-    char bytes[16];
+    uint64_t readCount;
+    unsigned int padding;
+
+    StatsTimer timer(StatsPhase::Read);
+    TraceSpan span("read");
+
+    // Check if the subfile is compressed. Uncompressed files have a deflated
+    // size of 0.
+    readCount = (subheader.deflatedSize == 0) ? subheader.inflatedSize : subheader.deflatedSize;
 
-    infile.read(bytes, 16);
+    data.resize(readCount);
+    infile.read(data.data(), readCount);
 
-    if (!infile.good())
+    if (infile.fail() || static_cast<uint64_t>(infile.gcount()) != readCount)
     {
+        std::cerr << "Error: Failed to inflate subfile" << std::endl;
         return true;
     }
 
-    outsubheader.inflatedSize = read_u32le(bytes);
-    outsubheader.deflatedSize = read_u32le(&bytes[4]);
-    outsubheader.pathSize = read_u32le(&bytes[8]);
-    outsubheader.pathCRC = read_u32le(&bytes[12]);
-
-    outsubheader.path.resize(outsubheader.pathSize);
-    infile.read(reinterpret_cast<std::ifstream::char_type*>(&outsubheader.path.front()), outsubheader.pathSize);
-
-    // Just like every other section of a pre/prx file, the subfile headers are 4 byte aligned.
-    // However, the subfile path length includes the padding at the end, so we don't have to manually skip any
-    // bytes.
+    // Every section of a pre/prx file is aligned to 4 byte boundaries. If the subfile is not a multiple of 4
+    // bytes long we need to skip between 1 and 3 bytes to get to the next subfile's header.
+    
+    padding = (readCount % 4) ? (4 - (readCount % 4)) : 0;
 
-    if (infile.gcount() != outsubheader.pathSize)
+    for (unsigned int i = 0; i < padding; ++i)
     {
-        return true;
+        if (!infile.good())
+        {
+            std::cerr << "Error: Failed to pad subfile" << std::endl;
+            return true;
+        }
+
+        infile.get();
     }
 
+    StatsAddRead(readCount + padding);
+
     return false;
 }
 
-bool SkipSubFile(std::ifstream &infile, const SubFileHeader &subheader)
+bool InflateSubFileData(const SubFileHeader &subheader, const std::vector<char> &deflated, std::vector<char> &inflated, LzssStreamStats *analysis)
 {
-    unsigned int skipCount;
+    StatsTimer timer(StatsPhase::Inflate);
+    TraceSpan span("inflate");
+    bool failed;
 
-    if (subheader.deflatedSize == 0)
+    inflated.resize(subheader.inflatedSize);
+
+    if (analysis)
     {
-        skipCount = subheader.inflatedSize;
+        failed = LzssInflate(deflated.data(), deflated.size(), inflated.data(), inflated.size(), *analysis);
     }
     else
     {
-        skipCount = subheader.deflatedSize;
+        failed = LzssInflate(deflated.data(), deflated.size(), inflated.data(), inflated.size());
     }
 
-    // Align the skip to a multiple of 4.
-    skipCount += (skipCount % 4) ? (4 - (skipCount % 4)) : 0;
-
-    infile.ignore(skipCount);
-
-    if (infile.fail() || infile.gcount() != skipCount)
+    if (failed)
     {
-        std::cerr << "Error: Failed to skip sub file" << std::endl;
+        std::cerr << "Error: Failed to inflate subfile" << std::endl;
         return true;
     }
 
     return false;
 }
 
-bool ExtractSubFile(std::ifstream &infile, const SubFileHeader &subheader)
+// The entry for filename from the last run, if the file it describes is still there untouched.
+const ManifestEntry *FindUnchangedFile(const std::string &filename, const std::filesystem::path &outpath)
 {
-    std::ofstream outfile;
-    std::filesystem::path outpath;
-    std::string filename;
-    std::vector<char> buffer;
-    unsigned int buffer_pos = 0xfee;
-    unsigned int subfile_pos = 0;
-    unsigned int slash_loc = 0;
-    unsigned int null_loc = 0;
-    unsigned int readCount;
-    unsigned int padding;
-    
-    for (unsigned int i = 0; i < subheader.path.size(); ++i)
-    {
-        if (subheader.path[i] == '\\') {slash_loc = i;}
-    }
+    StatsTimer timer(StatsPhase::Filesystem);
+    auto found = manifestValues.previous.find(filename);
+    std::error_code error;
 
-    null_loc = subheader.path.size();
+    if (found == manifestValues.previous.end()) return nullptr;
 
-    for (int i = subheader.path.size() - 1; i >=0; --i)
-    {
-        if (subheader.path[i] == 0) {null_loc = i;}
-    }
+    uint64_t size = std::filesystem::file_size(outpath, error);
+    if (error || size != found->second.size) return nullptr;
 
-    for (unsigned int i = slash_loc + 1; i < null_loc; ++i)
-    {
+    auto modified = std::filesystem::last_write_time(outpath, error);
+    if (error || modified.time_since_epoch().count() != found->second.modified) return nullptr;
+
+    return &found->second;
+}
+
+// Note a file that was just written or linked in the manifest. One still waiting in fileWriter gets its
+// modified time once it's written, in WriteManifest().
+void RecordFile(const std::string &filename, const std::filesystem::path &outpath, ManifestEntry &entry)
+{
+    std::error_code error;
+
+    if (!globalValues.incremental) return;
+
+    if (fileWriter.Queued(outpath))
+    {
+        manifestValues.unstamped.push_back({filename, outpath});
+    }
+    else
+    {
+        entry.modified = std::filesystem::last_write_time(outpath, error).time_since_epoch().count();
+    }
+
+    manifestValues.current[filename] = entry;
+    manifestValues.written++;
+}
+
+// Carry over a file left as it was by the last run.
+void KeepFile(const std::string &filename, const std::filesystem::path &outpath, const ManifestEntry &entry)
+{
+    manifestValues.current[filename] = entry;
+    manifestValues.unchanged++;
+
+    if (globalValues.dedup)
+    {
+        std::pair<uint64_t, uint64_t> key(entry.size, entry.hash);
+
+        dedupValues.written.emplace(key, outpath);
+        dedupValues.contents[outpath] = key;
+    }
+}
+
+bool ExtractSubFile(std::istream &infile, const SubFileHeader &subheader, LzssStreamStats *analysis)
+{
+    std::filesystem::path outpath;
+    std::string filename;
+    std::vector<char> deflated;
+    std::vector<char> inflated;
+    unsigned int slash_loc = 0;
+    unsigned int null_loc = 0;
+    
+    for (unsigned int i = 0; i < subheader.path.size(); ++i)
+    {
+        if (subheader.path[i] == '\\') {slash_loc = i;}
+    }
+
+    null_loc = subheader.path.size();
+
+    for (int i = subheader.path.size() - 1; i >=0; --i)
+    {
+        if (subheader.path[i] == 0) {null_loc = i;}
+    }
+
+    for (unsigned int i = slash_loc + 1; i < null_loc; ++i)
+    {
         filename.push_back(subheader.path[i]);
     }
 
     outpath = globalValues.outDir / filename; 
 
-    // Check if the file already exists and fail if necessary.
-    if (!globalValues.overwrite && std::filesystem::exists(outpath))
+    if (globalValues.textodds && IsTexFile(filename))
     {
-        std::cerr << "Error: file \"" << outpath << "\" already exists and overwrite not enabled" << std::endl;
-        return true;
+        return ExtractTexAsDds(infile, subheader, filename, analysis);
+    }
+
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+
+        // Check if the file already exists and fail if necessary.
+        if (!globalValues.overwrite && (std::filesystem::exists(outpath) || fileWriter.Queued(outpath)))
+        {
+            std::cerr << "Error: file \"" << outpath << "\" already exists and overwrite not enabled" << std::endl;
+            return true;
+        }
     }
 
-    outfile.open(outpath, outfile.binary);
+    if (ReadSubFileData(infile, subheader, deflated)) return true;
 
-    if (outfile.fail())
+    ManifestEntry entry;
+    const ManifestEntry *previous = nullptr;
+
+    if (globalValues.incremental)
     {
-        std::cerr << "Error: Unable to create file \"" << outpath << "\"" << std::endl;
-        return true;
+        // The last run's file has to be looked at, not one on its way from this run.
+        if (fileWriter.Queued(outpath) && fileWriter.Flush()) return true;
+
+        entry.rawSize = deflated.size();
+        entry.rawHash = ContentHash(deflated.data(), deflated.size());
+        previous = FindUnchangedFile(filename, outpath);
+
+        // If the stored bytes are the same, so is what they inflate to. Still inflate them if they're being
+        // analyzed.
+        if (previous && !analysis && previous->rawSize == entry.rawSize && previous->rawHash == entry.rawHash)
+        {
+            KeepFile(filename, outpath, *previous);
+            return false;
+        }
     }
 
-    // Check if the subfile is compressed. Uncompressed files have a deflated
-    // size of 0.
-    if (subheader.deflatedSize == 0)
+    if (subheader.deflatedSize != 0)
     {
-        char c;
+        if (InflateSubFileData(subheader, deflated, inflated, analysis)) return true;
+    }
+
+    std::vector<char> &outdata = (subheader.deflatedSize == 0) ? deflated : inflated;
+
+    if (globalValues.incremental || globalValues.dedup)
+    {
+        entry.size = outdata.size();
+        entry.hash = ContentHash(outdata.data(), outdata.size());
+    }
+
+    if (previous && previous->size == entry.size && previous->hash == entry.hash)
+    {
+        entry.modified = previous->modified;
+        KeepFile(filename, outpath, entry);
+        return false;
+    }
+
+    if (globalValues.dedup)
+    {
+        std::pair<uint64_t, uint64_t> key(entry.size, entry.hash);
+        auto found = dedupValues.written.find(key);
+
+        if (found != dedupValues.written.end() && found->second == outpath)
+        {
+            // Same name and same contents as a file we already wrote, there's nothing to do.
+            RecordFile(filename, outpath, entry);
+            return false;
+        }
+
+        // Removing or linking to a file that's still to be written would go wrong.
+        bool pending = fileWriter.Queued(outpath) || (found != dedupValues.written.end() && fileWriter.Queued(found->second));
+
+        if (pending && fileWriter.Flush()) return true;
+
+        StatsTimer timer(StatsPhase::Filesystem);
+        TraceSpan span("dedup");
+        std::error_code error;
+
+        // Another subfile with the same name may have been written here, and may be linked to from elsewhere.
+        // Unlink it rather than write through it, and forget it so nothing else gets linked to it.
+        auto previous = dedupValues.contents.find(outpath);
+
+        if (previous != dedupValues.contents.end())
+        {
+            dedupValues.written.erase(previous->second);
+            dedupValues.contents.erase(previous);
+        }
 
-        readCount = subheader.inflatedSize;
+        std::filesystem::remove(outpath, error);
 
-        while (subfile_pos < readCount)
+        if (found != dedupValues.written.end())
         {
-            if (!infile.get(c))
+            std::filesystem::create_hard_link(found->second, outpath, error);
+
+            // Fall back to writing the file if the filesystem won't link it.
+            if (!error)
             {
-                std::cerr << "Error: Failed to inflate subfile" << std::endl;
-                return true;
+                dedupValues.linkedFiles++;
+                dedupValues.linkedBytes += outdata.size();
+                RecordFile(filename, outpath, entry);
+                return false;
             }
-            
-            outfile.put(c);
-            ++subfile_pos;
+        }
+        else
+        {
+            dedupValues.written.emplace(key, outpath);
+            dedupValues.contents.emplace(outpath, key);
         }
     }
-    else
+
+    if (fileWriter.Write(outpath, std::move(outdata))) return true;
+
+    RecordFile(filename, outpath, entry);
+
+    return false;
+}
+
+// Write a subfile into the tar stream under its internal path, with forward slashes so tar sees the directories.
+bool StreamSubFile(std::istream &infile, const SubFileHeader &subheader, const std::string &path, std::ostream &tarstream, LzssStreamStats *analysis)
+{
+    std::vector<char> deflated;
+    std::vector<char> inflated;
+    std::string name = path;
+
+    if (ReadSubFileData(infile, subheader, deflated)) return true;
+
+    if (subheader.deflatedSize != 0)
+    {
+        if (InflateSubFileData(subheader, deflated, inflated, analysis)) return true;
+    }
+
+    const std::vector<char> &data = (subheader.deflatedSize == 0) ? deflated : inflated;
+
+    std::replace(name.begin(), name.end(), '\\', '/');
+
+    StatsTimer timer(StatsPhase::Write);
+    TraceSpan span("write");
+
+    if (WriteTarFile(tarstream, name, data.data(), data.size())) return true;
+
+    StatsAddWritten(data.size());
+
+    return false;
+}
+
+bool IsTexFile(const std::string &filename)
+{
+    const std::string extension = ".tex.xbx";
+
+    if (filename.size() <= extension.size()) return false;
+
+    for (size_t i = 0; i < extension.size(); ++i)
+    {
+        if (tolower(filename[filename.size() - extension.size() + i]) != extension[i]) return false;
+    }
+
+    return true;
+}
+
+// Write the images of a tex.xbx subfile out as dds files straight from memory, along with a filelist, instead
+// of extracting the tex.xbx file for ug2-tex2dds to read back. Each line of the filelist has the image's
+// checksum after the path, separated by a tab, so ug2-dds2tex can rebuild the tex.xbx file without the original.
+bool ExtractTexAsDds(std::istream &infile, const SubFileHeader &subheader, const std::string &filename, LzssStreamStats *analysis)
+{
+    std::vector<char> deflated;
+    std::vector<char> inflated;
+    TexFileHeader header;
+    std::ofstream filelist;
+    std::filesystem::path filelistpath = globalValues.outDir / (filename + ".filelist");
+    std::string stem = filename.substr(0, filename.size() - 8); // Remove the .tex.xbx extensions.
+
+    if (ReadSubFileData(infile, subheader, deflated)) return true;
+
+    if (subheader.deflatedSize != 0)
     {
-        // pre/prx files use LZSS compression. Data is stored in groups starting with a type byte.
-        // Each 1 bit indicates a regular byte, while each 0 indicates a 2 byte offset/length pair.
-        // This means that each segment will be between 9 and 17 bytes.
-        //
-        //     Example:
-        //     
-        //     D - regular byte
-        //     L - offset/length low byte
-        //     H - offset/length high byte
-        //     
-        //     [01110111][D][D][D][L][H][D][D][D][L][H]
-        //
-        // The last segment will likely be shorter than 8 pieces. The deflatedSize in the header
-        // should be used to decide when to stop.
-        //
-        // The offset/length pairs contain a 12 bit offset and 4 bit length indicating a start point
-        // and run length to be read from the ring buffer. The offset is made from combining the low
-        // byte with the 4 high bits of the high byte:
-        //
-        //      o/l high  o/l low       offset
-        //     [hhhhxxxx][llllllll] -> [hhhhllllllll]
-        //
-        // The 4 low bits of the high byte are the number of bytes to read from the buffer. The actual
-        // length to read is the value of those bits + 3, meaning anywhere from 3 to 18.
-        //
-        // The buffer is a 4KiB ring buffer that starts being written to at offset 0xFEE (4078). Every
-        // byte written to the output file is also written to the buffer.
-
-        readCount = subheader.deflatedSize;
-        buffer.resize(4096);
-
-        while (subfile_pos < readCount)
-        {
-            char c;
-            unsigned char type_byte;
-
-            // Read the type byte of the next segment.
-            if (!infile.get(c))
+        if (InflateSubFileData(subheader, deflated, inflated, analysis)) return true;
+    }
+
+    const std::vector<char> &texdata = (subheader.deflatedSize == 0) ? deflated : inflated;
+    MemoryInStream instream(texdata.data(), texdata.size());
+
+    {
+        StatsTimer timer(StatsPhase::Parse);
+
+        if (ReadTexHeader(instream, header)) return true;
+    }
+
+    if (header.version != 1)
+    {
+        std::cerr << "Error: \"" << filename << "\" isn't a tex.xbx file" << std::endl;
+        return true;
+    }
+
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+
+        if (!globalValues.overwrite && std::filesystem::exists(filelistpath))
+        {
+            std::cerr << "Error: file \"" << filelistpath << "\" already exists and overwrite not enabled" << std::endl;
+            return true;
+        }
+
+        filelist.open(filelistpath);
+
+        if (filelist.fail())
+        {
+            std::cerr << "Error: Unable to create file \"" << filelistpath << "\"" << std::endl;
+            return true;
+        }
+    }
+
+    for (unsigned int i = 0; i < header.num_files; ++i)
+    {
+        TexImageHeader i_header;
+        FileSink outfile;
+        std::filesystem::path outpath = globalValues.outDir / (stem + "." + std::to_string(i) + ".dds");
+        uint64_t data_size;
+        bool dxt2;
+
+        {
+            StatsTimer timer(StatsPhase::Parse);
+
+            if (ReadImageHeader(instream, i_header)) return true;
+            if (CheckImageHeader(i_header, i, dxt2)) return true;
+        }
+
+        {
+            StatsTimer timer(StatsPhase::Filesystem);
+            TraceSpan span("open");
+
+            if (!globalValues.overwrite && std::filesystem::exists(outpath))
             {
-                std::cerr << "Error: Failed to inflate subfile" << std::endl;
+                std::cerr << "Error: file \"" << outpath << "\" already exists and overwrite not enabled" << std::endl;
                 return true;
             }
-            ++subfile_pos;
 
-            type_byte = static_cast<unsigned char>(c);
+            if (outfile.Create(outpath))
+            {
+                std::cerr << "Error: Unable to create file \"" << outpath << "\"" << std::endl;
+                return true;
+            }
+        }
+
+        {
+            StatsTimer timer(StatsPhase::Convert);
+            TraceSpan span("convert");
+
+            if (WriteDdsImage(instream, outfile.Stream(), i_header, data_size)) return true;
 
-            // Loop through the 8 pieces of the segment. Each of these is either a regular byte or an
-            // offset/length pair.
-            for (int i = 0; i < 8; ++i)
+            StatsAddWritten(data_size + 128);
+        }
+
+        {
+            StatsTimer timer(StatsPhase::Filesystem);
+            TraceSpan span("close");
+
+            if (outfile.Close())
             {
-                if ((type_byte >> i) & 0x1) // If this piece is a regular byte, just write it to the buffer and output file.
-                {
-                    
-                    // Check if we've hit the end of the compressed file data.
-                    if (subfile_pos >= readCount)
-                    {
-                        break;
-                    }
+                std::cerr << "Error: Failed to write file \"" << outpath << "\"" << std::endl;
+                return true;
+            }
+        }
 
-                    if (!infile.get(c))
-                    {
-                        std::cerr << "Error: Failed to inflate subfile" << std::endl;
-                        return true;
-                    }
-                    ++subfile_pos;
+        std::filesystem::path listedpath = globalValues.prespecfullpath ? std::filesystem::absolute(outpath) : outpath;
+        filelist << listedpath.string() << "\t0x" << std::hex << i_header.checksum << std::dec << "\n";
 
-                    buffer[buffer_pos] = c;
-                    buffer_pos = (buffer_pos + 1) % 4096; // Use mod 4096 to make sure we wrap around.
+        ReportRecord record("dds");
 
-                    outfile.put(c);
-                }
-                else // Otherwise, read the offset and length pair.
-                {
-                    unsigned char b0, b1;
-                    unsigned int offset;
-                    unsigned int count;
-                    
-                    // Check if we've hit the end of the compressed file data. 
-                    if (subfile_pos >= readCount)
-                    {
-                        break;
-                    }
-                    
-                    if (!infile.get(c))
-                    {
-                        std::cerr << "Error: Failed to inflate subfile" << std::endl;
-                        return true;
-                    }
-                    ++subfile_pos;
+        record.Field("path", outpath.string()).Field("index", i).Field("checksum", i_header.checksum);
+        record.Text() << "                         " << outpath.string();
+    }
 
-                    b0 = static_cast<unsigned char>(c);
+    filelist.close();
 
-                    if (!infile.get(c))
-                    {
-                        std::cerr << "Error: Failed to inflate subfile" << std::endl;
-                        return true;
-                    }
-                    ++subfile_pos;
+    if (filelist.fail())
+    {
+        std::cerr << "Error: Failed to write file \"" << filelistpath << "\"" << std::endl;
+        return true;
+    }
 
-                    b1 = static_cast<unsigned char>(c);
+    return false;
+}
 
-                    // Unpack the offset and length from the pair.
-                    offset = b0;
-                    offset |= static_cast<unsigned int>(b1 & 0xf0) << 4;
+bool AnalyzeSubFile(std::istream &infile, const SubFileHeader &subheader, LzssStreamStats &analysis)
+{
+    std::vector<char> deflated;
+    std::vector<char> inflated;
 
-                    count = (b1 & 0x0f) + 3;
+    if (ReadSubFileData(infile, subheader, deflated)) return true;
 
-                    // Read [count] bytes from the buffer starting at [offset], writing them to the
-                    // end of the buffer and the output file.
-                    for (unsigned int j = 0; j < count; ++j)
-                    {
-                        buffer[buffer_pos] = buffer[offset];
-                        buffer_pos = (buffer_pos + 1) % 4096; // Use mod 4096 to make sure we wrap around.
+    // Stored subfiles have nothing to count.
+    if (subheader.deflatedSize == 0) return false;
 
-                        outfile.put(buffer[offset]);
-                        offset = (offset + 1) % 4096;
-                    }
-                }
+    return InflateSubFileData(subheader, deflated, inflated, &analysis);
+}
+
+// The manifest is a text file with a version line, then one line per extracted file:
+//
+//      [size] [hash] [raw size] [raw hash] [modified time] [filename]
+//
+// Hashes are in hex, and the filename runs to the end of the line.
+
+bool ReadManifest()
+{
+    std::ifstream instream(manifestValues.path);
+    std::string line;
+
+    // No manifest just means everything gets written.
+    if (instream.fail()) return false;
+
+    std::getline(instream, line);
+
+    if (line != "ug2-pre-unpack manifest 1")
+    {
+        std::cerr << "Error: \"" << manifestValues.path.string() << "\" is not a manifest" << std::endl;
+        return true;
+    }
+
+    while (std::getline(instream, line))
+    {
+        std::istringstream linestream(line);
+        ManifestEntry entry;
+        std::string filename;
+
+        linestream >> entry.size >> std::hex >> entry.hash >> std::dec >> entry.rawSize >> std::hex >> entry.rawHash >> std::dec >> entry.modified;
+        linestream.get();
+        std::getline(linestream, filename);
+
+        if (linestream.fail() || filename.empty())
+        {
+            std::cerr << "Error: Malformed line in manifest \"" << manifestValues.path.string() << "\"" << std::endl;
+            return true;
+        }
+
+        manifestValues.previous[filename] = entry;
+    }
+
+    return false;
+}
+
+bool WriteManifest()
+{
+    std::filesystem::path temppath = manifestValues.path;
+    std::ofstream outstream;
+    std::error_code error;
+
+    // Files that were still queued when they were recorded are all written by now.
+    for (const auto &file : manifestValues.unstamped)
+    {
+        manifestValues.current[file.first].modified = std::filesystem::last_write_time(file.second, error).time_since_epoch().count();
+    }
+
+    // Write a new manifest next to the old one and swap it in, so a failed run never leaves half of one.
+    temppath += ".tmp";
+    outstream.open(temppath);
+
+    outstream << "ug2-pre-unpack manifest 1\n";
+
+    for (const auto &file : manifestValues.current)
+    {
+        const ManifestEntry &entry = file.second;
+
+        outstream << entry.size << " " << std::hex << entry.hash << std::dec << " " << entry.rawSize << " ";
+        outstream << std::hex << entry.rawHash << std::dec << " " << entry.modified << " " << file.first << "\n";
+    }
+
+    outstream.close();
+
+    if (outstream.fail())
+    {
+        std::cerr << "Error: Failed to write manifest \"" << temppath.string() << "\"" << std::endl;
+        return true;
+    }
+
+    std::filesystem::rename(temppath, manifestValues.path, error);
+
+    if (error)
+    {
+        std::cerr << "Error: Failed to replace manifest \"" << manifestValues.path.string() << "\"" << std::endl;
+        return true;
+    }
+
+    return false;
+}
+
+namespace
+{
+    struct ExtensionAnalysis
+    {
+        unsigned int files = 0;
+        uint64_t inflatedSize = 0;
+        uint64_t storedSize = 0;
+        LzssStreamStats stream;
+    };
+
+    // The extension of the filename, including a short alphabetic one in front of it so that "a.tex.xbx" and
+    // "a.col.xbx" are told apart.
+    std::string Extension(const std::string &path)
+    {
+        size_t slash = path.rfind('\\');
+        size_t start = (slash == std::string::npos) ? 0 : slash + 1;
+        size_t dot = path.rfind('.');
+
+        if (dot == std::string::npos || dot < start) return "(none)";
+
+        size_t inner = path.rfind('.', dot - 1);
+
+        if (inner != std::string::npos && inner >= start && dot - inner - 1 >= 1 && dot - inner - 1 <= 4)
+        {
+            bool alpha = true;
+
+            for (size_t i = inner + 1; i < dot; ++i)
+            {
+                if (!isalpha(static_cast<unsigned char>(path[i]))) alpha = false;
             }
+
+            if (alpha) dot = inner;
         }
+
+        return path.substr(dot);
     }
 
-    // Every section of a pre/prx file is aligned to 4 byte boundaries. If the subfile is not a multiple of 4
-    // bytes long we need to skip between 1 and 3 bytes to get to the next subfile's header.
-    
-    padding = (readCount % 4) ? (4 - (readCount % 4)) : 0;
+    double Ratio(uint64_t stored, uint64_t inflated)
+    {
+        return inflated ? 100.0 * stored / inflated : 0;
+    }
 
-    for (unsigned int i = 0; i < padding; ++i)
+    double AverageMatch(const LzssStreamStats &stream)
     {
-        if (!infile.good())
+        return stream.matches ? static_cast<double>(stream.match_bytes) / stream.matches : 0;
+    }
+
+    void PrintRatio(std::ostream &outstream, uint64_t stored, uint64_t inflated)
+    {
+        outstream << std::setw(8);
+
+        if (inflated)
         {
-            std::cerr << "Error: Failed to pad subfile" << std::endl;
-            return true;
+            outstream << std::fixed << std::setprecision(1) << Ratio(stored, inflated) << std::defaultfloat << "%";
+        }
+        else
+        {
+            outstream << "-" << " ";
         }
+    }
 
-        infile.get();
+    void PrintAverageMatch(std::ostream &outstream, const LzssStreamStats &stream)
+    {
+        outstream << std::setw(10);
+
+        if (stream.matches)
+        {
+            outstream << std::fixed << std::setprecision(2) << AverageMatch(stream) << std::defaultfloat;
+        }
+        else
+        {
+            outstream << "-";
+        }
     }
 
-    return false;
+    // Print the match length and distance histograms on their own lines, if there were any matches.
+    void PrintHistograms(std::ostream &outstream, const LzssStreamStats &stream)
+    {
+        if (!stream.matches) return;
+
+        outstream << "\n    match lengths:  ";
+
+        for (int j = 0; j < 16; ++j)
+        {
+            outstream << " " << j + 3 << ":" << stream.length_histogram[j];
+        }
+
+        outstream << "\n    distances:      ";
+
+        for (int j = 0; j < 16; ++j)
+        {
+            outstream << " " << j * 256 + 1 << "-" << (j + 1) * 256 << ":" << stream.distance_histogram[j];
+        }
+    }
+}
+
+void PrintAnalysis(const std::vector<SubFileAnalysis> &analyses)
+{
+    std::map<std::string, ExtensionAnalysis> extensions;
+
+    ReportRecord("analysis_header", true).Text() << "\nAnalysis:\n\nIndex |   Literals |    Matches | Avg Match |  Ratio | Path\n";
+
+    for (size_t i = 0; i < analyses.size(); ++i)
+    {
+        const SubFileAnalysis &analysis = analyses[i];
+        uint64_t stored = analysis.deflatedSize ? analysis.deflatedSize : analysis.inflatedSize;
+        ExtensionAnalysis &extension = extensions[Extension(analysis.path)];
+        ReportRecord record("subfile_analysis", true);
+        std::ostream &text = record.Text();
+
+        extension.files++;
+        extension.inflatedSize += analysis.inflatedSize;
+        extension.storedSize += stored;
+        extension.stream += analysis.stream;
+
+        record.Field("index", i).Field("path", analysis.path).Field("compressed", analysis.deflatedSize != 0);
+        record.Field("literals", analysis.stream.literals).Field("matches", analysis.stream.matches);
+        record.Field("average_match", AverageMatch(analysis.stream)).Field("ratio", Ratio(stored, analysis.inflatedSize));
+        record.Field("length_histogram", analysis.stream.length_histogram, 16).Field("distance_histogram", analysis.stream.distance_histogram, 16);
+
+        text << std::setw(5) << i;
+
+        if (analysis.deflatedSize)
+        {
+            text << std::setw(13) << analysis.stream.literals << std::setw(13) << analysis.stream.matches;
+        }
+        else
+        {
+            text << std::setw(13) << "stored" << std::setw(13) << "-";
+        }
+
+        PrintAverageMatch(text, analysis.stream);
+        PrintRatio(text, stored, analysis.inflatedSize);
+        text << " " << analysis.path;
+        PrintHistograms(text, analysis.stream);
+    }
+
+    ReportRecord("analysis_header", true).Text() << "\nExtension        | Files | Inflated Size |  Stored Size |  Ratio |   Literals |    Matches | Avg Match";
+
+    for (const auto &entry : extensions)
+    {
+        const ExtensionAnalysis &extension = entry.second;
+        const LzssStreamStats &stream = extension.stream;
+        ReportRecord record("extension_analysis", true);
+        std::ostream &text = record.Text();
+
+        record.Field("extension", entry.first).Field("files", extension.files);
+        record.Field("inflated_size", extension.inflatedSize).Field("stored_size", extension.storedSize);
+        record.Field("ratio", Ratio(extension.storedSize, extension.inflatedSize));
+        record.Field("literals", stream.literals).Field("matches", stream.matches).Field("average_match", AverageMatch(stream));
+        record.Field("length_histogram", stream.length_histogram, 16).Field("distance_histogram", stream.distance_histogram, 16);
+
+        text << "\n";
+        text << std::left << std::setw(16) << entry.first << std::right << std::setw(8) << extension.files;
+        text << std::setw(16) << extension.inflatedSize << std::setw(15) << extension.storedSize;
+        PrintRatio(text, extension.storedSize, extension.inflatedSize);
+        text << std::setw(13) << stream.literals << std::setw(13) << stream.matches;
+        PrintAverageMatch(text, stream);
+        PrintHistograms(text, stream);
+    }
+
+    ReportRecord("analysis_footer", true).Text();
 }
\ No newline at end of file
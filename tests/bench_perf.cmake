@@ -0,0 +1,20 @@
+# Run ug2-bench on the subfiles of a generated pre file and write its results to WORK_DIR/results.json. If
+# BASELINE is set, fail when any benchmark is more than MAX_SLOWDOWN percent slower than it. The corpus uses a
+# fixed seed, so results stay comparable between builds on the same machine.
+
+include (${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+file (REMOVE_RECURSE ${WORK_DIR})
+file (MAKE_DIRECTORY ${WORK_DIR})
+run (${GEN_CORPUS} -o ${WORK_DIR} -a 1 -e 64 -l -q)
+
+file (GLOB samples ${WORK_DIR}/corpus.0/*)
+
+set (compare)
+
+if (NOT BASELINE STREQUAL "")
+    set (compare -b ${BASELINE} -p ${MAX_SLOWDOWN})
+endif ()
+
+run (${BENCH} ${samples} -t ${SECONDS} -d ${WORK_DIR}/bench -j ${WORK_DIR}/results.json ${compare})
+message (STATUS "Wrote ${WORK_DIR}/results.json")
\ No newline at end of file
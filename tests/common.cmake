@@ -0,0 +1,92 @@
+# Helpers shared by the test scripts. Each script is run with cmake -P and fails the test with FATAL_ERROR.
+
+# Run a command and fail if it returns anything but 0.
+function (run)
+    execute_process (COMMAND ${ARGV} RESULT_VARIABLE result)
+
+    if (NOT result EQUAL 0)
+        string (REPLACE ";" " " command "${ARGV}")
+        message (FATAL_ERROR "Command returned ${result}: ${command}")
+    endif ()
+endfunction ()
+
+# Fail unless every file in EXPECTED has an identical copy in ACTUAL, and ACTUAL has no other files.
+function (compare_dirs expected actual)
+    file (GLOB expected_files RELATIVE ${expected} ${expected}/*)
+    file (GLOB actual_files RELATIVE ${actual} ${actual}/*)
+    list (LENGTH expected_files expected_count)
+    list (LENGTH actual_files actual_count)
+
+    if (expected_count EQUAL 0 OR NOT expected_count EQUAL actual_count)
+        message (FATAL_ERROR "Expected ${expected_count} files in ${actual}, found ${actual_count}")
+    endif ()
+
+    foreach (name ${expected_files})
+        compare_files (${expected}/${name} ${actual}/${name})
+    endforeach ()
+endfunction ()
+
+# Compare by hash, since starting cmake -E compare_files for each of hundreds of files is most of a test's run time.
+function (compare_files expected actual)
+    if (NOT EXISTS ${actual})
+        message (FATAL_ERROR "${actual} is missing")
+    endif ()
+
+    file (SHA256 ${expected} expected_hash)
+    file (SHA256 ${actual} actual_hash)
+
+    if (NOT expected_hash STREQUAL actual_hash)
+        message (FATAL_ERROR "${actual} differs from ${expected}")
+    endif ()
+endfunction ()
+
+# Run a command that should fail cleanly: return a nonzero exit code, not crash, and print MESSAGE to stderr.
+function (run_fails message)
+    execute_process (COMMAND ${ARGN} RESULT_VARIABLE result ERROR_VARIABLE errors OUTPUT_QUIET)
+    string (REPLACE ";" " " command "${ARGN}")
+
+    if (NOT result MATCHES "^[0-9]+$" OR result EQUAL 0)
+        message (FATAL_ERROR "Command returned ${result}, expected an error: ${command}")
+    endif ()
+
+    string (FIND "${errors}" "${message}" found)
+
+    if (found EQUAL -1)
+        message (FATAL_ERROR "Expected \"${message}\" from ${command}, got:\n${errors}")
+    endif ()
+endfunction ()
+
+# Append a tar header block to FILE. file () can't write nulls, so every field that would be null padded is
+# padded with spaces instead, which tar readers accept for numbers. SIZE is in octal, as in the header.
+function (append_tar_header file name size type)
+    string (REPEAT " " 100 padding)
+    string (SUBSTRING "${name}${padding}" 0 100 name_field)
+    string (SUBSTRING "${size}${padding}" 0 12 size_field)
+    string (REPEAT " " 24 ids)
+    string (REPEAT " " 12 mtime)
+    string (REPEAT " " 355 rest)
+
+    # The checksum is the sum of every byte in the header, with the checksum field itself counted as spaces.
+    set (block "${name_field}${ids}${size_field}${mtime}        ${type}${rest}")
+    string (HEX "${block}" hex)
+    string (LENGTH "${hex}" hex_length)
+    set (sum 0)
+
+    foreach (i RANGE 0 ${hex_length} 2)
+        if (i LESS hex_length)
+            string (SUBSTRING "${hex}" ${i} 2 byte)
+            math (EXPR sum "${sum} + 0x${byte}")
+        endif ()
+    endforeach ()
+
+    set (checksum "")
+
+    while (sum GREATER 0)
+        math (EXPR digit "${sum} % 8")
+        math (EXPR sum "${sum} / 8")
+        set (checksum "${digit}${checksum}")
+    endwhile ()
+
+    string (SUBSTRING "${checksum}        " 0 8 checksum_field)
+    file (APPEND ${file} "${name_field}${ids}${size_field}${mtime}${checksum_field}${type}${rest}")
+endfunction ()
\ No newline at end of file
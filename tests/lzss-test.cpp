@@ -0,0 +1,305 @@
+// Copyright (c) 2023 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include "../common/lzss.hpp"
+#include "../common/generate.hpp"
+
+// Round trip tests for the LZSS codec. The decoder doesn't keep a ring buffer, so it's checked against a plain
+// one that does it the way the game does: a zeroed 4KiB ring that starts being written at 0xFEE.
+
+const unsigned int ring_size = 4096;
+const unsigned int ring_start = 0xfee;
+
+void ReferenceInflate(const std::vector<unsigned char> &in, std::vector<char> &out);
+bool TestHandWritten();
+bool TestRandomStreams();
+bool TestRoundTrips();
+bool TestTruncated();
+
+int main()
+{
+    if (TestHandWritten() || TestRandomStreams() || TestRoundTrips() || TestTruncated())
+    {
+        std::cerr << "LZSS tests failed." << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+// Inflate the whole stream into out. Like the real decoder, a lone byte at the end is ignored.
+void ReferenceInflate(const std::vector<unsigned char> &in, std::vector<char> &out)
+{
+    std::vector<char> ring(ring_size);
+    unsigned int ring_pos = ring_start;
+    size_t in_pos = 0;
+
+    out.clear();
+
+    while (in_pos < in.size())
+    {
+        unsigned char type_byte = in[in_pos++];
+
+        for (int i = 0; (i < 8) && (in_pos < in.size()); ++i)
+        {
+            if ((type_byte >> i) & 0x1)
+            {
+                char c = static_cast<char>(in[in_pos++]);
+
+                out.push_back(c);
+                ring[ring_pos] = c;
+                ring_pos = (ring_pos + 1) & (ring_size - 1);
+            }
+            else
+            {
+                if (in.size() - in_pos < 2) return;
+
+                unsigned int offset = in[in_pos] | (static_cast<unsigned int>(in[in_pos + 1] & 0xf0) << 4);
+                unsigned int count = (in[in_pos + 1] & 0x0f) + 3;
+                in_pos += 2;
+
+                for (unsigned int j = 0; j < count; ++j)
+                {
+                    char c = ring[(offset + j) & (ring_size - 1)];
+
+                    out.push_back(c);
+                    ring[ring_pos] = c;
+                    ring_pos = (ring_pos + 1) & (ring_size - 1);
+                }
+            }
+        }
+    }
+}
+
+bool CheckInflate(const std::string &name, const std::vector<unsigned char> &in, const std::vector<char> &expected)
+{
+    const char *in_data = reinterpret_cast<const char*>(in.data());
+    std::vector<char> out(expected.size());
+    LzssStreamStats stats;
+
+    if (LzssInflate(in_data, in.size(), out.data(), out.size()) || (out != expected))
+    {
+        std::cerr << "Error: " << name << " doesn't inflate to the expected data" << std::endl;
+        return true;
+    }
+
+    std::fill(out.begin(), out.end(), 1);
+
+    if (LzssInflate(in_data, in.size(), out.data(), out.size(), stats) || (out != expected))
+    {
+        std::cerr << "Error: " << name << " doesn't inflate to the expected data when counting" << std::endl;
+        return true;
+    }
+
+    return false;
+}
+
+void PushPair(std::vector<unsigned char> &stream, unsigned int offset, unsigned int count)
+{
+    stream.push_back(offset & 0xff);
+    stream.push_back(((offset >> 4) & 0xf0) | (count - 3));
+}
+
+bool TestHandWritten()
+{
+    // Three literals, then a match starting 4 bytes before them in the zeroed ring that runs on into the byte
+    // it's writing, then a match at offset 0, which won't be written until output byte 18.
+    std::vector<unsigned char> before_start = {0x07, 'A', 'B', 'C'};
+    PushPair(before_start, 0xfea, 8);
+    PushPair(before_start, 0x000, 3);
+
+    std::vector<char> before_start_out = {'A', 'B', 'C', 0, 0, 0, 0, 'A', 'B', 'C', 0, 0, 0, 0};
+
+    // A zero match from the unwritten ring first, then literals repeated by a match overlapping its own output.
+    std::vector<unsigned char> overlap = {0x0e};
+    PushPair(overlap, 0x000, 4);
+    overlap.insert(overlap.end(), {'A', 'B', 'C'});
+    PushPair(overlap, 0xff2, 6);
+
+    std::vector<char> overlap_out = {0, 0, 0, 0, 'A', 'B', 'C', 'A', 'B', 'C', 'A', 'B', 'C'};
+
+    std::vector<char> reference;
+
+    ReferenceInflate(before_start, reference);
+
+    if (reference != before_start_out)
+    {
+        std::cerr << "Error: Reference decoder doesn't match the hand written streams" << std::endl;
+        return true;
+    }
+
+    ReferenceInflate(overlap, reference);
+
+    if (reference != overlap_out)
+    {
+        std::cerr << "Error: Reference decoder doesn't match the hand written streams" << std::endl;
+        return true;
+    }
+
+    return CheckInflate("Match before the start of the ring", before_start, before_start_out) || CheckInflate("Overlapping match", overlap, overlap_out);
+}
+
+// Streams of random literals and matches, long enough to wrap around the ring a few times. Most matches early on
+// land in the part of the ring that's still zeroed.
+bool TestRandomStreams()
+{
+    std::mt19937 rng(29);
+
+    for (unsigned int n = 0; n < 200; ++n)
+    {
+        std::vector<unsigned char> stream;
+        std::vector<char> expected;
+        unsigned int segments = 1 + rng() % 1500;
+
+        for (unsigned int s = 0; s < segments; ++s)
+        {
+            unsigned char type_byte = static_cast<unsigned char>(rng());
+
+            stream.push_back(type_byte);
+
+            for (int i = 0; i < 8; ++i)
+            {
+                if ((type_byte >> i) & 0x1)
+                {
+                    stream.push_back(static_cast<unsigned char>(rng()));
+                }
+                else
+                {
+                    PushPair(stream, rng() & (ring_size - 1), 3 + rng() % 16);
+                }
+            }
+        }
+
+        // Sometimes drop the last byte, which can leave half a pair at the end.
+        stream.resize(stream.size() - rng() % 2);
+        ReferenceInflate(stream, expected);
+
+        if (CheckInflate("Random stream " + std::to_string(n), stream, expected)) return true;
+    }
+
+    return false;
+}
+
+bool RoundTrip(const std::string &name, const std::vector<char> &data)
+{
+    std::vector<char> deflated;
+    std::vector<char> scalar_deflated;
+    std::vector<char> reference;
+
+    LzssDeflate(data.data(), data.size(), deflated);
+    LzssDeflate(data.data(), data.size(), scalar_deflated, LzssMatchFinder::Scalar);
+
+    if (deflated != scalar_deflated)
+    {
+        std::cerr << "Error: " << name << " deflates differently with the scalar match finder" << std::endl;
+        return true;
+    }
+
+    std::vector<unsigned char> stream(deflated.begin(), deflated.end());
+
+    ReferenceInflate(stream, reference);
+
+    if (reference != data)
+    {
+        std::cerr << "Error: " << name << " doesn't round trip through the reference decoder" << std::endl;
+        return true;
+    }
+
+    return CheckInflate(name, stream, data);
+}
+
+bool TestRoundTrips()
+{
+    std::mt19937 rng(29);
+    std::vector<char> data;
+
+    // A leading zero run should be matched against the zeroed ring from the first byte, and 4KiB of zeros takes
+    // 228 longest matches and their type bytes.
+    data.assign(4096, 0);
+
+    std::vector<char> deflated;
+    LzssDeflate(data.data(), data.size(), deflated);
+
+    if (deflated.empty() || (deflated[0] & 0x1) || (deflated.size() > 512))
+    {
+        std::cerr << "Error: Zeros aren't matched against the initial ring (" << deflated.size() << " bytes)" << std::endl;
+        return true;
+    }
+
+    if (RoundTrip("Zeros", data) || RoundTrip("Empty", {})) return true;
+
+    for (size_t size : {1, 2, 3, 17, 18, 19, 4077, 4078, 4079, 4096, 4097, 100000})
+    {
+        std::string suffix = " (" + std::to_string(size) + " bytes)";
+
+        GenerateData(rng, DataProfile::Sparse, size, data);
+        if (RoundTrip("Sparse" + suffix, data)) return true;
+
+        GenerateData(rng, DataProfile::Text, size, data);
+        if (RoundTrip("Text" + suffix, data)) return true;
+
+        // Text after a zero header, like many .col.xbx and tex files start.
+        data.insert(data.begin(), 300, 0);
+        if (RoundTrip("Zeros then text" + suffix, data)) return true;
+
+        GenerateData(rng, DataProfile::Noise, size, data);
+        if (RoundTrip("Noise" + suffix, data)) return true;
+    }
+
+    return false;
+}
+
+// Streams that end early, or are given the wrong inflated size, have to fail rather than leave part of the
+// output unwritten.
+bool TestTruncated()
+{
+    std::mt19937 rng(29);
+    std::vector<char> data;
+    std::vector<char> deflated;
+
+    GenerateData(rng, DataProfile::Sparse, 20000, data);
+    data.insert(data.begin(), 100, 0);
+    LzssDeflate(data.data(), data.size(), deflated);
+
+    std::vector<char> out(data.size() + 1);
+    LzssStreamStats stats;
+
+    for (size_t cut : {size_t(1), size_t(2), size_t(3), deflated.size() / 2, deflated.size() - 1})
+    {
+        if (!LzssInflate(deflated.data(), deflated.size() - cut, out.data(), data.size()) || !LzssInflate(deflated.data(), deflated.size() - cut, out.data(), data.size(), stats))
+        {
+            std::cerr << "Error: Stream cut short by " << cut << " bytes inflated without an error" << std::endl;
+            return true;
+        }
+    }
+
+    if (!LzssInflate(deflated.data(), deflated.size(), out.data(), data.size() + 1) || !LzssInflate(deflated.data(), deflated.size(), out.data(), data.size() - 1))
+    {
+        std::cerr << "Error: Stream inflated to the wrong size without an error" << std::endl;
+        return true;
+    }
+
+    return false;
+}
\ No newline at end of file
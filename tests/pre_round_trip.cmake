@@ -0,0 +1,64 @@
+# Pack the subfiles of a generated pre file with ug2-pre-pack, plain, compressed and on several threads, then
+# extract them again with ug2-pre-unpack through every --file-io backend and check they come back unchanged. The
+# generated pre file itself is extracted too, so the decoder is checked against the generator's compressor.
+# Last, the subfiles go through a tar stream, and tar streams with impossible sizes have to be rejected.
+
+include (${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+file (REMOVE_RECURSE ${WORK_DIR})
+file (MAKE_DIRECTORY ${WORK_DIR})
+run (${GEN_CORPUS} -o ${WORK_DIR} -a 1 -e 96 -l -q)
+
+set (subfiles ${WORK_DIR}/corpus.0)
+
+file (MAKE_DIRECTORY ${WORK_DIR}/generated)
+run (${PRE_UNPACK} ${WORK_DIR}/corpus.0.pre -o ${WORK_DIR}/generated -p -q)
+compare_dirs (${subfiles} ${WORK_DIR}/generated)
+
+foreach (mode plain compressed threaded)
+    if (mode STREQUAL "plain")
+        set (flags)
+    elseif (mode STREQUAL "compressed")
+        set (flags -c)
+    else ()
+        set (flags -c -j 4)
+    endif ()
+
+    run (${PRE_PACK} ${WORK_DIR}/corpus.0.prespec -o ${WORK_DIR}/${mode}.pre -q ${flags})
+
+    foreach (backend stream mmap pread memory)
+        set (outdir ${WORK_DIR}/${mode}-${backend})
+        file (MAKE_DIRECTORY ${outdir})
+        run (${PRE_UNPACK} ${WORK_DIR}/${mode}.pre -o ${outdir} -p -q --file-io ${backend})
+        compare_dirs (${subfiles} ${outdir})
+    endforeach ()
+endforeach ()
+
+# Through a tar stream and back.
+set (outdir ${WORK_DIR}/tar)
+file (MAKE_DIRECTORY ${outdir})
+run (${PRE_UNPACK} ${WORK_DIR}/corpus.0.pre --tar ${WORK_DIR}/corpus.0.tar -q)
+run (${PRE_PACK} --tar ${WORK_DIR}/corpus.0.tar -o ${WORK_DIR}/tar.pre -c -q)
+run (${PRE_UNPACK} ${WORK_DIR}/tar.pre -o ${outdir} -p -q)
+compare_dirs (${subfiles} ${outdir})
+
+# Broken tar streams have to fail with an error, and without trying to allocate whatever size they claim first.
+string (REPEAT "x" 100 data)
+
+set (tarfile ${WORK_DIR}/huge.tar)
+file (REMOVE ${tarfile})
+append_tar_header (${tarfile} huge 77777777777 0)
+file (APPEND ${tarfile} ${data})
+run_fails ("too big for a pre file" ${PRE_PACK} --tar ${tarfile} -n -q)
+
+set (tarfile ${WORK_DIR}/truncated.tar)
+file (REMOVE ${tarfile})
+append_tar_header (${tarfile} truncated 1750 0)
+file (APPEND ${tarfile} ${data})
+run_fails ("Failed to read tar data" ${PRE_PACK} --tar ${tarfile} -n -q)
+
+set (tarfile ${WORK_DIR}/longname.tar)
+file (REMOVE ${tarfile})
+append_tar_header (${tarfile} ././@LongLink 7777777777 L)
+file (APPEND ${tarfile} ${data})
+run_fails ("Tar long name" ${PRE_PACK} --tar ${tarfile} -n -q)
\ No newline at end of file
@@ -0,0 +1,47 @@
+# Split a generated pre file with ug2-pre-split under a size limit that isn't a multiple of 4, check no part goes
+# over it, and extract the parts to check every subfile made it through unchanged. Then split two tiny files
+# whose padding alone would take a single archive over the limit.
+
+include (${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+# Fail unless every pre file in DIR is at most LIMIT bytes, and there are COUNT of them if COUNT isn't 0.
+function (check_parts dir limit count)
+    file (GLOB parts ${dir}/*.pre)
+    list (LENGTH parts found)
+
+    if (found EQUAL 0 OR (NOT count EQUAL 0 AND NOT found EQUAL count))
+        message (FATAL_ERROR "Expected ${count} pre files in ${dir}, found ${found}")
+    endif ()
+
+    foreach (part ${parts})
+        file (SIZE ${part} size)
+
+        if (size GREATER limit)
+            message (FATAL_ERROR "${part} is ${size} bytes, over the limit of ${limit}")
+        endif ()
+    endforeach ()
+endfunction ()
+
+file (REMOVE_RECURSE ${WORK_DIR})
+file (MAKE_DIRECTORY ${WORK_DIR}/parts ${WORK_DIR}/out)
+run (${GEN_CORPUS} -o ${WORK_DIR} -a 1 -e 96 -l -q)
+
+run (${PRE_SPLIT} ${WORK_DIR}/corpus.0.pre -s 200001 -o ${WORK_DIR}/parts -q)
+check_parts (${WORK_DIR}/parts 200001 0)
+
+file (GLOB parts ${WORK_DIR}/parts/*.pre)
+
+foreach (part ${parts})
+    run (${PRE_UNPACK} ${part} -o ${WORK_DIR}/out -p -q)
+endforeach ()
+
+compare_dirs (${WORK_DIR}/corpus.0 ${WORK_DIR}/out)
+
+# Each of these is 33 bytes in a pre file of its own, or 36 padded, so two don't fit in 59.
+file (MAKE_DIRECTORY ${WORK_DIR}/tiny ${WORK_DIR}/tiny-parts)
+file (WRITE ${WORK_DIR}/tiny/a "a")
+file (WRITE ${WORK_DIR}/tiny/b "b")
+file (WRITE ${WORK_DIR}/tiny.prespec "${WORK_DIR}/tiny/a\na\n\n${WORK_DIR}/tiny/b\nb\n")
+
+run (${PRE_SPLIT} ${WORK_DIR}/tiny.prespec -s 59 -o ${WORK_DIR}/tiny-parts -q)
+check_parts (${WORK_DIR}/tiny-parts 59 2)
\ No newline at end of file
@@ -0,0 +1,17 @@
+# Extract generated tex.xbx files with ug2-tex2dds, pack the dds files back with ug2-dds2tex using the filelists
+# and checksums of the originals, and check the results match the originals byte for byte.
+
+include (${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+file (REMOVE_RECURSE ${WORK_DIR})
+file (MAKE_DIRECTORY ${WORK_DIR}/tex ${WORK_DIR}/dds ${WORK_DIR}/out)
+run (${GEN_CORPUS} -o ${WORK_DIR}/tex -a 0 -t 4 -i 8 -q)
+
+file (GLOB texfiles RELATIVE ${WORK_DIR}/tex ${WORK_DIR}/tex/*.tex.xbx)
+
+foreach (name ${texfiles})
+    run (${TEX2DDS} ${WORK_DIR}/tex/${name} -o ${WORK_DIR}/dds -q)
+    run (${DDS2TEX} ${WORK_DIR}/out/${name} -l ${WORK_DIR}/dds/${name}.filelist -c ${WORK_DIR}/tex/${name} -q)
+endforeach ()
+
+compare_dirs (${WORK_DIR}/tex ${WORK_DIR}/out)
\ No newline at end of file
@@ -23,12 +23,12 @@
 #include <filesystem>
 #include <iostream>
 #include <iomanip>
-#include <memory>
-#include <algorithm>
-#include "../common/read_word.hpp"
-#include "../common/write_word.hpp"
-#include "../common/dds_header.hpp"
-#include "../common/tex_header.hpp"
+#include "../common/tex_file.hpp"
+#include "../common/std_stream.hpp"
+#include "../common/file_io.hpp"
+#include "../common/report.hpp"
+#include "../common/stats.hpp"
+#include "../common/trace.hpp"
 
 struct
 {
@@ -36,27 +36,26 @@ struct
     std::filesystem::path out_dir;
     std::filesystem::path filename;
     bool quiet = false;
+    bool json = false;
     bool write = true;
     bool overwrite = false;
     bool printhelp = false;
     bool filelist = true;
     bool filelist_fullpath = true;
+    bool stats = false;
+    FileIoBackend file_io = FileIoBackend::Stream;
+    std::filesystem::path stats_json;
+    std::filesystem::path trace_path;
 } options;
 
 void PrintHelp();
 bool ReadArgs(int argc, char **argv);
-bool ReadFileHeader(std::ifstream &in_stream, TexFileHeader &out_header);
-bool ReadImageHeader(std::ifstream &in_stream, TexImageHeader &out_header);
-bool ReadImageLevelSize(std::ifstream &in_stream, uint32_t &out_size);
-bool SkipImageLevel(std::ifstream &in_stream, unsigned int size);
-bool ReadImageLevel(std::ifstream &in_stream, std::ofstream &out_stream, unsigned int size);
-bool WriteDdsHeader(std::ofstream &out_stream, const DdsFileHeader &dds_header);
-void BuildDdsHeader(const TexImageHeader &i_header, DdsFileHeader &dds_header);
-bool ReadImage(std::ifstream &in_stream, unsigned int index, std::ofstream &filelist_stream);
+bool ReadImage(std::istream &in_stream, unsigned int index, std::ofstream &filelist_stream, ReportRecord &record);
 
 int main(int argc, char **argv)
 {
-    std::ifstream in_stream;
+    FileSource in_file;
+    std::istream *in_stream;
     std::ofstream filelist_stream;
     TexFileHeader header;
 
@@ -80,6 +79,13 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    ReportSetMode(options.json ? ReportMode::JsonLines : (options.quiet ? ReportMode::Quiet : ReportMode::Plain));
+
+    if (options.stats || !options.stats_json.empty()) StatsEnable();
+    if (!options.trace_path.empty()) TraceEnable();
+
+    SetFileIoBackend(options.file_io);
+
     if (options.in_path.empty())
     {
         std::cerr << "Error: No input file" << std::endl;
@@ -87,24 +93,32 @@ int main(int argc, char **argv)
         return -1;
     }
     
-    in_stream.open(options.in_path);
+    // Output files are named after the input, and stdin has no name.
+    if (IsStdStream(options.in_path) && options.filename.empty()) options.filename = "stdin";
+
+    {
+        StatsTimer timer(StatsPhase::Filesystem);
+        in_file.Open(options.in_path);
+        in_stream = &in_file.Stream();
+    }
 
-    if (in_stream.fail())
+    if (in_stream->fail())
     {
         std::cerr << "Couldn't open file \"" << options.in_path.string() << "\"" << std::endl;
         std::cerr << "Unpack failed." << std::endl;
         return -1;
     }
 
-    if (!options.quiet)
     {
-        std::cout << "file: " << options.in_path.string() << std::endl;
-    }
+        StatsTimer timer(StatsPhase::Parse);
 
-    if (ReadFileHeader(in_stream, header))
-    {
-        std::cerr << "Unpack failed." << std::endl;
-        return -1;
+        if (ReadTexHeader(*in_stream, header))
+        {
+            std::cerr << "Unpack failed." << std::endl;
+            return -1;
+        }
+
+        StatsAddRead(8);
     }
 
     if (header.version != 1)
@@ -114,10 +128,13 @@ int main(int argc, char **argv)
         return -1;
     }
 
-    if (!options.quiet)
     {
-        std::cout << "images: " << header.num_files << std::endl << std::endl;
-        std::cout << "index | checksum | mipmap levels | dxt version | dimensions" << std::endl << std::endl;
+        ReportRecord record("tex");
+
+        record.Field("path", options.in_path.string()).Field("images", header.num_files);
+        record.Text() << "file: " << options.in_path.string() << "\n";
+        record.Text() << "images: " << header.num_files << "\n\n";
+        record.Text() << "index | checksum | mipmap levels | dxt version | dimensions\n";
     }
 
     // A tex file has the layout:
@@ -143,8 +160,9 @@ int main(int argc, char **argv)
 
     if (options.filelist)
     {
+        StatsTimer timer(StatsPhase::Filesystem);
         std::filesystem::path filelist_path = options.out_dir;
-        filelist_path /= options.in_path.filename();
+        filelist_path /= IsStdStream(options.in_path) ? options.filename : options.in_path.filename();
         filelist_path += ".filelist";
         
         if (std::filesystem::exists(filelist_path) && !options.overwrite)
@@ -167,14 +185,48 @@ int main(int argc, char **argv)
     for (unsigned int i = 0; i < header.num_files; ++i)
     {
         int w = (header.num_files > 9) ? 2 : 1;
+        ReportRecord record("image");
+
+        record.Field("index", i);
+        record.Text() << std::setw(w) << std::left <<  i << std::setw(0) << " ";
 
-        if (!options.quiet) std::cout << std::setw(w) << std::left <<  i << std::setw(0) << " ";
+        TraceSpan span("image", std::to_string(i));
         
-        if (ReadImage(in_stream, i, filelist_stream))
+        if (ReadImage(*in_stream, i, filelist_stream, record))
         {
             std::cerr << "Unpack failed." << std::endl;
             return -1;
         }
+
+        StatsAddEntries(1);
+    }
+
+    if (options.filelist)
+    {
+        filelist_stream.close();
+
+        if (filelist_stream.fail())
+        {
+            std::cerr << "Error: Failed to write to filelist" << std::endl;
+            std::cerr << "Unpack failed." << std::endl;
+            return -1;
+        }
+    }
+
+    ReportFlush();
+
+    if (options.stats) StatsPrint(std::cout);
+
+    if (!options.stats_json.empty() && StatsWriteJson(options.stats_json))
+    {
+        std::cerr << "Unpack failed." << std::endl;
+        return -1;
+    }
+
+    if (!options.trace_path.empty() && TraceWrite(options.trace_path))
+    {
+        std::cerr << "Unpack failed." << std::endl;
+        return -1;
     }
     
     return 0;
@@ -196,6 +248,11 @@ void PrintHelp()
     std::cout << "    -n                          Don't create dds files, just list the contents of the tex file." << std::endl;
     std::cout << "    -l                          Disable generation of filelist." << std::endl;
     std::cout << "    -L                          Use relative paths in filelist." << std::endl;
+    std::cout << "    --file-io BACKEND           Read and write files with stream, the default, mmap, pread or memory." << std::endl;
+    std::cout << "    --json                      Print the listing as one JSON object per line." << std::endl;
+    std::cout << "    --stats                     Print time spent in each phase, throughput and peak memory." << std::endl;
+    std::cout << "    --stats-json FILE           Write the same report as JSON to FILE, or stdout if FILE is -." << std::endl;
+    std::cout << "    --trace FILE                Write a timeline of each image in Chrome trace format to FILE." << std::endl;
 }
 
 bool ReadArgs(int argc, char **argv)
@@ -206,7 +263,53 @@ bool ReadArgs(int argc, char **argv)
     {
         arg = argv[i];
 
-        if ((arg[0] == '-') && (arg.size() > 1))
+        if (arg == "--json")
+        {
+            options.json = true;
+        }
+        else if (arg == "--stats")
+        {
+            options.stats = true;
+        }
+        else if (arg == "--stats-json")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: Wrong number of arguments after --stats-json" << std::endl;
+                return true;
+            }
+
+            ++i;
+            options.stats_json = argv[i];
+        }
+        else if (arg == "--file-io")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: Wrong number of arguments after --file-io" << std::endl;
+                return true;
+            }
+
+            ++i;
+
+            if (ParseFileIoBackend(argv[i], options.file_io))
+            {
+                std::cerr << "Error: Unknown file I/O backend \"" << argv[i] << "\"" << std::endl;
+                return true;
+            }
+        }
+        else if (arg == "--trace")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: Wrong number of arguments after --trace" << std::endl;
+                return true;
+            }
+
+            ++i;
+            options.trace_path = argv[i];
+        }
+        else if ((arg[0] == '-') && (arg.size() > 1))
         {
             std::string switches = arg.substr(1, arg.size() - 1);
             bool exclusive_sw = false;
@@ -286,184 +389,7 @@ bool ReadArgs(int argc, char **argv)
     return false;
 }
 
-bool ReadFileHeader(std::ifstream &in_stream, TexFileHeader &out_header)
-{
-    char buffer[8];
-
-    in_stream.read(buffer, 8);
-
-    if (in_stream.fail() || in_stream.gcount() != 8)
-    {
-        std::cerr << "Error: Failed to read file header" << std::endl;
-        return true;
-    }
-
-    out_header.version = read_u32le(&buffer[0]);
-    out_header.num_files = read_u32le(&buffer[4]);
-
-    return false;
-}
-
-bool ReadImageHeader(std::ifstream &in_stream, TexImageHeader &out_header)
-{
-    char buffer[36];
-
-    in_stream.read(buffer, 36);
-
-    if (in_stream.fail() || in_stream.gcount() != 36)
-    {
-        std::cerr << "Error: Failed to read image header" << std::endl;
-        return true;
-    }
-
-    out_header.checksum = read_u32le(buffer + 0);
-    out_header.width = read_u32le(buffer + 4);
-    out_header.height = read_u32le(buffer + 8);
-    out_header.levels = read_u32le(buffer + 12);
-    out_header.dxt = read_u32le(buffer + 24);
-    out_header.size = read_u32le(buffer + 32);
-
-    return false;
-}
-
-bool ReadImageLevelSize(std::ifstream &in_stream, uint32_t &out_size)
-{
-    char size_buffer[4];
-    
-    in_stream.read(size_buffer, 4);
-
-    if (in_stream.fail() || in_stream.gcount() != 4)
-    {
-        std::cerr << "Error: Failed to read mipmap level size" << std::endl;
-        return true;
-    }
-
-    out_size = read_u32le(size_buffer);
-
-    return false;
-}
-
-bool SkipImageLevel(std::ifstream &in_stream, unsigned int size)
-{
-    in_stream.ignore(size);
-
-    if (in_stream.fail() || in_stream.gcount() != size)
-    {
-        std::cerr << "Error: Failed to skip image data" << std::endl;
-        return true;
-    }
-
-    return false;
-}
-
-bool ReadImageLevel(std::ifstream &in_stream, std::ofstream &out_stream, unsigned int size)
-{
-    auto data_buffer = std::make_unique<char[]>(1024);
-    unsigned int pos = 0;
-
-    while (pos < size)
-    {
-        unsigned int read_count = (size - pos > 1024) ? 1024 : (size - pos);
-        
-        in_stream.read(data_buffer.get(), read_count);
-
-        if (in_stream.fail() || in_stream.gcount() != read_count)
-        {
-            std::cerr << "Error: Failed to read image data" << std::endl;
-            return true;
-        }
-
-        out_stream.write(data_buffer.get(), read_count);
-
-        if (out_stream.fail())
-        {
-            std::cerr << "Error: Failed to write image data" << std::endl;
-            return true;
-        }
-
-        pos += read_count;
-    }
-
-    if (pos != size)
-    {
-        std::cerr << "Error: Failed to read/write image data" << std::endl;
-        return true;
-    }
-
-    return false;
-}
-
-bool WriteDdsHeader(std::ofstream &out_stream, const DdsFileHeader &dds_header)
-{
-    char buffer[128];
-
-    // Magic number
-    buffer[0] = 'D';
-    buffer[1] = 'D';
-    buffer[2] = 'S';
-    buffer[3] = ' ';
-
-    write_u32le(buffer + 4, 124); // Size, always 124
-    write_u32le(buffer + 8, dds_header.flags);
-    write_u32le(buffer + 12, dds_header.height);
-    write_u32le(buffer + 16, dds_header.width);
-    write_u32le(buffer + 20, dds_header.pitch);
-    write_u32le(buffer + 24, dds_header.depth);
-    write_u32le(buffer + 28, dds_header.levels);
-    std::fill(buffer + 32, buffer + 76, 0); // Zero out 44 unused reserved1 bytes.
-    
-    // DDS Pixel Format
-    write_u32le(buffer + 76, 32); // Size, always 32
-    write_u32le(buffer + 80, dds_header.pix_fmt.flags);
-    std::copy(dds_header.pix_fmt.fourcc, dds_header.pix_fmt.fourcc + 4, buffer + 84);
-    write_u32le(buffer + 88, dds_header.pix_fmt.rgb_bits);
-    write_u32le(buffer + 92, dds_header.pix_fmt.r_bitmask);
-    write_u32le(buffer + 96, dds_header.pix_fmt.g_bitmask);
-    write_u32le(buffer + 100, dds_header.pix_fmt.b_bitmask);
-    write_u32le(buffer + 104, dds_header.pix_fmt.a_bitmask);
-    
-    write_u32le(buffer + 108, dds_header.caps);
-    write_u32le(buffer + 112, dds_header.caps2);
-    std::fill(buffer + 116, buffer + 128, 0); // Zero out 12 unused cap3, cap4, and reserved2 bytes.
-
-    out_stream.write(buffer, 128);
-
-    if (out_stream.fail())
-    {
-        std::cerr << "Error: failed to write file header" << std::endl;
-        return true;
-    }
-
-    return false;
-}
-
-void BuildDdsHeader(const TexImageHeader &i_header, DdsFileHeader &dds_header)
-{
-    const char char_table[5] = {'1', '2', '3', '4', '5'};
-
-    dds_header.flags = 0xa1007; // DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE
-    dds_header.height = i_header.height;
-    dds_header.width = i_header.width;
-    dds_header.pitch = i_header.size; // First mipmap level size
-    dds_header.depth = 0;
-    dds_header.levels = i_header.levels;
-    
-    dds_header.pix_fmt.flags = 0x4; // Indicate that the fourcc field is present
-    dds_header.pix_fmt.fourcc[0] = 'D';
-    dds_header.pix_fmt.fourcc[1] = 'X';
-    dds_header.pix_fmt.fourcc[2] = 'T';
-    dds_header.pix_fmt.fourcc[3] = char_table[i_header.dxt - 1];
-    dds_header.pix_fmt.rgb_bits = 0; // Leaving the rest of the pixel format as 0 seems to work fine
-    dds_header.pix_fmt.r_bitmask = 0;
-    dds_header.pix_fmt.g_bitmask = 0;
-    dds_header.pix_fmt.b_bitmask = 0;
-    dds_header.pix_fmt.a_bitmask = 0;
-
-    dds_header.caps = 0x401008; // DDSCAPS_COMPLEX | DDS_CAPS_MIPMAP | DDSCAPS_TEXTURE
-    dds_header.caps2 = 0; // Cubemap capabilities, not used.
-}
-
-bool ReadImage(std::ifstream &in_stream, unsigned int index, std::ofstream &filelist_stream)
+bool ReadImage(std::istream &in_stream, unsigned int index, std::ofstream &filelist_stream, ReportRecord &record)
 {
     // Each image has the layout:
     //
@@ -489,45 +415,28 @@ bool ReadImage(std::ifstream &in_stream, unsigned int index, std::ofstream &file
     //          data            [size] bytes
     
     TexImageHeader i_header;
-    DdsFileHeader dds_header;
-    std::ofstream out_stream;
+    FileSink out_file;
     unsigned int level_size;
     bool dxt2 = false;
     
-    if (ReadImageHeader(in_stream, i_header)) return true;
-
-    if (i_header.dxt > 5 || i_header.dxt == 0)
     {
-        std::cerr << "Error: Invalid dxt version (" << i_header.dxt << ") in image " << index << std::endl;
-        return true;
-    }
+        StatsTimer timer(StatsPhase::Parse);
+        TraceSpan span("header");
 
-    // Some THUG Pro tex.xbx files say they are dxt2 format, but are dxt1.
-    // If that's detected, just change the dxt value to 1.
-    if (i_header.dxt == 2)
-    {
-        unsigned int expected_size = i_header.width * i_header.height;
-        
-        if (i_header.size == expected_size / 2)
-        {
-            dxt2 = true;
-            i_header.dxt = 1;
-        }
-        else if (i_header.size != expected_size)
-        {
-            std::cerr << "Error: " << i_header.width << "x" << i_header.height << " dxt" << i_header.dxt << " image should be " << expected_size << " bytes, but was " << i_header.size << std::endl;
-            return true;
-        }
-    } 
+        if (ReadImageHeader(in_stream, i_header)) return true;
 
-    if (!options.quiet)
-    {
-        std::cout << "0x" << std::hex <<  i_header.checksum << std::dec << " ";
-        std::cout << i_header.levels << " ";
-        std::cout << ( dxt2 ? "2->" : "" ) << i_header.dxt << " ";
-        std::cout << i_header.width << "x" << i_header.height << std::endl;
+        StatsAddRead(36);
     }
 
+    if (CheckImageHeader(i_header, index, dxt2)) return true;
+
+    record.Field("checksum", i_header.checksum).Field("levels", i_header.levels).Field("dxt", i_header.dxt);
+    record.Field("dxt2_as_dxt1", dxt2).Field("width", i_header.width).Field("height", i_header.height);
+    record.Text() << "0x" << std::hex <<  i_header.checksum << std::dec << " ";
+    record.Text() << i_header.levels << " ";
+    record.Text() << ( dxt2 ? "2->" : "" ) << i_header.dxt << " ";
+    record.Text() << i_header.width << "x" << i_header.height;
+
     if (options.write)
     {
         std::filesystem::path out_path;
@@ -545,35 +454,50 @@ bool ReadImage(std::ifstream &in_stream, unsigned int index, std::ofstream &file
 
         out_path += "." + std::to_string(index) + ".dds";
 
-        if (std::filesystem::exists(out_path) && !options.overwrite)
         {
-            std::cerr << "Error: file \"" << out_path.string()  << "\" already exists and overwrite not enabled" << std::endl;
-            return true;
+            StatsTimer timer(StatsPhase::Filesystem);
+            TraceSpan span("open");
+
+            if (std::filesystem::exists(out_path) && !options.overwrite)
+            {
+                std::cerr << "Error: file \"" << out_path.string()  << "\" already exists and overwrite not enabled" << std::endl;
+                return true;
+            }
+            
+            if (out_file.Create(out_path))
+            {
+                std::cerr << "Error: Failed to open output file \"" << out_path.string() << "\"" << std::endl;
+                return true;
+            }
         }
-        
-        out_stream.open(out_path, out_stream.binary);
 
-        if (out_stream.fail())
         {
-            std::cerr << "Error: Failed to open output file \"" << out_path.string() << "\"" << std::endl;
-            return true;
-        }
+            StatsTimer timer(StatsPhase::Convert);
+            TraceSpan span("convert");
+            uint64_t data_size;
 
-        BuildDdsHeader(i_header, dds_header);
-        
-        if (WriteDdsHeader(out_stream, dds_header)) return true;
-        if (ReadImageLevel(in_stream, out_stream, i_header.size)) return true;
+            if (WriteDdsImage(in_stream, out_file.Stream(), i_header, data_size)) return true;
+
+            // The first level's size was read with the image header. The dds header is 128 bytes.
+            StatsAddRead(data_size + 4 * (i_header.levels - 1));
+            StatsAddWritten(data_size + 128);
+        }
 
-        for (unsigned int i = 1; i < i_header.levels; ++i)
         {
-            if (ReadImageLevelSize(in_stream, level_size)) return true;
-            if (ReadImageLevel(in_stream, out_stream, level_size)) return true;
+            StatsTimer timer(StatsPhase::Filesystem);
+            TraceSpan span("close");
+
+            if (out_file.Close())
+            {
+                std::cerr << "Error: Failed to write output file \"" << out_path.string() << "\"" << std::endl;
+                return true;
+            }
         }
 
         if (options.filelist)
         {
             std::filesystem::path file_path = (options.filelist_fullpath ? std::filesystem::absolute(out_path) : out_path);
-            filelist_stream << file_path.string() << std::endl;
+            filelist_stream << file_path.string() << "\n";
 
             if (filelist_stream.fail())
             {
@@ -584,6 +508,9 @@ bool ReadImage(std::ifstream &in_stream, unsigned int index, std::ofstream &file
     }
     else
     {
+        StatsTimer timer(StatsPhase::Read);
+        TraceSpan span("skip");
+
         if (SkipImageLevel(in_stream, i_header.size)) return true;
 
         for (unsigned int i = 1; i < i_header.levels; ++i)
@@ -594,4 +521,4 @@ bool ReadImage(std::ifstream &in_stream, unsigned int index, std::ofstream &file
     }
 
     return false;
-}
+}
\ No newline at end of file